@@ -0,0 +1,57 @@
+// Memory and chunking of a streamed export: /api/log style rows written
+// through http_stream into a counting fake server. State per request and
+// heap use must not grow with the body. Run build_host/bench_http_stream.
+#include "test_util.h"
+#include "malloc_count.h"
+#include "fake_httpd.h"
+#include "http_stream.h"
+
+// Timestamp and four channels, one of them missing, as in /api/log
+static void write_log(json_writer_t *w, uint32_t rows)
+{
+    json_obj_begin(w, NULL);
+    json_arr_begin(w, "columns");
+    json_string(w, NULL, "t_ms");
+    json_string(w, NULL, "aht22_temperature");
+    json_string(w, NULL, "aht22_humidity");
+    json_string(w, NULL, "bmp180_temperature");
+    json_string(w, NULL, "bmp180_pressure");
+    json_arr_end(w);
+    json_arr_begin(w, "rows");
+    for (uint32_t i = 0; i < rows; i++) {
+        json_arr_begin(w, NULL);
+        json_uint(w, NULL, 5000ull * i);
+        json_number(w, NULL, 2345 / 100.0, 2);
+        json_number(w, NULL, 4120 / 100.0, 2);
+        json_null(w, NULL);
+        json_number(w, NULL, 100837 / 100.0, 2);
+        json_arr_end(w);
+    }
+    json_arr_end(w);
+    json_bool(w, "truncated", false);
+    json_obj_end(w);
+}
+
+int main(void)
+{
+    static const uint32_t sizes[] = { 1000, 10000, 100000 };
+    httpd_req_t req = { .uri = "/api/log" };
+
+    printf("window %d B, http_stream_t %zu B\n", HTTP_STREAM_WINDOW, sizeof(http_stream_t));
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        fake_httpd_reset(false);
+        uint64_t allocs = malloc_count();
+        uint64_t t0 = test_now_ns();
+
+        http_stream_t s;
+        write_log(http_stream_begin(&s, &req), sizes[i]);
+        CHECK_EQ_INT(http_stream_end(&s), ESP_OK);
+
+        double ns = (double)(test_now_ns() - t0) / sizes[i];
+        allocs = malloc_count() - allocs;
+        printf("%6lu rows: %8zu B body  %6lu chunks  %5.1f ns/row  %llu allocs\n",
+               (unsigned long)sizes[i], fake_httpd.len, (unsigned long)fake_httpd.chunks,
+               ns, (unsigned long long)allocs);
+    }
+    return 0;
+}
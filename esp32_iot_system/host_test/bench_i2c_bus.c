@@ -0,0 +1,69 @@
+// Scheduler overhead per transaction: the same zero-delay fake transfer
+// called directly and through the I2C bus queue, from one and from three
+// threads. Not part of ctest; run build_host/bench_i2c_bus.
+#include <pthread.h>
+#include "test_util.h"
+#include "fake_i2c_backend.h"
+#include "i2c_bus.h"
+
+#define ITERATIONS      200000
+#define THREADS         3
+
+static i2c_bus_device_t devs[THREADS] = {
+    { .addr = 0x10, .timeout_ms = 1000 },
+    { .addr = 0x20, .timeout_ms = 1000 },
+    { .addr = 0x30, .timeout_ms = 1000 },
+};
+
+static void *reader(void *arg)
+{
+    const i2c_bus_device_t *dev = arg;
+    uint8_t tx = 0, rx[6];
+    for (int i = 0; i < ITERATIONS / THREADS; i++) {
+        i2c_bus_write_read(dev, (i2c_bus_prio_t)(dev->addr >> 4) - 1, &tx, 1, rx, sizeof(rx));
+    }
+    return NULL;
+}
+
+int main(void)
+{
+    CHECK(i2c_bus_init(&fake_i2c_backend) == ESP_OK);
+    for (int i = 0; i < THREADS; i++) {
+        CHECK(i2c_bus_add_device(&devs[i]) == ESP_OK);
+    }
+
+    uint8_t tx = 0, rx[6];
+    uint64_t t0 = test_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        fake_i2c_backend.transfer(NULL, devs[0].handle, &tx, 1, rx, sizeof(rx), 1000);
+    }
+    uint64_t direct_ns = test_now_ns() - t0;
+
+    t0 = test_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        i2c_bus_write_read(&devs[0], I2C_BUS_PRIO_CONTROL, &tx, 1, rx, sizeof(rx));
+    }
+    uint64_t queued_ns = test_now_ns() - t0;
+
+    pthread_t threads[THREADS];
+    t0 = test_now_ns();
+    for (int i = 0; i < THREADS; i++) {
+        pthread_create(&threads[i], NULL, reader, &devs[i]);
+    }
+    for (int i = 0; i < THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    uint64_t contended_ns = test_now_ns() - t0;
+
+    i2c_bus_stats_t stats;
+    i2c_bus_get_stats(&stats);
+    printf("direct backend call   %8.0f ns/txn\n", (double)direct_ns / ITERATIONS);
+    printf("through bus queue     %8.0f ns/txn\n", (double)queued_ns / ITERATIONS);
+    printf("%d threads, 3 prios    %8.0f ns/txn\n", THREADS,
+           (double)contended_ns / (ITERATIONS / THREADS * THREADS));
+    for (int p = 0; p < I2C_BUS_PRIO_COUNT; p++) {
+        printf("prio %d: %u txns, max queue %u, max wait %u us\n", p,
+               stats.prio[p].transactions, stats.prio[p].max_queue_depth, stats.prio[p].max_wait_us);
+    }
+    return 0;
+}
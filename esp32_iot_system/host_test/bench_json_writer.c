@@ -0,0 +1,94 @@
+// Cost of building the /api/sensors body with json_writer, against a
+// single snprintf of the same text (as the SSE event does). Both write
+// into a stack buffer; allocations are counted around the timed loops.
+// Run build_host/bench_json_writer.
+#include <string.h>
+#include "test_util.h"
+#include "malloc_count.h"
+#include "json_writer.h"
+
+#define ITERATIONS  1000000
+
+typedef struct {
+    float aht22_temperature, aht22_humidity;
+    float bmp180_temperature, bmp180_pressure;
+    bool aht22_available, bmp180_available;
+    uint8_t bmp180_oss;
+    uint32_t timestamp, seq, age_ms;
+} sample_t;
+
+static volatile size_t sink;
+
+// Same fields and order as write_sensors() in web_server.c
+static size_t with_writer(const sample_t *d, char *buf, size_t size)
+{
+    json_writer_t w;
+    json_writer_init(&w, buf, size, NULL, NULL);
+    json_obj_begin(&w, NULL);
+    json_obj_begin(&w, "aht22");
+    json_number(&w, "temperature", d->aht22_temperature, JSON_NUM_AUTO);
+    json_number(&w, "humidity", d->aht22_humidity, JSON_NUM_AUTO);
+    json_bool(&w, "available", d->aht22_available);
+    json_obj_end(&w);
+    json_obj_begin(&w, "bmp180");
+    json_number(&w, "temperature", d->bmp180_temperature, JSON_NUM_AUTO);
+    json_number(&w, "pressure", d->bmp180_pressure, JSON_NUM_AUTO);
+    json_bool(&w, "available", d->bmp180_available);
+    json_uint(&w, "oss", d->bmp180_oss);
+    json_obj_end(&w);
+    json_uint(&w, "timestamp", d->timestamp);
+    json_uint(&w, "sequence", d->seq);
+    json_uint(&w, "age_ms", d->age_ms);
+    json_obj_end(&w);
+    return json_writer_finish(&w) == ESP_OK ? w.len : 0;
+}
+
+static size_t with_snprintf(const sample_t *d, char *buf, size_t size)
+{
+    int n = snprintf(buf, size,
+                     "{\"aht22\":{\"temperature\":%.7g,\"humidity\":%.7g,\"available\":%s},"
+                     "\"bmp180\":{\"temperature\":%.7g,\"pressure\":%.7g,\"available\":%s,\"oss\":%u},"
+                     "\"timestamp\":%lu,\"sequence\":%lu,\"age_ms\":%lu}",
+                     d->aht22_temperature, d->aht22_humidity, d->aht22_available ? "true" : "false",
+                     d->bmp180_temperature, d->bmp180_pressure, d->bmp180_available ? "true" : "false",
+                     (unsigned)d->bmp180_oss, (unsigned long)d->timestamp,
+                     (unsigned long)d->seq, (unsigned long)d->age_ms);
+    return (n > 0 && (size_t)n < size) ? (size_t)n : 0;
+}
+
+static void bench(const char *name, size_t (*fn)(const sample_t *, char *, size_t))
+{
+    sample_t d = {
+        .aht22_temperature = 23.45f, .aht22_humidity = 41.2f, .aht22_available = true,
+        .bmp180_temperature = 23.1f, .bmp180_pressure = 1008.37f, .bmp180_available = true,
+        .bmp180_oss = 3, .timestamp = 86400000, .seq = 17280, .age_ms = 312,
+    };
+    char buf[512];
+    size_t len = 0;
+
+    uint64_t allocs = malloc_count();
+    uint64_t t0 = test_now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        d.seq = i;
+        len = fn(&d, buf, sizeof(buf));
+        sink = len;
+    }
+    double ns = (double)(test_now_ns() - t0) / ITERATIONS;
+    allocs = malloc_count() - allocs;
+    printf("%-16s %4zu B  %7.1f ns/body  %llu allocs\n", name, len, ns, (unsigned long long)allocs);
+}
+
+int main(void)
+{
+    // Both produce the same text
+    sample_t d = { 23.45f, 41.2f, 23.1f, 1008.37f, true, false, 1, 5000, 7, 12 };
+    char a[512], b[512];
+    size_t la = with_writer(&d, a, sizeof(a));
+    size_t lb = with_snprintf(&d, b, sizeof(b));
+    CHECK(la > 0 && la == lb && memcmp(a, b, la) == 0);
+
+    bench("json_writer", with_writer);
+    bench("snprintf", with_snprintf);
+    printf("(host CPU; see \"encoding\" in /api/metrics for the device)\n");
+    return 0;
+}
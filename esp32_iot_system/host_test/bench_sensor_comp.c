@@ -0,0 +1,55 @@
+// Compensation cost per sample: the fixed-point AHT20 kernels against the
+// formula they replaced, which promoted to double through its constants.
+// Run build_host/bench_sensor_comp.
+#include "test_util.h"
+#include "sensor_comp.h"
+
+#define ITERATIONS  10000000
+
+static const bmp180_calib_data_t cal = {
+    .ac1 = 408, .ac2 = -72, .ac3 = -14383, .ac4 = 32741, .ac5 = 32757, .ac6 = 23153,
+    .b1 = 6190, .b2 = 4, .mb = -32768, .mc = -8711, .md = 2868,
+};
+
+// Keeps the compiler from folding the loops away
+static volatile uint32_t sink_u;
+static volatile float sink_f;
+
+static void bench(const char *name, void (*fn)(uint32_t))
+{
+    uint64_t t0 = test_now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        fn(i);
+    }
+    double ns = (double)(test_now_ns() - t0) / ITERATIONS;
+    printf("%-28s %6.2f ns/sample\n", name, ns);
+}
+
+static void aht20_fixed(uint32_t i)
+{
+    uint32_t raw = i & 0xFFFFF;
+    sink_f = sensor_comp_centi_to_float(aht20_comp_temperature_centi(raw)) +
+             sensor_comp_centi_to_float(aht20_comp_humidity_centi(raw));
+}
+
+// As in the original driver
+static void aht20_double(uint32_t i)
+{
+    uint32_t raw = i & 0xFFFFF;
+    sink_f = (float)((float)raw / 1048576.0 * 200.0 - 50.0) + (float)((float)raw / 1048576.0 * 100.0);
+}
+
+static void bmp180_fixed(uint32_t i)
+{
+    int32_t b5 = bmp180_comp_b5(&cal, 27000 + (int32_t)(i & 2047));
+    sink_u = (uint32_t)bmp180_comp_pressure_pa(&cal, b5, 20000 + (int32_t)(i & 8191), 0);
+}
+
+int main(void)
+{
+    bench("aht20 fixed-point", aht20_fixed);
+    bench("aht20 double (original)", aht20_double);
+    bench("bmp180 b5 + pressure", bmp180_fixed);
+    printf("(host CPU; the ESP32-S3 has a single-precision FPU and no double unit)\n");
+    return 0;
+}
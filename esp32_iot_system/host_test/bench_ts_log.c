@@ -0,0 +1,85 @@
+// Flash log cost on the emulator at the real tslog partition size: append
+// rate, mount time and flash reads on a full log (fill-level binary
+// search), and flash reads for a range query. Run build_host/bench_ts_log.
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test_util.h"
+#include "flash_emu.h"
+#include "ts_log.h"
+
+#define PARTITION_SIZE  0xB0000     // partitions.csv
+#define PER_SEGMENT     ((TS_LOG_SEGMENT_SIZE - sizeof(ts_log_record_t)) / sizeof(ts_log_record_t))
+
+static char flash_path[] = "/tmp/bench_ts_log_XXXXXX";
+
+static flash_emu_t *mount(void)
+{
+    static flash_emu_t emu;
+    CHECK(flash_emu_open(&emu, flash_path, PARTITION_SIZE, true) == 0);
+    ts_log_flash_t ops = flash_emu_ops(&emu);
+    CHECK(ts_log_init(&ops) == ESP_OK);
+    return &emu;
+}
+
+static void fill(void)
+{
+    flash_emu_t *emu = mount();
+    uint32_t total = (PARTITION_SIZE / TS_LOG_SEGMENT_SIZE) * PER_SEGMENT;
+    sensor_data_t d = { .aht22_temperature = 21.5f, .aht22_available = true };
+
+    uint64_t t0 = test_now_ns();
+    for (uint32_t i = 0; i < total; i++) {
+        CHECK(ts_log_append(&d) == ESP_OK);
+    }
+    double ns = (double)(test_now_ns() - t0) / total;
+    printf("append      %u records, %.0f ns/record (emulator), %u erases, %llu bytes written\n",
+           total, ns, emu->erases, (unsigned long long)emu->bytes_written);
+}
+
+static void remount_and_query(void)
+{
+    uint64_t t0 = test_now_ns();
+    flash_emu_t *emu = mount();
+    double mount_us = (double)(test_now_ns() - t0) / 1000;
+
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    printf("mount       %u records in %u segments: %u flash reads (%llu bytes), %.0f us\n",
+           st.records, st.segments, emu->reads, (unsigned long long)emu->bytes_read, mount_us);
+
+    // One page of 100 records from the middle of the log
+    uint32_t reads = emu->reads;
+    uint64_t cursor = st.oldest_ms + (st.newest_ms - st.oldest_ms) / 2;
+    static ts_log_record_t page[100];
+    size_t n = ts_log_read(&cursor, UINT64_MAX, page, 100);
+    printf("range read  %zu records from the middle: %u flash reads\n", n, emu->reads - reads);
+}
+
+static void run(void (*fn)(void))
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        fn();
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void)
+{
+    int fd = mkstemp(flash_path);
+    CHECK(fd >= 0);
+    close(fd);
+    flash_emu_t emu;
+    CHECK(flash_emu_open(&emu, flash_path, PARTITION_SIZE, false) == 0);
+    flash_emu_close(&emu);
+
+    run(fill);
+    run(remount_and_query);
+    unlink(flash_path);
+    return 0;
+}
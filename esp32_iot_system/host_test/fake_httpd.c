@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fake_httpd.h"
+
+fake_httpd_t fake_httpd;
+
+void fake_httpd_reset(bool capture)
+{
+    fake_httpd.capture = capture;
+    fake_httpd.fail_chunk = 0;
+    fake_httpd.sends = 0;
+    fake_httpd.chunks = 0;
+    fake_httpd.chunked_end = false;
+    fake_httpd.err_sent = false;
+    fake_httpd.status[0] = '\0';
+    fake_httpd.retry_after[0] = '\0';
+    __atomic_store_n(&fake_httpd.async_begun, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&fake_httpd.async_completed, 0, __ATOMIC_RELAXED);
+    fake_httpd.len = 0;
+    fake_httpd.body[0] = '\0';
+}
+
+static void append(const char *buf, size_t len)
+{
+    if (fake_httpd.capture && fake_httpd.len + len <= FAKE_HTTPD_BODY_MAX) {
+        memcpy(fake_httpd.body + fake_httpd.len, buf, len);
+        fake_httpd.body[fake_httpd.len + len] = '\0';
+    }
+    fake_httpd.len += len;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    snprintf(fake_httpd.status, sizeof(fake_httpd.status), "%s", status);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    if (strcmp(field, "Retry-After") == 0) {
+        snprintf(fake_httpd.retry_after, sizeof(fake_httpd.retry_after), "%s", value);
+    }
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    if (len == HTTPD_RESP_USE_STRLEN) {
+        len = (ssize_t)strlen(buf);
+    }
+    fake_httpd.sends++;
+    append(buf, (size_t)len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    if (buf == NULL || len == 0) {
+        fake_httpd.chunked_end = true;
+        return ESP_OK;
+    }
+    if (len == HTTPD_RESP_USE_STRLEN) {
+        len = (ssize_t)strlen(buf);
+    }
+    if (fake_httpd.chunks + 1 == fake_httpd.fail_chunk) {
+        return ESP_FAIL;
+    }
+    fake_httpd.chunks++;
+    append(buf, (size_t)len);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_err(httpd_req_t *r, httpd_err_code_t error, const char *msg)
+{
+    fake_httpd.err_sent = true;
+    fake_httpd.err_code = error;
+    return ESP_OK;
+}
+
+// The copy outlives the handler, as on the device
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out)
+{
+    *out = malloc(sizeof(**out));
+    if (*out == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    **out = *r;
+    __atomic_fetch_add(&fake_httpd.async_begun, 1, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
+
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r)
+{
+    free(r);
+    __atomic_fetch_add(&fake_httpd.async_completed, 1, __ATOMIC_RELAXED);
+    return ESP_OK;
+}
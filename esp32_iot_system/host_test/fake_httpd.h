@@ -0,0 +1,36 @@
+#ifndef FAKE_HTTPD_H
+#define FAKE_HTTPD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_http_server.h"
+
+// Records what a handler sent for one request. The body is kept in a
+// static buffer (no heap, so benchmarks can count the module's own
+// allocations); past FAKE_HTTPD_BODY_MAX only the length is tracked.
+// Responses are expected from one thread at a time; the async request
+// counters may be updated from any thread.
+#define FAKE_HTTPD_BODY_MAX     (1024 * 1024)
+
+typedef struct {
+    bool capture;               // Keep the body bytes
+    uint32_t fail_chunk;        // 1-based chunk that fails, 0 = none
+    uint32_t sends;             // httpd_resp_send() calls
+    uint32_t chunks;            // Non-empty httpd_resp_send_chunk() calls
+    bool chunked_end;           // Terminating empty chunk seen
+    bool err_sent;
+    httpd_err_code_t err_code;
+    char status[32];            // Last httpd_resp_set_status(), "" = 200
+    char retry_after[8];        // Retry-After header, "" = not set
+    uint32_t async_begun;       // httpd_req_async_handler_begin() copies
+    uint32_t async_completed;   // ... handed back with _complete()
+    size_t len;                 // Body bytes sent
+    char body[FAKE_HTTPD_BODY_MAX + 1];     // NUL-terminated when captured
+} fake_httpd_t;
+
+extern fake_httpd_t fake_httpd;
+
+void fake_httpd_reset(bool capture);
+
+#endif
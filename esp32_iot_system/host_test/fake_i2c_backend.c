@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "fake_i2c_backend.h"
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fake_cond = PTHREAD_COND_INITIALIZER;
+static uint32_t fake_delay_us;
+static uint8_t fail_addr;
+static esp_err_t fail_err = ESP_OK;
+static bool hold_requested, holding;
+static fake_i2c_op_t op_log[FAKE_I2C_LOG_LEN];
+static int op_count;
+
+// Device handles are the address itself, offset so that 0x00 is not NULL
+#define HANDLE_TO_ADDR(h)   ((uint8_t)((uintptr_t)(h) - 0x100))
+
+static esp_err_t fake_run(uint8_t addr, uint32_t timeout_ms, bool probe)
+{
+    pthread_mutex_lock(&fake_lock);
+    if (op_count < FAKE_I2C_LOG_LEN) {
+        op_log[op_count++] = (fake_i2c_op_t){ .addr = addr, .timeout_ms = timeout_ms, .probe = probe };
+    }
+    if (hold_requested) {
+        hold_requested = false;
+        holding = true;
+        pthread_cond_broadcast(&fake_cond);
+        while (holding) {
+            pthread_cond_wait(&fake_cond, &fake_lock);
+        }
+    }
+    uint32_t delay_us = fake_delay_us;
+    esp_err_t err = (fail_err != ESP_OK && addr == fail_addr) ? fail_err : ESP_OK;
+    pthread_mutex_unlock(&fake_lock);
+
+    if (delay_us > 0) {
+        usleep(delay_us);
+    }
+    return err;
+}
+
+static esp_err_t fake_add_device(void *ctx, uint8_t addr, void **handle)
+{
+    *handle = (void *)((uintptr_t)addr + 0x100);
+    return ESP_OK;
+}
+
+static esp_err_t fake_transfer(void *ctx, void *handle,
+                               const uint8_t *tx, size_t tx_len,
+                               uint8_t *rx, size_t rx_len, uint32_t timeout_ms)
+{
+    uint8_t addr = HANDLE_TO_ADDR(handle);
+    esp_err_t err = fake_run(addr, timeout_ms, false);
+    if (err == ESP_OK && rx_len > 0) {
+        memset(rx, addr, rx_len);
+    }
+    return err;
+}
+
+static esp_err_t fake_probe(void *ctx, uint8_t addr, uint32_t timeout_ms)
+{
+    return fake_run(addr, timeout_ms, true);
+}
+
+const i2c_bus_backend_t fake_i2c_backend = {
+    .init = NULL,
+    .add_device = fake_add_device,
+    .transfer = fake_transfer,
+    .probe = fake_probe,
+    .ctx = NULL,
+};
+
+void fake_i2c_reset(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    fake_delay_us = 0;
+    fail_err = ESP_OK;
+    hold_requested = false;
+    op_count = 0;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_i2c_set_delay_us(uint32_t delay_us)
+{
+    pthread_mutex_lock(&fake_lock);
+    fake_delay_us = delay_us;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_i2c_set_error(uint8_t addr, esp_err_t err)
+{
+    pthread_mutex_lock(&fake_lock);
+    fail_addr = addr;
+    fail_err = err;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_i2c_hold_next(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    hold_requested = true;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_i2c_wait_held(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    while (!holding) {
+        pthread_cond_wait(&fake_cond, &fake_lock);
+    }
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_i2c_release(void)
+{
+    pthread_mutex_lock(&fake_lock);
+    holding = false;
+    pthread_cond_broadcast(&fake_cond);
+    pthread_mutex_unlock(&fake_lock);
+}
+
+int fake_i2c_log(fake_i2c_op_t *out, int max)
+{
+    pthread_mutex_lock(&fake_lock);
+    int n = op_count < max ? op_count : max;
+    memcpy(out, op_log, n * sizeof(out[0]));
+    pthread_mutex_unlock(&fake_lock);
+    return n;
+}
@@ -0,0 +1,35 @@
+#ifndef FAKE_I2C_BACKEND_H
+#define FAKE_I2C_BACKEND_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "i2c_bus.h"
+
+// In-memory i2c_bus backend for host tests. Every device answers a read
+// with its address repeated, a transfer takes delay_us, and the backend
+// records the order in which transactions reached the bus.
+#define FAKE_I2C_LOG_LEN    64
+
+typedef struct {
+    uint8_t addr;
+    uint32_t timeout_ms;    // Budget the scheduler passed down
+    bool probe;
+} fake_i2c_op_t;
+
+extern const i2c_bus_backend_t fake_i2c_backend;
+
+void fake_i2c_reset(void);
+void fake_i2c_set_delay_us(uint32_t delay_us);
+// Transfers to/probes of addr fail with err (ESP_OK to clear)
+void fake_i2c_set_error(uint8_t addr, esp_err_t err);
+
+// Holds the next transaction on the bus until fake_i2c_release(); returns
+// once it is being held
+void fake_i2c_hold_next(void);
+void fake_i2c_wait_held(void);
+void fake_i2c_release(void);
+
+// Copies the log, returns the number of entries
+int fake_i2c_log(fake_i2c_op_t *out, int max);
+
+#endif
@@ -0,0 +1,120 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "flash_emu.h"
+
+static esp_err_t emu_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset + len > emu->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(buf, emu->mem + offset, len);
+    emu->reads++;
+    emu->bytes_read += len;
+    return ESP_OK;
+}
+
+static esp_err_t emu_write(void *ctx, size_t offset, const void *buf, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset + len > emu->size) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size_t n = len;
+    bool cut = emu->cut_after_bytes >= 0 && (int64_t)len > emu->cut_after_bytes;
+    if (cut) {
+        n = (size_t)emu->cut_after_bytes;
+    } else if (emu->cut_after_bytes >= 0) {
+        emu->cut_after_bytes -= len;
+    }
+
+    // NOR programming: bits can only go from 1 to 0
+    const uint8_t *src = buf;
+    for (size_t i = 0; i < n; i++) {
+        emu->mem[offset + i] &= src[i];
+    }
+    if (cut) {
+        msync(emu->mem, emu->size, MS_SYNC);
+        _exit(FLASH_EMU_POWER_CUT_EXIT);
+    }
+    emu->writes++;
+    emu->bytes_written += len;
+    return ESP_OK;
+}
+
+static esp_err_t emu_erase(void *ctx, size_t offset, size_t len)
+{
+    flash_emu_t *emu = ctx;
+    if (offset % FLASH_EMU_SECTOR_SIZE || len % FLASH_EMU_SECTOR_SIZE || offset + len > emu->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (size_t sector = offset; sector < offset + len; sector += FLASH_EMU_SECTOR_SIZE) {
+        if (emu->cut_in_erase && sector > offset) {
+            msync(emu->mem, emu->size, MS_SYNC);
+            _exit(FLASH_EMU_POWER_CUT_EXIT);
+        }
+        memset(emu->mem + sector, 0xFF, FLASH_EMU_SECTOR_SIZE);
+        emu->sector_erases[sector / FLASH_EMU_SECTOR_SIZE]++;
+    }
+    emu->erases++;
+    return ESP_OK;
+}
+
+int flash_emu_open(flash_emu_t *emu, const char *path, size_t size, bool keep)
+{
+    memset(emu, 0, sizeof(*emu));
+    emu->cut_after_bytes = -1;
+    emu->size = size;
+    emu->fd = open(path, O_RDWR | O_CREAT | (keep ? 0 : O_TRUNC), 0644);
+    if (emu->fd < 0 || ftruncate(emu->fd, (off_t)size) != 0) {
+        return -1;
+    }
+    emu->mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, emu->fd, 0);
+    if (emu->mem == MAP_FAILED) {
+        return -1;
+    }
+    emu->sector_erases = calloc(size / FLASH_EMU_SECTOR_SIZE, sizeof(uint32_t));
+    if (!keep) {
+        // A new chip reads as erased
+        memset(emu->mem, 0xFF, size);
+    }
+    return 0;
+}
+
+void flash_emu_close(flash_emu_t *emu)
+{
+    munmap(emu->mem, emu->size);
+    close(emu->fd);
+    free(emu->sector_erases);
+}
+
+void flash_emu_erase_all(flash_emu_t *emu)
+{
+    memset(emu->mem, 0xFF, emu->size);
+}
+
+ts_log_flash_t flash_emu_ops(flash_emu_t *emu)
+{
+    return (ts_log_flash_t){
+        .read = emu_read,
+        .write = emu_write,
+        .erase = emu_erase,
+        .size = emu->size,
+        .ctx = emu,
+    };
+}
+
+void flash_emu_cut_after(flash_emu_t *emu, int64_t bytes)
+{
+    emu->cut_after_bytes = bytes;
+}
+
+void flash_emu_cut_in_erase(flash_emu_t *emu)
+{
+    emu->cut_in_erase = true;
+}
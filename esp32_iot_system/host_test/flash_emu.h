@@ -0,0 +1,45 @@
+#ifndef FLASH_EMU_H
+#define FLASH_EMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "ts_log.h"
+
+// File-backed NOR flash emulator for ts_log. Programming can only clear
+// bits, erases work on whole 4 KB sectors, and the contents live in a
+// shared mapping of the file so they survive a simulated reboot (a forked
+// child that exits). A power cut can be armed to stop after a given
+// number of programmed bytes: the write in progress is left partly done
+// and the process exits on the spot.
+#define FLASH_EMU_SECTOR_SIZE   4096
+#define FLASH_EMU_POWER_CUT_EXIT 42     // Exit status of a cut process
+
+typedef struct {
+    uint8_t *mem;
+    size_t size;
+    int fd;
+    int64_t cut_after_bytes;    // < 0: no power cut armed
+    bool cut_in_erase;          // Cut during the next erase instead
+    uint32_t reads;
+    uint64_t bytes_read;
+    uint32_t writes;
+    uint64_t bytes_written;
+    uint32_t erases;
+    uint32_t *sector_erases;    // Per-sector erase count (wear)
+} flash_emu_t;
+
+// Creates (or reopens, when keep is set) the backing file
+int flash_emu_open(flash_emu_t *emu, const char *path, size_t size, bool keep);
+void flash_emu_close(flash_emu_t *emu);
+void flash_emu_erase_all(flash_emu_t *emu);
+
+// ts_log flash ops bound to emu
+ts_log_flash_t flash_emu_ops(flash_emu_t *emu);
+
+// Power is cut once `bytes` more bytes have been programmed
+void flash_emu_cut_after(flash_emu_t *emu, int64_t bytes);
+// Power is cut half way through the next erase
+void flash_emu_cut_in_erase(flash_emu_t *emu);
+
+#endif
@@ -0,0 +1,31 @@
+#include <stddef.h>
+#include "malloc_count.h"
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static uint64_t count;
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+uint64_t malloc_count(void)
+{
+    return __atomic_load_n(&count, __ATOMIC_RELAXED);
+}
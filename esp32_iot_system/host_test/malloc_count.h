@@ -0,0 +1,11 @@
+#ifndef MALLOC_COUNT_H
+#define MALLOC_COUNT_H
+
+#include <stdint.h>
+
+// Heap allocations made so far by the process. Link with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc (see CMakeLists.txt);
+// the host counterpart of alloc_counter on the device.
+uint64_t malloc_count(void);
+
+#endif
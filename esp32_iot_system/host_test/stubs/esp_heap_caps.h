@@ -0,0 +1,7 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef ESP_HTTP_SERVER_H
+#define ESP_HTTP_SERVER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+// Host stand-in for the response half of esp_http_server, as used by
+// http_stream and web_workers. The calls are implemented by fake_httpd.c.
+typedef struct httpd_req {
+    char uri[64];
+    void *user_ctx;
+} httpd_req_t;
+
+typedef enum {
+    HTTPD_400_BAD_REQUEST,
+    HTTPD_404_NOT_FOUND,
+    HTTPD_500_INTERNAL_SERVER_ERROR,
+} httpd_err_code_t;
+
+#define HTTPD_RESP_USE_STRLEN   -1
+
+esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status);
+esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value);
+esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t len);
+esp_err_t httpd_resp_send_err(httpd_req_t *r, httpd_err_code_t error, const char *msg);
+
+esp_err_t httpd_req_async_handler_begin(httpd_req_t *r, httpd_req_t **out);
+esp_err_t httpd_req_async_handler_complete(httpd_req_t *r);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef ESP_PARTITION_H
+#define ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Host stand-in: there is no partition table, modules under test are
+// given their flash through an ops table instead
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0,
+    ESP_PARTITION_TYPE_DATA = 1,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    uint32_t address;
+    uint32_t size;
+    char label[17];
+} esp_partition_t;
+
+static inline const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                              esp_partition_subtype_t subtype,
+                                                              const char *label)
+{
+    return NULL;
+}
+
+static inline esp_err_t esp_partition_read(const esp_partition_t *p, size_t offset, void *dst, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t esp_partition_write(const esp_partition_t *p, size_t offset, const void *src, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+static inline esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t len)
+{
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef ESP_ROM_CRC_H
+#define ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// Host stand-in for the ROM CRC32 (IEEE 802.3, reflected). Same results as
+// esp_rom_crc32_le(): crc is the previous result, 0 to start.
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+// Host stand-in for the FreeRTOS API subset used by the tested modules,
+// implemented on pthreads (freertos_host.c). One tick is one millisecond.
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           ((TickType_t)0xffffffffu)
+#define configTICK_RATE_HZ      1000
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+// Critical sections become a mutex per lock
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { PTHREAD_MUTEX_INITIALIZER }
+#define portENTER_CRITICAL(mux)         pthread_mutex_lock(&(mux)->mutex)
+#define portEXIT_CRITICAL(mux)          pthread_mutex_unlock(&(mux)->mutex)
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+#define taskENTER_CRITICAL(mux)         portENTER_CRITICAL(mux)
+#define taskEXIT_CRITICAL(mux)          portEXIT_CRITICAL(mux)
+
+static inline void spinlock_initialize(portMUX_TYPE *mux)
+{
+    pthread_mutex_init(&mux->mutex, NULL);
+}
+
+#define portMUX_INITIALIZE(mux)         spinlock_initialize(mux)
+
+// Queues and semaphores share one implementation, as in FreeRTOS: a
+// semaphore is a queue of zero-sized items.
+struct host_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *storage;
+    size_t item_size;
+    UBaseType_t capacity;
+    UBaseType_t count;
+    UBaseType_t head;
+    bool is_static;
+};
+
+TickType_t xTaskGetTickCount(void);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SEMPHR_H
+#define SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+typedef struct host_queue *SemaphoreHandle_t;
+typedef struct host_queue StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#endif
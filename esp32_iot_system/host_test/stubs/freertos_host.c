@@ -0,0 +1,240 @@
+// pthread implementation of the FreeRTOS subset declared in stubs/freertos
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread struct host_task *current_task;
+
+static void deadline_after(struct timespec *ts, TickType_t ticks)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec += ticks / 1000;
+    ts->tv_nsec += (long)(ticks % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+// Waits on cond until pred holds; false on timeout
+static bool wait_until(struct host_queue *q, pthread_cond_t *cond, bool want_items, TickType_t ticks)
+{
+    struct timespec deadline;
+    if (ticks != portMAX_DELAY) {
+        deadline_after(&deadline, ticks);
+    }
+    while (want_items ? q->count == 0 : q->count == q->capacity) {
+        if (ticks == 0) {
+            return false;
+        }
+        if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, &q->mutex);
+        } else if (pthread_cond_timedwait(cond, &q->mutex, &deadline) == ETIMEDOUT) {
+            return !(want_items ? q->count == 0 : q->count == q->capacity);
+        }
+    }
+    return true;
+}
+
+static void queue_init(struct host_queue *q, UBaseType_t length, UBaseType_t item_size)
+{
+    memset(q, 0, sizeof(*q));
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_mutex_init(&q->mutex, NULL);
+    pthread_cond_init(&q->not_empty, &attr);
+    pthread_cond_init(&q->not_full, &attr);
+    pthread_condattr_destroy(&attr);
+    q->capacity = length;
+    q->item_size = item_size;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *q = malloc(sizeof(*q));
+    if (q == NULL) {
+        return NULL;
+    }
+    queue_init(q, length, item_size);
+    if (item_size > 0) {
+        q->storage = calloc(length, item_size);
+        if (q->storage == NULL) {
+            free(q);
+            return NULL;
+        }
+    }
+    return q;
+}
+
+void vQueueDelete(QueueHandle_t q)
+{
+    pthread_mutex_destroy(&q->mutex);
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    free(q->storage);
+    if (!q->is_static) {
+        free(q);
+    }
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->mutex);
+    if (!wait_until(q, &q->not_full, false, ticks)) {
+        pthread_mutex_unlock(&q->mutex);
+        return pdFALSE;
+    }
+    if (item != NULL && q->item_size > 0) {
+        UBaseType_t tail = (q->head + q->count) % q->capacity;
+        memcpy(q->storage + tail * q->item_size, item, q->item_size);
+    }
+    q->count++;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks)
+{
+    pthread_mutex_lock(&q->mutex);
+    if (!wait_until(q, &q->not_empty, true, ticks)) {
+        pthread_mutex_unlock(&q->mutex);
+        return pdFALSE;
+    }
+    if (item != NULL && q->item_size > 0) {
+        memcpy(item, q->storage + q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->capacity;
+    }
+    q->count--;
+    pthread_cond_signal(&q->not_full);
+    pthread_mutex_unlock(&q->mutex);
+    return pdTRUE;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t count = q->count;
+    pthread_mutex_unlock(&q->mutex);
+    return count;
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t q)
+{
+    pthread_mutex_lock(&q->mutex);
+    UBaseType_t spaces = q->capacity - q->count;
+    pthread_mutex_unlock(&q->mutex);
+    return spaces;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return xQueueCreate(1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinaryStatic(StaticSemaphore_t *buf)
+{
+    queue_init(buf, 1, 0);
+    buf->is_static = true;
+    return buf;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial)
+{
+    SemaphoreHandle_t sem = xQueueCreate(max, 0);
+    if (sem != NULL) {
+        sem->count = initial;
+    }
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return xSemaphoreCreateCounting(1, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    return xQueueSend(sem, NULL, 0);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    vQueueDelete(sem);
+}
+
+static void *task_entry(void *arg)
+{
+    current_task = arg;
+    current_task->fn(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                       void *arg, UBaseType_t priority, TaskHandle_t *handle)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    if (task == NULL) {
+        return pdFAIL;
+    }
+    task->fn = fn;
+    task->arg = arg;
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth,
+                                   void *arg, UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core)
+{
+    return xTaskCreate(fn, name, stack_depth, arg, priority, handle);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (TickType_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
@@ -0,0 +1,6 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+// Host build: no Kconfig options are set
+
+#endif
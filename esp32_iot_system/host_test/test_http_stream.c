@@ -0,0 +1,150 @@
+// Response streaming through the fixed window: single send when the body
+// fits, chunks when it does not, and what the client gets on errors.
+#include <string.h>
+#include "test_util.h"
+#include "fake_httpd.h"
+#include "http_stream.h"
+
+static httpd_req_t req = { .uri = "/api/test" };
+
+// Array of rows; each row is 15 bytes plus the comma
+static void write_rows(json_writer_t *w, uint32_t rows)
+{
+    json_arr_begin(w, NULL);
+    for (uint32_t i = 0; i < rows; i++) {
+        json_arr_begin(w, NULL);
+        json_uint(w, NULL, 1000000 + i);
+        json_number(w, NULL, 12.5, 2);
+        json_arr_end(w);
+    }
+    json_arr_end(w);
+}
+
+static size_t rows_len(uint32_t rows)
+{
+    return rows == 0 ? 2 : 2 + rows * 16 - 1;
+}
+
+static void test_small_body_single_send(void)
+{
+    http_stream_stats_t before, after;
+    http_stream_get_stats(&before);
+    fake_httpd_reset(true);
+
+    http_stream_t s;
+    json_writer_t *w = http_stream_begin(&s, &req);
+    json_obj_begin(w, NULL);
+    json_bool(w, "success", true);
+    json_obj_end(w);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_OK);
+
+    CHECK_EQ_INT(fake_httpd.sends, 1);
+    CHECK_EQ_INT(fake_httpd.chunks, 0);
+    CHECK(strcmp(fake_httpd.body, "{\"success\":true}") == 0);
+
+    http_stream_get_stats(&after);
+    CHECK_EQ_INT(after.responses, before.responses + 1);
+    CHECK_EQ_INT(after.chunked, before.chunked);
+}
+
+// A body that only just fits the window still goes out in one send
+static void test_window_sized_body(void)
+{
+    uint32_t rows = (HTTP_STREAM_WINDOW - 1) / 16;
+    CHECK(rows_len(rows) <= HTTP_STREAM_WINDOW);
+    fake_httpd_reset(true);
+
+    http_stream_t s;
+    write_rows(http_stream_begin(&s, &req), rows);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_OK);
+    CHECK_EQ_INT(fake_httpd.sends, 1);
+    CHECK_EQ_INT(fake_httpd.len, rows_len(rows));
+}
+
+static void test_large_body_chunked(void)
+{
+    const uint32_t rows = 1000;
+    http_stream_stats_t before, after;
+    http_stream_get_stats(&before);
+    fake_httpd_reset(true);
+
+    http_stream_t s;
+    write_rows(http_stream_begin(&s, &req), rows);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_OK);
+
+    size_t len = rows_len(rows);
+    CHECK_EQ_INT(fake_httpd.sends, 0);
+    CHECK(fake_httpd.chunked_end);
+    CHECK_EQ_INT(fake_httpd.len, len);
+    CHECK_EQ_INT(fake_httpd.chunks, (len + HTTP_STREAM_WINDOW - 1) / HTTP_STREAM_WINDOW);
+    CHECK(strncmp(fake_httpd.body, "[[1000000,12.50],[1000001,12.50],", 33) == 0);
+    CHECK(strcmp(fake_httpd.body + len - 16, "[1000999,12.50]]") == 0);
+
+    http_stream_get_stats(&after);
+    CHECK_EQ_INT(after.chunked, before.chunked + 1);
+    CHECK_EQ_INT(after.chunks, before.chunks + fake_httpd.chunks);
+    CHECK_EQ_INT(after.bytes, before.bytes + len);
+    CHECK(after.max_bytes >= len);
+}
+
+// Nothing sent yet: the client gets a 500 rather than broken JSON
+static void test_malformed_before_first_chunk(void)
+{
+    fake_httpd_reset(true);
+    http_stream_t s;
+    json_writer_t *w = http_stream_begin(&s, &req);
+    json_obj_begin(w, NULL);
+    json_uint(w, "a", 1);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_FAIL);
+    CHECK_EQ_INT(fake_httpd.sends, 0);
+    CHECK_EQ_INT(fake_httpd.len, 0);
+    CHECK(fake_httpd.err_sent);
+    CHECK_EQ_INT(fake_httpd.err_code, HTTPD_500_INTERNAL_SERVER_ERROR);
+}
+
+// Chunks already on the wire: the response is cut short, no 500 and no
+// terminating chunk
+static void test_malformed_after_chunks(void)
+{
+    fake_httpd_reset(true);
+    http_stream_t s;
+    json_writer_t *w = http_stream_begin(&s, &req);
+    json_obj_begin(w, NULL);
+    write_rows(w, 100);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_FAIL);
+    CHECK(fake_httpd.chunks > 0);
+    CHECK(!fake_httpd.err_sent);
+    CHECK(!fake_httpd.chunked_end);
+}
+
+// Client gone mid-stream: the writer stops producing output
+static void test_send_failure_stops_writer(void)
+{
+    http_stream_stats_t before, after;
+    http_stream_get_stats(&before);
+    fake_httpd_reset(false);
+    fake_httpd.fail_chunk = 3;
+
+    http_stream_t s;
+    json_writer_t *w = http_stream_begin(&s, &req);
+    write_rows(w, 10000);
+    CHECK_EQ_INT(w->err, ESP_FAIL);
+    CHECK_EQ_INT(w->total, 3 * HTTP_STREAM_WINDOW);
+    CHECK_EQ_INT(http_stream_end(&s), ESP_FAIL);
+    CHECK_EQ_INT(fake_httpd.chunks, 2);
+    CHECK(!fake_httpd.chunked_end);
+
+    http_stream_get_stats(&after);
+    CHECK_EQ_INT(after.errors, before.errors + 1);
+}
+
+int main(void)
+{
+    RUN_TEST(test_small_body_single_send);
+    RUN_TEST(test_window_sized_body);
+    RUN_TEST(test_large_body_chunked);
+    RUN_TEST(test_malformed_before_first_chunk);
+    RUN_TEST(test_malformed_after_chunks);
+    RUN_TEST(test_send_failure_stops_writer);
+    return 0;
+}
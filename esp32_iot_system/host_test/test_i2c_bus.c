@@ -0,0 +1,198 @@
+// I2C bus scheduler against the fake backend: priority order, queueing
+// timeouts, error accounting and buffer handling.
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include "test_util.h"
+#include "fake_i2c_backend.h"
+#include "i2c_bus.h"
+
+static i2c_bus_device_t dev_a = { .addr = 0x10, .timeout_ms = 1000 };
+static i2c_bus_device_t dev_b = { .addr = 0x20, .timeout_ms = 1000 };
+static i2c_bus_device_t dev_c = { .addr = 0x30, .timeout_ms = 1000 };
+static i2c_bus_device_t dev_short = { .addr = 0x40, .timeout_ms = 20 };
+
+typedef struct {
+    const i2c_bus_device_t *dev;
+    i2c_bus_prio_t prio;
+    esp_err_t result;
+    pthread_t thread;
+} async_read_t;
+
+static void *async_read_thread(void *arg)
+{
+    async_read_t *r = arg;
+    uint8_t buf[2];
+    r->result = i2c_bus_read(r->dev, r->prio, buf, sizeof(buf));
+    return NULL;
+}
+
+static uint32_t queued(i2c_bus_prio_t prio)
+{
+    i2c_bus_stats_t stats;
+    i2c_bus_get_stats(&stats);
+    return stats.prio[prio].queue_depth;
+}
+
+// Starts a read on another thread and returns once it is queued
+static void start_read(async_read_t *r, const i2c_bus_device_t *dev, i2c_bus_prio_t prio)
+{
+    uint32_t before = queued(prio);
+    r->dev = dev;
+    r->prio = prio;
+    CHECK(pthread_create(&r->thread, NULL, async_read_thread, r) == 0);
+    while (queued(prio) == before) {
+        usleep(100);
+    }
+}
+
+// Occupies the bus with a transaction held by the fake backend
+static void hold_bus(async_read_t *blocker)
+{
+    fake_i2c_hold_next();
+    blocker->dev = &dev_a;
+    blocker->prio = I2C_BUS_PRIO_NORMAL;
+    CHECK(pthread_create(&blocker->thread, NULL, async_read_thread, blocker) == 0);
+    fake_i2c_wait_held();
+}
+
+static void test_init_rejects_incomplete_backend(void)
+{
+    i2c_bus_backend_t partial = fake_i2c_backend;
+    partial.probe = NULL;
+    CHECK_EQ_INT(i2c_bus_init(NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(i2c_bus_init(&partial), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(i2c_bus_add_device(&dev_a), ESP_ERR_INVALID_STATE);
+}
+
+static void test_init(void)
+{
+    CHECK_EQ_INT(i2c_bus_init(&fake_i2c_backend), ESP_OK);
+    CHECK_EQ_INT(i2c_bus_init(&fake_i2c_backend), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(i2c_bus_add_device(&dev_a), ESP_OK);
+    CHECK_EQ_INT(i2c_bus_add_device(&dev_b), ESP_OK);
+    CHECK_EQ_INT(i2c_bus_add_device(&dev_c), ESP_OK);
+    CHECK_EQ_INT(i2c_bus_add_device(&dev_short), ESP_OK);
+}
+
+static void test_buffers_pass_through(void)
+{
+    fake_i2c_reset();
+    uint8_t tx[2] = { 1, 2 };
+    uint8_t rx[4] = { 0 };
+
+    CHECK_EQ_INT(i2c_bus_write_read(&dev_b, I2C_BUS_PRIO_CONTROL, tx, sizeof(tx), rx, sizeof(rx)), ESP_OK);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ_INT(rx[i], dev_b.addr);
+    }
+    CHECK_EQ_INT(i2c_bus_write(&dev_a, I2C_BUS_PRIO_NORMAL, tx, sizeof(tx)), ESP_OK);
+    CHECK_EQ_INT(i2c_bus_probe(0x55, 50, I2C_BUS_PRIO_DIAG), ESP_OK);
+
+    fake_i2c_op_t log[4];
+    CHECK_EQ_INT(fake_i2c_log(log, 4), 3);
+    CHECK_EQ_INT(log[2].addr, 0x55);
+    CHECK(log[2].probe);
+    CHECK_EQ_INT(i2c_bus_read(NULL, I2C_BUS_PRIO_NORMAL, rx, 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(i2c_bus_read(&dev_a, I2C_BUS_PRIO_COUNT, rx, 1), ESP_ERR_INVALID_ARG);
+}
+
+static void test_highest_priority_is_served_first(void)
+{
+    fake_i2c_reset();
+    async_read_t blocker, diag, normal, control;
+
+    // Queue the lowest priority first so FIFO order would be wrong
+    hold_bus(&blocker);
+    start_read(&diag, &dev_c, I2C_BUS_PRIO_DIAG);
+    start_read(&normal, &dev_b, I2C_BUS_PRIO_NORMAL);
+    start_read(&control, &dev_a, I2C_BUS_PRIO_CONTROL);
+    fake_i2c_release();
+
+    pthread_join(blocker.thread, NULL);
+    pthread_join(diag.thread, NULL);
+    pthread_join(normal.thread, NULL);
+    pthread_join(control.thread, NULL);
+    CHECK_EQ_INT(diag.result, ESP_OK);
+    CHECK_EQ_INT(normal.result, ESP_OK);
+    CHECK_EQ_INT(control.result, ESP_OK);
+
+    fake_i2c_op_t log[8];
+    CHECK_EQ_INT(fake_i2c_log(log, 8), 4);
+    CHECK_EQ_INT(log[1].addr, dev_a.addr);     // CONTROL
+    CHECK_EQ_INT(log[2].addr, dev_b.addr);     // NORMAL
+    CHECK_EQ_INT(log[3].addr, dev_c.addr);     // DIAG
+}
+
+static void test_expired_while_queued_never_reaches_bus(void)
+{
+    fake_i2c_reset();
+    i2c_bus_stats_t before, after;
+    i2c_bus_get_stats(&before);
+
+    async_read_t blocker, late;
+    hold_bus(&blocker);
+    start_read(&late, &dev_short, I2C_BUS_PRIO_CONTROL);
+    usleep((dev_short.timeout_ms + 30) * 1000);
+    fake_i2c_release();
+    pthread_join(blocker.thread, NULL);
+    pthread_join(late.thread, NULL);
+
+    CHECK_EQ_INT(late.result, ESP_ERR_TIMEOUT);
+    fake_i2c_op_t log[4];
+    CHECK_EQ_INT(fake_i2c_log(log, 4), 1);     // Only the blocker ran
+
+    i2c_bus_get_stats(&after);
+    CHECK_EQ_INT(after.prio[I2C_BUS_PRIO_CONTROL].timeouts,
+                 before.prio[I2C_BUS_PRIO_CONTROL].timeouts + 1);
+    CHECK(after.prio[I2C_BUS_PRIO_CONTROL].max_wait_us >= dev_short.timeout_ms * 1000);
+    CHECK_EQ_INT(after.prio[I2C_BUS_PRIO_CONTROL].queue_depth, 0);
+}
+
+static void test_queue_wait_is_deducted_from_timeout(void)
+{
+    fake_i2c_reset();
+    async_read_t blocker, waiter;
+
+    hold_bus(&blocker);
+    start_read(&waiter, &dev_b, I2C_BUS_PRIO_CONTROL);
+    usleep(100 * 1000);
+    fake_i2c_release();
+    pthread_join(blocker.thread, NULL);
+    pthread_join(waiter.thread, NULL);
+    CHECK_EQ_INT(waiter.result, ESP_OK);
+
+    fake_i2c_op_t log[4];
+    CHECK_EQ_INT(fake_i2c_log(log, 4), 2);
+    CHECK(log[1].timeout_ms <= dev_b.timeout_ms - 100);
+    CHECK(log[1].timeout_ms > 0);
+}
+
+static void test_backend_errors_are_counted(void)
+{
+    fake_i2c_reset();
+    i2c_bus_stats_t before, after;
+    i2c_bus_get_stats(&before);
+
+    fake_i2c_set_error(dev_c.addr, ESP_ERR_INVALID_RESPONSE);
+    uint8_t rx[1];
+    CHECK_EQ_INT(i2c_bus_read(&dev_c, I2C_BUS_PRIO_DIAG, rx, 1), ESP_ERR_INVALID_RESPONSE);
+    CHECK_EQ_INT(i2c_bus_read(&dev_a, I2C_BUS_PRIO_DIAG, rx, 1), ESP_OK);
+
+    i2c_bus_get_stats(&after);
+    CHECK_EQ_INT(after.prio[I2C_BUS_PRIO_DIAG].errors, before.prio[I2C_BUS_PRIO_DIAG].errors + 1);
+    CHECK_EQ_INT(after.prio[I2C_BUS_PRIO_DIAG].transactions,
+                 before.prio[I2C_BUS_PRIO_DIAG].transactions + 2);
+    CHECK_EQ_INT(after.prio[I2C_BUS_PRIO_DIAG].timeouts, before.prio[I2C_BUS_PRIO_DIAG].timeouts);
+}
+
+int main(void)
+{
+    RUN_TEST(test_init_rejects_incomplete_backend);
+    RUN_TEST(test_init);
+    RUN_TEST(test_buffers_pass_through);
+    RUN_TEST(test_highest_priority_is_served_first);
+    RUN_TEST(test_expired_while_queued_never_reaches_bus);
+    RUN_TEST(test_queue_wait_is_deducted_from_timeout);
+    RUN_TEST(test_backend_errors_are_counted);
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Streaming JSON writer: exact output for each value type, escaping,
+// nesting errors, and identical bytes for any buffer size once the flush
+// callback takes over.
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "test_util.h"
+#include "json_writer.h"
+
+#define CHECK_STR(a, b) do { \
+        const char *sa_ = (a), *sb_ = (b); \
+        if (strcmp(sa_, sb_) != 0) { \
+            fprintf(stderr, "%s:%d: %s == %s failed:\n  got  %s\n  want %s\n", \
+                    __FILE__, __LINE__, #a, #b, sa_, sb_); \
+            exit(1); \
+        } \
+    } while (0)
+
+static char out[1024];
+static json_writer_t w;
+
+// Writer on the static buffer with no flush callback
+static json_writer_t *begin(void)
+{
+    json_writer_init(&w, out, sizeof(out) - 1, NULL, NULL);
+    return &w;
+}
+
+static const char *finish(void)
+{
+    CHECK_EQ_INT(json_writer_finish(&w), ESP_OK);
+    out[w.len] = '\0';
+    return out;
+}
+
+// Collects flushed output
+static char collected[4096];
+static size_t collected_len;
+static uint32_t flushes;
+static uint32_t fail_on_flush;  // 1-based, 0 = never
+
+static esp_err_t collect(void *ctx, const char *data, size_t len)
+{
+    flushes++;
+    if (flushes == fail_on_flush) {
+        return ESP_FAIL;
+    }
+    CHECK(collected_len + len < sizeof(collected));
+    memcpy(collected + collected_len, data, len);
+    collected_len += len;
+    return ESP_OK;
+}
+
+// Something shaped like /api/metrics: nesting, every value type, escapes
+static void write_document(json_writer_t *jw)
+{
+    json_obj_begin(jw, NULL);
+    json_string(jw, "name", "bench \"A\"\n");
+    json_number(jw, "temperature", 24.5, 2);
+    json_number(jw, "pressure", 1013.25, JSON_NUM_AUTO);
+    json_int(jw, "offset", -42);
+    json_uint(jw, "uptime", 123456789012ull);
+    json_bool(jw, "ok", true);
+    json_null(jw, "missing");
+    json_arr_begin(jw, "rows");
+    for (int i = 0; i < 20; i++) {
+        json_arr_begin(jw, NULL);
+        json_uint(jw, NULL, (uint64_t)i * 1000);
+        json_number(jw, NULL, i / 3.0, 2);
+        json_number(jw, NULL, NAN, 2);
+        json_arr_end(jw);
+    }
+    json_arr_end(jw);
+    json_obj_begin(jw, "nested");
+    json_obj_begin(jw, "empty");
+    json_obj_end(jw);
+    json_arr_begin(jw, "none");
+    json_arr_end(jw);
+    json_raw(jw, "raw", "{\"a\":1}", 7);
+    json_obj_end(jw);
+    json_obj_end(jw);
+}
+
+static void test_commas_and_nesting(void)
+{
+    json_writer_t *jw = begin();
+    json_obj_begin(jw, NULL);
+    json_uint(jw, "a", 1);
+    json_arr_begin(jw, "b");
+    json_uint(jw, NULL, 2);
+    json_obj_begin(jw, NULL);
+    json_obj_end(jw);
+    json_arr_begin(jw, NULL);
+    json_arr_end(jw);
+    json_uint(jw, NULL, 3);
+    json_arr_end(jw);
+    json_obj_begin(jw, "c");
+    json_bool(jw, "d", false);
+    json_obj_end(jw);
+    json_obj_end(jw);
+    CHECK_STR(finish(), "{\"a\":1,\"b\":[2,{},[],3],\"c\":{\"d\":false}}");
+}
+
+static void test_top_level_array(void)
+{
+    json_writer_t *jw = begin();
+    json_arr_begin(jw, NULL);
+    json_null(jw, NULL);
+    json_string(jw, NULL, NULL);
+    json_raw(jw, NULL, "[1,2]", 5);
+    json_arr_end(jw);
+    CHECK_STR(finish(), "[null,null,[1,2]]");
+}
+
+static void test_string_escapes(void)
+{
+    json_writer_t *jw = begin();
+    json_obj_begin(jw, NULL);
+    json_string(jw, "q\"k", "a\"b\\c/d");
+    json_string(jw, "ctl", "\n\r\t\b\f\x01\x1f");
+    json_string(jw, "utf8", "23.5\xc2\xb0" "C");
+    json_string(jw, "empty", "");
+    json_obj_end(jw);
+    CHECK_STR(finish(), "{\"q\\\"k\":\"a\\\"b\\\\c/d\","
+                        "\"ctl\":\"\\n\\r\\t\\b\\f\\u0001\\u001f\","
+                        "\"utf8\":\"23.5\xc2\xb0" "C\",\"empty\":\"\"}");
+}
+
+static void test_integers(void)
+{
+    json_writer_t *jw = begin();
+    json_arr_begin(jw, NULL);
+    json_int(jw, NULL, INT64_MIN);
+    json_int(jw, NULL, 0);
+    json_uint(jw, NULL, UINT64_MAX);
+    json_arr_end(jw);
+    CHECK_STR(finish(), "[-9223372036854775808,0,18446744073709551615]");
+}
+
+static void test_numbers(void)
+{
+    json_writer_t *jw = begin();
+    json_arr_begin(jw, NULL);
+    json_number(jw, NULL, 24.5, 2);
+    json_number(jw, NULL, 24.456, 1);
+    json_number(jw, NULL, 7.0, 0);
+    json_number(jw, NULL, (double)0.1f, JSON_NUM_AUTO);     // 7 significant digits
+    json_number(jw, NULL, 1013.25, JSON_NUM_AUTO);
+    json_number(jw, NULL, 1e20, JSON_NUM_AUTO);
+    json_number(jw, NULL, 1.0 / 3.0, 12);                   // Capped at 9 decimals
+    json_number(jw, NULL, 1e300, 2);                        // Too wide for fixed point
+    json_arr_end(jw);
+    CHECK_STR(finish(), "[24.50,24.5,7,0.1,1013.25,1e+20,0.333333333,1e+300]");
+}
+
+static void test_negative_zero_and_non_finite(void)
+{
+    json_writer_t *jw = begin();
+    json_arr_begin(jw, NULL);
+    json_number(jw, NULL, -0.001, 2);
+    json_number(jw, NULL, -0.0, JSON_NUM_AUTO);
+    json_number(jw, NULL, -0.5, 0);
+    json_number(jw, NULL, -0.01, 2);
+    json_number(jw, NULL, NAN, 2);
+    json_number(jw, NULL, INFINITY, JSON_NUM_AUTO);
+    json_number(jw, NULL, -INFINITY, 1);
+    json_arr_end(jw);
+    CHECK_STR(finish(), "[0.00,0,0,-0.01,null,null,null]");
+}
+
+static void test_overflow_without_flush(void)
+{
+    char small[8];
+    json_writer_t sw;
+    json_writer_init(&sw, small, sizeof(small), NULL, NULL);
+    json_obj_begin(&sw, NULL);
+    json_string(&sw, "key", "longer than eight bytes");
+    json_obj_end(&sw);
+    CHECK_EQ_INT(json_writer_finish(&sw), ESP_ERR_NO_MEM);
+    CHECK(sw.len <= sizeof(small));
+
+    // Exactly filling the buffer is fine
+    json_writer_init(&sw, small, sizeof(small), NULL, NULL);
+    json_string(&sw, NULL, "123456");
+    CHECK_EQ_INT(json_writer_finish(&sw), ESP_OK);
+    CHECK_EQ_INT(sw.len, 8);
+}
+
+static void test_unbalanced(void)
+{
+    json_writer_t *jw = begin();
+    json_obj_begin(jw, NULL);
+    CHECK_EQ_INT(json_writer_finish(jw), ESP_ERR_INVALID_STATE);
+
+    jw = begin();
+    json_arr_begin(jw, NULL);
+    json_arr_end(jw);
+    json_arr_end(jw);
+    CHECK_EQ_INT(jw->err, ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(json_writer_finish(jw), ESP_ERR_INVALID_STATE);
+}
+
+static void test_depth_limit(void)
+{
+    json_writer_t *jw = begin();
+    for (int i = 0; i < JSON_WRITER_MAX_DEPTH - 1; i++) {
+        json_arr_begin(jw, NULL);
+    }
+    CHECK_EQ_INT(jw->err, ESP_OK);
+    json_arr_begin(jw, NULL);
+    CHECK_EQ_INT(jw->err, ESP_ERR_INVALID_STATE);
+
+    // Later calls do nothing
+    size_t len = jw->len;
+    json_uint(jw, NULL, 1);
+    CHECK_EQ_INT(jw->len, len);
+    CHECK_EQ_INT(json_writer_finish(jw), ESP_ERR_INVALID_STATE);
+}
+
+// The flush callback must see the same bytes, in order, whatever the
+// buffer size, down to a single byte
+static void test_any_buffer_size(void)
+{
+    json_writer_t *jw = begin();
+    write_document(jw);
+    const char *reference = finish();
+    size_t reference_len = strlen(reference);
+
+    for (size_t size = 1; size <= 300; size++) {
+        char buf[300];
+        json_writer_t fw;
+        collected_len = 0;
+        flushes = 0;
+        fail_on_flush = 0;
+        json_writer_init(&fw, buf, size, collect, NULL);
+        write_document(&fw);
+        CHECK_EQ_INT(json_writer_finish(&fw), ESP_OK);
+        CHECK_EQ_INT(collected_len, reference_len);
+        CHECK_EQ_INT(fw.total, reference_len);
+        CHECK(memcmp(collected, reference, reference_len) == 0);
+        CHECK_EQ_INT(flushes, (reference_len + size - 1) / size);
+    }
+}
+
+static void test_flush_error_sticks(void)
+{
+    char buf[16];
+    json_writer_t fw;
+    collected_len = 0;
+    flushes = 0;
+    fail_on_flush = 2;
+    json_writer_init(&fw, buf, sizeof(buf), collect, NULL);
+    write_document(&fw);
+    CHECK_EQ_INT(fw.err, ESP_FAIL);
+    CHECK_EQ_INT(flushes, 2);
+    CHECK_EQ_INT(collected_len, sizeof(buf));
+    CHECK_EQ_INT(json_writer_finish(&fw), ESP_FAIL);
+    CHECK_EQ_INT(flushes, 2);
+}
+
+int main(void)
+{
+    RUN_TEST(test_commas_and_nesting);
+    RUN_TEST(test_top_level_array);
+    RUN_TEST(test_string_escapes);
+    RUN_TEST(test_integers);
+    RUN_TEST(test_numbers);
+    RUN_TEST(test_negative_zero_and_non_finite);
+    RUN_TEST(test_overflow_without_flush);
+    RUN_TEST(test_unbalanced);
+    RUN_TEST(test_depth_limit);
+    RUN_TEST(test_any_buffer_size);
+    RUN_TEST(test_flush_error_sticks);
+    return 0;
+}
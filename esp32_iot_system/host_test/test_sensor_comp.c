@@ -0,0 +1,76 @@
+// Fixed-point compensation kernels against the BMP180 datasheet example
+// (section 3.5) and the AHT20 transfer function.
+#include "test_util.h"
+#include "sensor_comp.h"
+
+// Calibration and raw readings from the BMP180 datasheet example
+static const bmp180_calib_data_t datasheet_cal = {
+    .ac1 = 408, .ac2 = -72, .ac3 = -14383, .ac4 = 32741, .ac5 = 32757, .ac6 = 23153,
+    .b1 = 6190, .b2 = 4, .mb = -32768, .mc = -8711, .md = 2868,
+};
+#define DATASHEET_UT    27898
+#define DATASHEET_UP    23843
+
+static void test_bmp180_datasheet_vector(void)
+{
+    int32_t b5 = bmp180_comp_b5(&datasheet_cal, DATASHEET_UT);
+    CHECK_EQ_INT(b5, 2400);
+    CHECK_EQ_INT(bmp180_comp_temperature_centi(b5), 1500);     // 15.0 °C
+    CHECK_EQ_INT(bmp180_comp_pressure_pa(&datasheet_cal, b5, DATASHEET_UP, 0), 69964);
+    CHECK_NEAR(sensor_comp_centi_to_float(bmp180_comp_temperature_centi(b5)), 15.0f, 1e-4);
+    CHECK_NEAR(sensor_comp_pa_to_hpa(69964), 699.64f, 1e-3);
+}
+
+static void test_bmp180_oversampling_scales_up(void)
+{
+    // The same pressure read with OSS n has UP scaled by 2^n; the result
+    // may only differ by the extra resolution
+    int32_t b5 = bmp180_comp_b5(&datasheet_cal, DATASHEET_UT);
+    for (uint8_t oss = 1; oss <= 3; oss++) {
+        int32_t p = bmp180_comp_pressure_pa(&datasheet_cal, b5, DATASHEET_UP << oss, oss);
+        CHECK_NEAR(p, 69964, 3);
+    }
+}
+
+static void test_bmp180_pressure_is_monotonic(void)
+{
+    int32_t b5 = bmp180_comp_b5(&datasheet_cal, DATASHEET_UT);
+    int32_t last = bmp180_comp_pressure_pa(&datasheet_cal, b5, 15000, 0);
+    for (int32_t up = 15001; up < 40000; up++) {
+        int32_t p = bmp180_comp_pressure_pa(&datasheet_cal, b5, up, 0);
+        CHECK(p >= last);
+        last = p;
+    }
+}
+
+static void test_aht20_range_ends(void)
+{
+    CHECK_EQ_INT(aht20_comp_humidity_centi(0), 0);
+    CHECK_EQ_INT(aht20_comp_temperature_centi(0), -5000);          // -50.00 °C
+    CHECK_EQ_INT(aht20_comp_humidity_centi(0xFFFFF), 10000);       // 100.00 %RH
+    CHECK_EQ_INT(aht20_comp_temperature_centi(0xFFFFF), 15000);    // 150.00 °C
+    CHECK_EQ_INT(aht20_comp_humidity_centi(1u << 19), 5000);
+    CHECK_EQ_INT(aht20_comp_temperature_centi(1u << 19), 5000);
+}
+
+static void test_aht20_matches_float_formula(void)
+{
+    // Reference: the datasheet formula in double precision, rounded to
+    // 0.01; the kernel must agree to within half a centi-unit (rounding)
+    for (uint32_t raw = 0; raw <= 0xFFFFF; raw++) {
+        double rh = raw / 1048576.0 * 100.0;
+        double t = raw / 1048576.0 * 200.0 - 50.0;
+        CHECK_NEAR(aht20_comp_humidity_centi(raw), rh * 100.0, 0.5001);
+        CHECK_NEAR(aht20_comp_temperature_centi(raw), t * 100.0, 0.5001);
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_bmp180_datasheet_vector);
+    RUN_TEST(test_bmp180_oversampling_scales_up);
+    RUN_TEST(test_bmp180_pressure_is_monotonic);
+    RUN_TEST(test_aht20_range_ends);
+    RUN_TEST(test_aht20_matches_float_formula);
+    return 0;
+}
@@ -0,0 +1,154 @@
+// Seqlock snapshot under a concurrent writer: every read must return one
+// whole sample (no fields from two different publishes), sample numbers
+// must never go backwards, and a read must never block on the writer.
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "test_util.h"
+#include "sensor_snapshot.h"
+
+#define READER_THREADS      3
+#define READS_PER_THREAD    2000000
+#define LATENCY_SAMPLES     4096
+
+static atomic_bool readers_done;
+
+static void fill_sample(sensor_data_t *d, uint32_t n)
+{
+    // Every field derives from n, so a torn copy is detectable; n stays
+    // below 2^24 so the floats hold it exactly
+    d->aht22_temperature = (float)n;
+    d->aht22_humidity = (float)n;
+    d->aht22_available = n & 1;
+    d->bmp180_temperature = (float)n;
+    d->bmp180_pressure = (float)n;
+    d->bmp180_available = n & 1;
+    d->bmp180_oss = (uint8_t)n;
+    d->timestamp = n;
+}
+
+static void check_sample(const sensor_snapshot_t *s)
+{
+    uint32_t n = s->data.timestamp;
+    CHECK_EQ_INT(s->seq, n);
+    CHECK(s->data.aht22_temperature == (float)n);
+    CHECK(s->data.aht22_humidity == (float)n);
+    CHECK(s->data.aht22_available == (bool)(n & 1));
+    CHECK(s->data.bmp180_temperature == (float)n);
+    CHECK(s->data.bmp180_pressure == (float)n);
+    CHECK(s->data.bmp180_available == (bool)(n & 1));
+    CHECK_EQ_INT(s->data.bmp180_oss, (uint8_t)n);
+}
+
+static void *writer_thread(void *arg)
+{
+    uint32_t *published = arg;
+    uint32_t n = 1;
+    sensor_data_t d;
+
+    while (!atomic_load(&readers_done) && n < (1u << 24)) {
+        fill_sample(&d, n);
+        sensor_snapshot_publish(&d);
+        n++;
+    }
+    *published = n - 1;
+    return NULL;
+}
+
+typedef struct {
+    uint64_t latency_ns[LATENCY_SAMPLES];
+    uint64_t max_ns;
+    uint32_t changes;
+} reader_result_t;
+
+static void *reader_thread(void *arg)
+{
+    reader_result_t *res = arg;
+    uint32_t last_seq = 0;
+    sensor_snapshot_t snap;
+
+    for (int i = 0; i < READS_PER_THREAD; i++) {
+        uint64_t t0 = test_now_ns();
+        bool ok = sensor_snapshot_read(&snap);
+        uint64_t dt = test_now_ns() - t0;
+
+        res->latency_ns[i % LATENCY_SAMPLES] = dt;
+        if (dt > res->max_ns) {
+            res->max_ns = dt;
+        }
+        if (!ok) {
+            continue;   // Writer has not published yet
+        }
+        check_sample(&snap);
+        CHECK(snap.seq >= last_seq);
+        if (snap.seq != last_seq) {
+            res->changes++;
+        }
+        last_seq = snap.seq;
+    }
+    return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_empty_before_first_publish(void)
+{
+    sensor_snapshot_t snap;
+    CHECK(!sensor_snapshot_read(&snap));
+    CHECK_EQ_INT(sensor_snapshot_seq(), 0);
+    CHECK_EQ_INT(sensor_snapshot_age_ms(&snap), 0);
+}
+
+static void test_concurrent_reads_are_never_torn(void)
+{
+    static reader_result_t results[READER_THREADS];
+    pthread_t readers[READER_THREADS], writer;
+    uint32_t published = 0;
+
+    CHECK(pthread_create(&writer, NULL, writer_thread, &published) == 0);
+    for (int i = 0; i < READER_THREADS; i++) {
+        CHECK(pthread_create(&readers[i], NULL, reader_thread, &results[i]) == 0);
+    }
+    for (int i = 0; i < READER_THREADS; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    atomic_store(&readers_done, true);
+    pthread_join(writer, NULL);
+
+    CHECK(published > 0);
+    CHECK_EQ_INT(sensor_snapshot_seq(), published);
+
+    sensor_snapshot_t snap;
+    CHECK(sensor_snapshot_read(&snap));
+    CHECK_EQ_INT(snap.seq, published);
+    check_sample(&snap);
+
+    // Read latency while the writer is spinning (last samples per thread)
+    static uint64_t all[READER_THREADS * LATENCY_SAMPLES];
+    uint64_t max_ns = 0;
+    uint32_t changes = 0;
+    for (int i = 0; i < READER_THREADS; i++) {
+        memcpy(&all[i * LATENCY_SAMPLES], results[i].latency_ns, sizeof(results[i].latency_ns));
+        if (results[i].max_ns > max_ns) {
+            max_ns = results[i].max_ns;
+        }
+        changes += results[i].changes;
+    }
+    size_t count = READER_THREADS * LATENCY_SAMPLES;
+    qsort(all, count, sizeof(all[0]), cmp_u64);
+    printf("\n  %u publishes, %u sample changes seen by %d readers, read p50 %llu ns"
+           " p99 %llu ns max %llu ns\n  ", published, changes, READER_THREADS,
+           (unsigned long long)all[count / 2], (unsigned long long)all[count * 99 / 100],
+           (unsigned long long)max_ns);
+}
+
+int main(void)
+{
+    RUN_TEST(test_empty_before_first_publish);
+    RUN_TEST(test_concurrent_reads_are_never_torn);
+    return 0;
+}
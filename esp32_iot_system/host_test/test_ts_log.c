@@ -0,0 +1,296 @@
+// Flash sample log on the file-backed flash emulator. Every "boot" runs in
+// a forked child that mounts the log from the shared flash image, so
+// remounts and power cuts go through the real ts_log_init() path.
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "test_util.h"
+#include "flash_emu.h"
+#include "ts_log.h"
+
+#define SEGMENTS        3
+#define FLASH_SIZE      (SEGMENTS * TS_LOG_SEGMENT_SIZE)
+#define PER_SEGMENT     ((TS_LOG_SEGMENT_SIZE - sizeof(ts_log_record_t)) / sizeof(ts_log_record_t))
+
+static char flash_path[] = "/tmp/test_ts_log_XXXXXX";
+static flash_emu_t emu;
+
+// Sample n carries n in every channel, so reads can be matched to appends
+static void append_samples(uint32_t first, uint32_t count)
+{
+    for (uint32_t n = first; n < first + count; n++) {
+        sensor_data_t d = {
+            .aht22_temperature = (float)n,
+            .aht22_humidity = (float)n,
+            .aht22_available = true,
+            .bmp180_temperature = (float)n,
+            .bmp180_pressure = (float)n,
+            .bmp180_available = (n & 1) != 0,
+        };
+        CHECK_EQ_INT(ts_log_append(&d), ESP_OK);
+    }
+}
+
+static uint32_t sample_of(const ts_log_record_t *rec)
+{
+    return (uint32_t)(rec->value[TS_LOG_CH_AHT22_TEMPERATURE] / 100);
+}
+
+// Reads the whole log in small pages and checks the invariants every read
+// must hold; returns the number of records
+static size_t read_all(ts_log_record_t *out, size_t max)
+{
+    uint64_t cursor = 0;
+    size_t total = 0;
+    ts_log_record_t page[16];
+    size_t n;
+
+    while ((n = ts_log_read(&cursor, UINT64_MAX, page, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            uint32_t s = sample_of(&page[i]);
+            CHECK_EQ_INT(page[i].value[TS_LOG_CH_BMP180_PRESSURE], s * 100);
+            CHECK_EQ_INT(page[i].valid, 0x3 | ((s & 1) ? 0xC : 0));
+            if (total > 0) {
+                CHECK(page[i].t_ms > out[total - 1].t_ms);
+            }
+            CHECK(total < max);
+            out[total++] = page[i];
+        }
+    }
+    return total;
+}
+
+static void check_samples(const ts_log_record_t *recs, size_t n, uint32_t first)
+{
+    for (size_t i = 0; i < n; i++) {
+        CHECK_EQ_INT(sample_of(&recs[i]), first + i);
+    }
+}
+
+// One boot on the current flash image; returns the child's exit status
+static int boot(void (*fn)(void))
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    CHECK(pid >= 0);
+    if (pid == 0) {
+        CHECK(flash_emu_open(&emu, flash_path, FLASH_SIZE, true) == 0);
+        ts_log_flash_t ops = flash_emu_ops(&emu);
+        CHECK_EQ_INT(ts_log_init(&ops), ESP_OK);
+        fn();
+        _exit(0);
+    }
+    int status;
+    CHECK(waitpid(pid, &status, 0) == pid);
+    CHECK(WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static void new_flash(void)
+{
+    flash_emu_t fresh;
+    CHECK(flash_emu_open(&fresh, flash_path, FLASH_SIZE, false) == 0);
+    flash_emu_close(&fresh);
+}
+
+static ts_log_record_t recs[SEGMENTS * PER_SEGMENT + 16];
+
+// --- append and remount --------------------------------------------------
+
+static void boot_empty_then_append(void)
+{
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.segments, SEGMENTS);
+    CHECK_EQ_INT(st.records_per_segment, PER_SEGMENT);
+    CHECK_EQ_INT(st.records, 0);
+    CHECK_EQ_INT(read_all(recs, 1), 0);
+
+    append_samples(0, 100);
+    CHECK_EQ_INT(read_all(recs, 200), 100);
+    check_samples(recs, 100, 0);
+
+    // Range query from the middle
+    uint64_t cursor = recs[40].t_ms;
+    ts_log_record_t page[8];
+    CHECK_EQ_INT(ts_log_read(&cursor, recs[44].t_ms, page, 8), 5);
+    CHECK_EQ_INT(sample_of(&page[0]), 40);
+    CHECK_EQ_INT(ts_log_read(&cursor, recs[44].t_ms, page, 8), 0);
+}
+
+static void boot_remount_keeps_records(void)
+{
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.records, 100);
+    CHECK_EQ_INT(st.segments_used, 1);
+    CHECK_EQ_INT(read_all(recs, 200), 100);
+    check_samples(recs, 100, 0);
+
+    // Log time resumes after the newest stored record
+    CHECK(ts_log_now_ms() > recs[99].t_ms);
+    append_samples(100, 5);
+    CHECK_EQ_INT(read_all(recs, 200), 105);
+    check_samples(recs, 105, 0);
+}
+
+static void test_append_and_remount(void)
+{
+    new_flash();
+    CHECK_EQ_INT(boot(boot_empty_then_append), 0);
+    CHECK_EQ_INT(boot(boot_remount_keeps_records), 0);
+}
+
+// --- segment rollover ----------------------------------------------------
+
+#define ROLLOVER_TOTAL  (SEGMENTS * PER_SEGMENT + 10)
+
+static void boot_fill_past_end(void)
+{
+    append_samples(0, ROLLOVER_TOTAL);
+
+    // The oldest segment was erased and reused for the last 10
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.segments_erased, SEGMENTS + 1);
+    CHECK_EQ_INT(st.records, 2 * PER_SEGMENT + 10);
+    CHECK_EQ_INT(emu.sector_erases[0], 2);
+    CHECK_EQ_INT(emu.sector_erases[TS_LOG_SEGMENT_SIZE / FLASH_EMU_SECTOR_SIZE], 1);
+
+    CHECK_EQ_INT(read_all(recs, ROLLOVER_TOTAL), 2 * PER_SEGMENT + 10);
+    check_samples(recs, 2 * PER_SEGMENT + 10, PER_SEGMENT);
+}
+
+static void boot_remount_after_rollover(void)
+{
+    // Fill levels come from the mount-time binary search
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.segments_used, SEGMENTS);
+    CHECK_EQ_INT(st.records, 2 * PER_SEGMENT + 10);
+    CHECK_EQ_INT(read_all(recs, ROLLOVER_TOTAL), 2 * PER_SEGMENT + 10);
+    check_samples(recs, 2 * PER_SEGMENT + 10, PER_SEGMENT);
+    CHECK_EQ_INT(st.oldest_ms, recs[0].t_ms);
+    CHECK_EQ_INT(st.newest_ms, recs[2 * PER_SEGMENT + 9].t_ms);
+
+    // Appends continue in the partly filled segment
+    append_samples(ROLLOVER_TOTAL, 1);
+    CHECK_EQ_INT(read_all(recs, ROLLOVER_TOTAL), 2 * PER_SEGMENT + 11);
+    check_samples(recs, 2 * PER_SEGMENT + 11, PER_SEGMENT);
+}
+
+static void test_rollover(void)
+{
+    new_flash();
+    CHECK_EQ_INT(boot(boot_fill_past_end), 0);
+    CHECK_EQ_INT(boot(boot_remount_after_rollover), 0);
+}
+
+// --- power cut while writing a record ------------------------------------
+
+static int64_t cut_bytes;
+
+static void boot_append_then_cut(void)
+{
+    append_samples(0, 50);
+    flash_emu_cut_after(&emu, cut_bytes);
+    append_samples(50, 1);          // Does not return
+}
+
+static void boot_after_record_cut(void)
+{
+    // A torn record keeps its slot but fails CRC and is skipped on read
+    bool torn = cut_bytes > 0;
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.records, 50 + torn);
+    CHECK_EQ_INT(read_all(recs, 100), 50);
+    check_samples(recs, 50, 0);
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.crc_errors, torn);
+
+    append_samples(51, 10);
+    size_t n = read_all(recs, 100);
+    CHECK_EQ_INT(n, 60);
+    check_samples(recs, 50, 0);
+    check_samples(&recs[50], 10, 51);
+
+    // Range reads starting anywhere behind the torn slot
+    for (size_t k = 0; k < n; k++) {
+        uint64_t cursor = recs[k].t_ms;
+        ts_log_record_t page[4];
+        CHECK(ts_log_read(&cursor, UINT64_MAX, page, 4) > 0);
+        CHECK_EQ_INT(sample_of(&page[0]), sample_of(&recs[k]));
+    }
+}
+
+static void test_power_cut_in_record(void)
+{
+    // Nothing written, half of the timestamp, timestamp + some values,
+    // everything but the CRC
+    static const int64_t cuts[] = { 0, 4, 16, 28 };
+    for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++) {
+        new_flash();
+        cut_bytes = cuts[i];
+        CHECK_EQ_INT(boot(boot_append_then_cut), FLASH_EMU_POWER_CUT_EXIT);
+        CHECK_EQ_INT(boot(boot_after_record_cut), 0);
+    }
+}
+
+// --- power cut while recycling the oldest segment ------------------------
+
+static bool cut_in_erase;
+
+static void boot_fill_then_cut_rollover(void)
+{
+    append_samples(0, SEGMENTS * PER_SEGMENT);
+    if (cut_in_erase) {
+        flash_emu_cut_in_erase(&emu);
+    } else {
+        flash_emu_cut_after(&emu, 8);   // Header without seq and CRC
+    }
+    append_samples(SEGMENTS * PER_SEGMENT, 1);
+}
+
+static void boot_after_rollover_cut(void)
+{
+    // The half-recycled segment has no valid header: its old records are
+    // gone, the other segments are intact
+    ts_log_stats_t st;
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.segments_used, SEGMENTS - 1);
+    CHECK_EQ_INT(read_all(recs, SEGMENTS * PER_SEGMENT), 2 * PER_SEGMENT);
+    check_samples(recs, 2 * PER_SEGMENT, PER_SEGMENT);
+
+    // The next append recycles it properly
+    append_samples(SEGMENTS * PER_SEGMENT, 1);
+    ts_log_get_stats(&st);
+    CHECK_EQ_INT(st.segments_used, SEGMENTS);
+    CHECK_EQ_INT(read_all(recs, SEGMENTS * PER_SEGMENT), 2 * PER_SEGMENT + 1);
+    check_samples(recs, 2 * PER_SEGMENT + 1, PER_SEGMENT);
+}
+
+static void test_power_cut_in_rollover(void)
+{
+    for (int i = 0; i < 2; i++) {
+        new_flash();
+        cut_in_erase = i == 1;
+        CHECK_EQ_INT(boot(boot_fill_then_cut_rollover), FLASH_EMU_POWER_CUT_EXIT);
+        CHECK_EQ_INT(boot(boot_after_rollover_cut), 0);
+    }
+}
+
+int main(void)
+{
+    int fd = mkstemp(flash_path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    RUN_TEST(test_append_and_remount);
+    RUN_TEST(test_rollover);
+    RUN_TEST(test_power_cut_in_record);
+    RUN_TEST(test_power_cut_in_rollover);
+
+    unlink(flash_path);
+    return 0;
+}
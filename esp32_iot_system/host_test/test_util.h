@@ -0,0 +1,50 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <stdint.h>
+
+// Minimal test helpers: a failed check prints its location and exits, so
+// ctest reports the test as failed.
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_EQ_INT(a, b) do { \
+        long long va_ = (long long)(a), vb_ = (long long)(b); \
+        if (va_ != vb_) { \
+            fprintf(stderr, "%s:%d: %s == %s failed: %lld != %lld\n", \
+                    __FILE__, __LINE__, #a, #b, va_, vb_); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(a, b, tol) do { \
+        double va_ = (double)(a), vb_ = (double)(b); \
+        if (va_ - vb_ > (tol) || vb_ - va_ > (tol)) { \
+            fprintf(stderr, "%s:%d: %s ~= %s failed: %g != %g (tol %g)\n", \
+                    __FILE__, __LINE__, #a, #b, va_, vb_, (double)(tol)); \
+            exit(1); \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) do { \
+        printf("%-48s", #fn); \
+        fflush(stdout); \
+        fn(); \
+        printf("ok\n"); \
+    } while (0)
+
+static inline uint64_t test_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,220 @@
+// HTTP worker pool on the fake server: with both workers held by slow
+// handlers and the queue full, an inline handler (an /api/relay style
+// response) must answer as fast as with the pool idle, and one more slow
+// request must get 503 instead of blocking the server task.
+#include <string.h>
+#include <pthread.h>
+#include "test_util.h"
+#include "fake_httpd.h"
+#include "http_stream.h"
+#include "web_workers.h"
+#include "freertos/task.h"
+
+#define INLINE_RUNS         2000
+#define INLINE_P99_MAX_US   20000   // Far below the time the slow handlers are held
+#define WAIT_MAX_MS         5000
+
+// Slow handlers block on the gate until the test opens it
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_open;
+static uint32_t slow_started;
+static uint32_t slow_finished;
+
+static esp_err_t slow_handler(httpd_req_t *req)
+{
+    pthread_mutex_lock(&gate_lock);
+    slow_started++;
+    pthread_cond_broadcast(&gate_cond);
+    while (!gate_open) {
+        pthread_cond_wait(&gate_cond, &gate_lock);
+    }
+    slow_finished++;
+    pthread_mutex_unlock(&gate_lock);
+    return ESP_OK;
+}
+
+static uint32_t read_counter(const uint32_t *counter)
+{
+    pthread_mutex_lock(&gate_lock);
+    uint32_t v = *counter;
+    pthread_mutex_unlock(&gate_lock);
+    return v;
+}
+
+static void set_gate(bool open)
+{
+    pthread_mutex_lock(&gate_lock);
+    gate_open = open;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&gate_lock);
+}
+
+static bool wait_for(const uint32_t *counter, uint32_t value)
+{
+    for (int ms = 0; ms < WAIT_MAX_MS; ms++) {
+        if (read_counter(counter) >= value) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+static bool wait_completed(uint32_t value)
+{
+    for (int ms = 0; ms < WAIT_MAX_MS; ms++) {
+        if (__atomic_load_n(&fake_httpd.async_completed, __ATOMIC_RELAXED) >= value) {
+            return true;
+        }
+        vTaskDelay(1);
+    }
+    return false;
+}
+
+// Inline route, shaped like GET /api/relay
+static esp_err_t relay_handler(httpd_req_t *req)
+{
+    http_stream_t s;
+    json_writer_t *w = http_stream_begin(&s, req);
+    json_obj_begin(w, NULL);
+    json_uint(w, "state", 1);
+    json_uint(w, "mode", 0);
+    json_number(w, "threshold_high", 30.0, 1);
+    json_number(w, "threshold_low", 25.0, 1);
+    json_uint(w, "version", 7);
+    json_obj_end(w);
+    return http_stream_end(&s);
+}
+
+// Both workers parked in slow handlers, then every queue slot taken.
+// Queueing never waits on the workers, however long they are held.
+static void hold_workers_and_fill_queue(httpd_req_t *slow)
+{
+    for (int i = 0; i < WEB_WORKERS_COUNT; i++) {
+        CHECK_EQ_INT(web_workers_handler(slow), ESP_OK);
+    }
+    CHECK(wait_for(&slow_started, WEB_WORKERS_COUNT));
+    for (int i = 0; i < WEB_WORKERS_QUEUE_LEN; i++) {
+        uint64_t t0 = test_now_ns();
+        CHECK_EQ_INT(web_workers_handler(slow), ESP_OK);
+        CHECK(test_now_ns() - t0 < INLINE_P99_MAX_US * 1000ull);
+    }
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Runs the inline handler on this (server) thread; returns p99 in us
+static uint32_t inline_p99(const char *label)
+{
+    static uint32_t samples[INLINE_RUNS];
+    httpd_req_t req = { .uri = "/api/relay" };
+    for (int i = 0; i < INLINE_RUNS; i++) {
+        uint64_t t0 = test_now_ns();
+        CHECK_EQ_INT(relay_handler(&req), ESP_OK);
+        samples[i] = (uint32_t)((test_now_ns() - t0) / 1000);
+    }
+    qsort(samples, INLINE_RUNS, sizeof(samples[0]), cmp_u32);
+    uint32_t p50 = samples[INLINE_RUNS / 2];
+    uint32_t p99 = samples[INLINE_RUNS * 99 / 100];
+    printf("[/api/relay %s: p50 %u us, p99 %u us] ", label, (unsigned)p50, (unsigned)p99);
+    return p99;
+}
+
+static void test_inline_unaffected_by_busy_workers(void)
+{
+    web_workers_stats_t before, stats;
+    web_workers_get_stats(&before);
+    fake_httpd_reset(false);
+    set_gate(false);
+    slow_started = slow_finished = 0;
+
+    inline_p99("idle");
+
+    httpd_req_t slow = { .uri = "/api/log", .user_ctx = slow_handler };
+    hold_workers_and_fill_queue(&slow);
+    web_workers_get_stats(&stats);
+    CHECK_EQ_INT(stats.busy, WEB_WORKERS_COUNT);
+    CHECK_EQ_INT(stats.queue_depth, WEB_WORKERS_QUEUE_LEN);
+    CHECK_EQ_INT(stats.offloaded, before.offloaded + WEB_WORKERS_COUNT + WEB_WORKERS_QUEUE_LEN);
+
+    uint32_t busy_p99 = inline_p99("busy");
+    CHECK(busy_p99 < INLINE_P99_MAX_US);
+    CHECK_EQ_INT(read_counter(&slow_started), WEB_WORKERS_COUNT);
+
+    set_gate(true);
+    CHECK(wait_completed(WEB_WORKERS_COUNT + WEB_WORKERS_QUEUE_LEN));
+    CHECK_EQ_INT(read_counter(&slow_finished), WEB_WORKERS_COUNT + WEB_WORKERS_QUEUE_LEN);
+    web_workers_get_stats(&stats);
+    CHECK_EQ_INT(stats.busy, 0);
+    CHECK_EQ_INT(stats.queue_depth, 0);
+    CHECK_EQ_INT(stats.max_queue_depth, WEB_WORKERS_QUEUE_LEN);
+}
+
+// Queue full: 503 with Retry-After on the server thread, nothing detached
+static void test_queue_full_gets_503(void)
+{
+    web_workers_stats_t before, stats;
+    web_workers_get_stats(&before);
+    fake_httpd_reset(true);
+    set_gate(false);
+    slow_started = slow_finished = 0;
+
+    httpd_req_t slow = { .uri = "/api/history", .user_ctx = slow_handler };
+    hold_workers_and_fill_queue(&slow);
+    CHECK_EQ_INT(fake_httpd.len, 0);
+    uint32_t begun = __atomic_load_n(&fake_httpd.async_begun, __ATOMIC_RELAXED);
+
+    CHECK_EQ_INT(web_workers_offload(&slow, slow_handler), ESP_OK);
+    CHECK(strcmp(fake_httpd.status, "503 Service Unavailable") == 0);
+    CHECK(strcmp(fake_httpd.retry_after, "1") == 0);
+    CHECK(strcmp(fake_httpd.body, "Server busy") == 0);
+    CHECK_EQ_INT(fake_httpd.async_begun, begun);
+    web_workers_get_stats(&stats);
+    CHECK_EQ_INT(stats.rejected, before.rejected + 1);
+
+    set_gate(true);
+    CHECK(wait_completed(WEB_WORKERS_COUNT + WEB_WORKERS_QUEUE_LEN));
+    CHECK_EQ_INT(read_counter(&slow_finished), WEB_WORKERS_COUNT + WEB_WORKERS_QUEUE_LEN);
+}
+
+// A handler already on a worker that offloads again runs the inner
+// handler right there instead of queueing behind itself
+static volatile bool inner_on_worker;
+
+static esp_err_t inner_handler(httpd_req_t *req)
+{
+    inner_on_worker = web_workers_in_worker();
+    return ESP_OK;
+}
+
+static esp_err_t outer_handler(httpd_req_t *req)
+{
+    return web_workers_offload(req, inner_handler);
+}
+
+static void test_offload_from_worker_runs_inline(void)
+{
+    fake_httpd_reset(false);
+    inner_on_worker = false;
+    CHECK(!web_workers_in_worker());
+
+    httpd_req_t req = { .uri = "/api/sensors", .user_ctx = outer_handler };
+    CHECK_EQ_INT(web_workers_handler(&req), ESP_OK);
+    CHECK(wait_completed(1));
+    CHECK_EQ_INT(fake_httpd.async_begun, 1);
+    CHECK(inner_on_worker);
+}
+
+int main(void)
+{
+    CHECK_EQ_INT(web_workers_init(), ESP_OK);
+    RUN_TEST(test_inline_unaffected_by_busy_workers);
+    RUN_TEST(test_queue_full_gets_503);
+    RUN_TEST(test_offload_from_worker_runs_inline);
+    return 0;
+}
@@ -0,0 +1,54 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+#include "alloc_counter.h"
+
+static TaskHandle_t tracked_tasks[ALLOC_COUNTER_MAX_TASKS];
+static volatile uint32_t alloc_count;
+
+void alloc_counter_track_current_task(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < ALLOC_COUNTER_MAX_TASKS; i++) {
+        TaskHandle_t expected = NULL;
+        if (tracked_tasks[i] == self ||
+            __atomic_compare_exchange_n(&tracked_tasks[i], &expected, self, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+uint32_t alloc_counter_get(void)
+{
+    return __atomic_load_n(&alloc_count, __ATOMIC_RELAXED);
+}
+
+bool alloc_counter_enabled(void)
+{
+#if CONFIG_HEAP_USE_HOOKS
+    return true;
+#else
+    return false;
+#endif
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+// Called by the heap component after every successful allocation; must not
+// allocate or block
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (xPortInIsrContext()) {
+        return;
+    }
+
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < ALLOC_COUNTER_MAX_TASKS; i++) {
+        if (__atomic_load_n(&tracked_tasks[i], __ATOMIC_ACQUIRE) == self) {
+            __atomic_fetch_add(&alloc_count, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+#endif
@@ -0,0 +1,20 @@
+#ifndef ALLOC_COUNTER_H
+#define ALLOC_COUNTER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Counts heap allocations made by selected tasks, using the heap
+// allocation hooks (CONFIG_HEAP_USE_HOOKS). Without the hooks the counter
+// stays at zero and alloc_counter_enabled() returns false.
+#define ALLOC_COUNTER_MAX_TASKS     4
+
+// Starts counting allocations made by the calling task
+void alloc_counter_track_current_task(void);
+
+// Total allocations made by all tracked tasks so far
+uint32_t alloc_counter_get(void);
+
+bool alloc_counter_enabled(void);
+
+#endif
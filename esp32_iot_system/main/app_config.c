@@ -0,0 +1,480 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "app_config.h"
+#include "nvs_storage.h"
+#include "seqlock.h"
+
+static const char *TAG = "APP_CONFIG";
+
+#define CONFIG_COMMIT_TASK_STACK    3072
+#define CONFIG_COMMIT_TASK_PRIO     2
+#define CONFIG_SHUTDOWN_WAIT_MS 100
+#define CONFIG_RETRY_MIN_MS     1000    // First retry after a failed commit
+#define CONFIG_RETRY_MAX_MS     60000   // Retry delay doubles up to this
+
+typedef struct {
+    app_config_cb_t cb;
+    void *arg;
+} config_subscriber_t;
+
+// Double-buffered for the seqlock; only written with write_mutex held
+static app_config_t config_buf[2];
+static seqlock_t config_lock;
+static SemaphoreHandle_t write_mutex;
+
+static config_subscriber_t subscribers[APP_CONFIG_MAX_SUBSCRIBERS];
+static int subscriber_count;
+
+// Deferred NVS writes: persisted mirrors NVS, pending_changes counts the
+// changes since the last flush (all guarded by write_mutex)
+static app_config_t persisted;
+static uint32_t pending_changes;
+static app_config_commit_stats_t commit_stats;
+static volatile uint32_t commit_window_ms = APP_CONFIG_COMMIT_WINDOW_DEFAULT_MS;
+static TaskHandle_t commit_task;
+
+// Write made by a subscriber from its callback, applied once the change
+// being announced has reached every subscriber (guarded by write_mutex)
+static app_config_t followup;
+static bool followup_pending;
+
+// Boot load
+static storage_config_source_t load_source;
+static uint32_t load_us;
+
+static void publish(const app_config_t *config)
+{
+    uint32_t idx = seqlock_write_next(&config_lock);
+    config_buf[idx] = *config;
+    idx = seqlock_write_next(&config_lock);
+    config_buf[idx] = *config;
+}
+
+static void from_stored(const storage_config_t *stored, app_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->relay_state = stored->relay_state;
+    config->auto_mode = stored->auto_mode;
+    config->temp_high = stored->temp_high;
+    config->temp_low = stored->temp_low;
+    config->bmp180_oss = stored->bmp180_oss;
+    config->bmp180_temp_every_n = stored->bmp180_temp_every_n;
+    config->bmp180_temp_max_age_ms = stored->bmp180_temp_max_age_ms;
+}
+
+static void to_stored(const app_config_t *config, storage_config_t *stored)
+{
+    storage_config_defaults(stored);
+    stored->relay_state = config->relay_state;
+    stored->auto_mode = config->auto_mode;
+    stored->temp_high = config->temp_high;
+    stored->temp_low = config->temp_low;
+    stored->bmp180_oss = config->bmp180_oss;
+    stored->bmp180_temp_every_n = config->bmp180_temp_every_n;
+    stored->bmp180_temp_max_age_ms = config->bmp180_temp_max_age_ms;
+}
+
+// Fields that differ between two configurations
+static uint32_t diff_fields(const app_config_t *a, const app_config_t *b)
+{
+    uint32_t changed = 0;
+    if (a->relay_state != b->relay_state) {
+        changed |= APP_CONFIG_RELAY_STATE;
+    }
+    if (a->auto_mode != b->auto_mode) {
+        changed |= APP_CONFIG_AUTO_MODE;
+    }
+    if (a->temp_high != b->temp_high || a->temp_low != b->temp_low) {
+        changed |= APP_CONFIG_THRESHOLDS;
+    }
+    if (a->bmp180_oss != b->bmp180_oss) {
+        changed |= APP_CONFIG_BMP180_OSS;
+    }
+    if (a->bmp180_temp_every_n != b->bmp180_temp_every_n ||
+        a->bmp180_temp_max_age_ms != b->bmp180_temp_max_age_ms) {
+        changed |= APP_CONFIG_BMP180_TEMP_REFRESH;
+    }
+    return changed;
+}
+
+// Publishes, notifies and schedules the NVS write (write_mutex held).
+// Follow-up writes staged by subscribers are committed in turn.
+static void commit(const app_config_t *old, const app_config_t *config)
+{
+    app_config_t prev = *old;
+    app_config_t next = *config;
+
+    while (1) {
+        uint32_t changed = diff_fields(&prev, &next);
+        if (changed != 0) {
+            publish(&next);
+            for (int i = 0; i < subscriber_count; i++) {
+                subscribers[i].cb(&next, changed, subscribers[i].arg);
+            }
+
+            pending_changes++;
+            if (commit_task != NULL) {
+                xTaskNotifyGive(commit_task);
+            }
+        }
+
+        if (!followup_pending) {
+            return;
+        }
+        followup_pending = false;
+        prev = next;
+        next = followup;
+    }
+}
+
+// Writes every field that differs from what NVS holds in one commit
+// (write_mutex held). On failure the changes stay pending, uncounted,
+// and the commit task is woken to retry.
+static esp_err_t flush_locked(void)
+{
+    uint32_t requests = pending_changes;
+    pending_changes = 0;
+    if (requests == 0) {
+        return ESP_OK;
+    }
+
+    app_config_t config;
+    app_config_get(&config);
+    uint32_t dirty = diff_fields(&persisted, &config);
+
+    esp_err_t ret = ESP_OK;
+    if (dirty != 0) {
+        storage_config_t stored;
+        to_stored(&config, &stored);
+        ret = storage_save_config(&stored);
+    }
+
+    if (ret != ESP_OK) {
+        pending_changes += requests;
+        commit_stats.commit_errors++;
+        if (commit_task != NULL) {
+            xTaskNotifyGive(commit_task);
+        }
+        return ret;
+    }
+
+    persisted = config;
+    uint32_t performed = dirty != 0 ? 1 : 0;
+    commit_stats.changes += requests;
+    commit_stats.commits += performed;
+    commit_stats.commits_avoided += requests - performed;
+    return ret;
+}
+
+// Waits for the first change, lets further changes pile up for the
+// commit window, then writes them together. After a failed commit the
+// next attempt is delayed further each time.
+static void config_commit_task(void *pvParameters)
+{
+    uint32_t backoff_ms = 0;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        vTaskDelay(pdMS_TO_TICKS(commit_window_ms + backoff_ms));
+        ulTaskNotifyTake(pdTRUE, 0);
+
+        xSemaphoreTake(write_mutex, portMAX_DELAY);
+        esp_err_t err = flush_locked();
+        xSemaphoreGive(write_mutex);
+
+        if (err == ESP_OK) {
+            backoff_ms = 0;
+        } else {
+            backoff_ms = backoff_ms == 0 ? CONFIG_RETRY_MIN_MS : backoff_ms * 2;
+            if (backoff_ms > CONFIG_RETRY_MAX_MS) {
+                backoff_ms = CONFIG_RETRY_MAX_MS;
+            }
+            ESP_LOGW(TAG, "Config commit failed (%s), retrying in %lu ms",
+                     esp_err_to_name(err), (unsigned long)backoff_ms);
+        }
+    }
+}
+
+// Runs from esp_restart(): write whatever is still pending
+static void flush_on_shutdown(void)
+{
+    if (xSemaphoreTake(write_mutex, pdMS_TO_TICKS(CONFIG_SHUTDOWN_WAIT_MS)) == pdTRUE) {
+        flush_locked();
+        xSemaphoreGive(write_mutex);
+    }
+}
+
+esp_err_t app_config_init(void)
+{
+    if (write_mutex != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    write_mutex = xSemaphoreCreateMutex();
+    if (write_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Single blob read (migration or defaults handled by nvs_storage)
+    int64_t start_us = esp_timer_get_time();
+    storage_config_t stored;
+    esp_err_t err = storage_load_config(&stored, &load_source);
+    load_us = (uint32_t)(esp_timer_get_time() - start_us);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Config load failed (%s), using defaults", esp_err_to_name(err));
+    }
+
+    app_config_t config;
+    from_stored(&stored, &config);
+    publish(&config);
+    persisted = config;
+
+    if (xTaskCreate(config_commit_task, "config_commit", CONFIG_COMMIT_TASK_STACK, NULL,
+                    CONFIG_COMMIT_TASK_PRIO, &commit_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_register_shutdown_handler(flush_on_shutdown);
+
+    ESP_LOGI(TAG, "Configuration loaded from %s in %lu us", app_config_load_source(), (unsigned long)load_us);
+    return ESP_OK;
+}
+
+void app_config_get(app_config_t *out)
+{
+    app_config_get_versioned(out);
+}
+
+// The copy at seq & 1 always holds generation seq / 2
+uint32_t app_config_get_versioned(app_config_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&config_lock);
+        *out = config_buf[seq & 1];
+    } while (seqlock_read_retry(&config_lock, seq));
+    return seq / 2;
+}
+
+uint32_t app_config_version(void)
+{
+    return seqlock_generation(&config_lock);
+}
+
+esp_err_t app_config_subscribe(app_config_cb_t cb, void *arg)
+{
+    if (write_mutex == NULL || cb == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    if (subscriber_count < APP_CONFIG_MAX_SUBSCRIBERS) {
+        subscribers[subscriber_count].cb = cb;
+        subscribers[subscriber_count].arg = arg;
+        subscriber_count++;
+
+        app_config_t config;
+        app_config_get(&config);
+        cb(&config, APP_CONFIG_ALL, arg);
+        if (followup_pending) {
+            app_config_t next = followup;
+            followup_pending = false;
+            commit(&config, &next);
+        }
+    } else {
+        ret = ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(write_mutex);
+    return ret;
+}
+
+// Read-modify-write helpers: take the mutex, start from the current
+// values and commit the result. A subscriber writing from its callback
+// already holds the mutex; its change is staged as a follow-up instead
+// (returns true) and committed after the current one.
+static bool update_begin(app_config_t *old, app_config_t *config)
+{
+    if (xSemaphoreGetMutexHolder(write_mutex) == xTaskGetCurrentTaskHandle()) {
+        app_config_get(old);
+        *config = followup_pending ? followup : *old;
+        return true;
+    }
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    app_config_get(old);
+    *config = *old;
+    return false;
+}
+
+static esp_err_t update_end(bool nested, const app_config_t *old, const app_config_t *config)
+{
+    if (nested) {
+        followup = *config;
+        followup_pending = true;
+        return ESP_OK;
+    }
+    commit(old, config);
+    xSemaphoreGive(write_mutex);
+    return ESP_OK;
+}
+
+esp_err_t app_config_set_relay_state(uint8_t state)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+    config.relay_state = state;
+    return update_end(nested, &old, &config);
+}
+
+esp_err_t app_config_set_auto_mode(uint8_t auto_mode)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+    config.auto_mode = auto_mode;
+    return update_end(nested, &old, &config);
+}
+
+esp_err_t app_config_set_thresholds(float temp_high, float temp_low)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+    config.temp_high = temp_high;
+    config.temp_low = temp_low;
+    return update_end(nested, &old, &config);
+}
+
+esp_err_t app_config_set_bmp180_oss(uint8_t oss)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+    config.bmp180_oss = oss;
+    return update_end(nested, &old, &config);
+}
+
+esp_err_t app_config_set_bmp180_temp_refresh(uint16_t every_n, uint32_t max_age_ms)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+    config.bmp180_temp_every_n = every_n;
+    config.bmp180_temp_max_age_ms = max_age_ms;
+    return update_end(nested, &old, &config);
+}
+
+esp_err_t app_config_update(const app_config_t *update, uint32_t fields,
+                            uint32_t expected_version, uint32_t *new_version)
+{
+    if (write_mutex == NULL || update == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    app_config_t old, config;
+    bool nested = update_begin(&old, &config);
+
+    // Checked under the mutex, so no other writer can slip in between
+    if (expected_version != 0 && expected_version != app_config_version()) {
+        if (!nested) {
+            xSemaphoreGive(write_mutex);
+        }
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    if (fields & APP_CONFIG_RELAY_STATE) {
+        config.relay_state = update->relay_state;
+    }
+    if (fields & APP_CONFIG_AUTO_MODE) {
+        config.auto_mode = update->auto_mode;
+    }
+    if (fields & APP_CONFIG_THRESHOLDS) {
+        config.temp_high = update->temp_high;
+        config.temp_low = update->temp_low;
+    }
+    if (fields & APP_CONFIG_BMP180_OSS) {
+        config.bmp180_oss = update->bmp180_oss;
+    }
+    if (fields & APP_CONFIG_BMP180_TEMP_REFRESH) {
+        config.bmp180_temp_every_n = update->bmp180_temp_every_n;
+        config.bmp180_temp_max_age_ms = update->bmp180_temp_max_age_ms;
+    }
+
+    if (nested) {
+        // Committed after the change being announced, version not known yet
+        if (new_version != NULL) {
+            *new_version = 0;
+        }
+        return update_end(nested, &old, &config);
+    }
+    commit(&old, &config);
+    if (new_version != NULL) {
+        *new_version = app_config_version();
+    }
+    xSemaphoreGive(write_mutex);
+    return ESP_OK;
+}
+
+esp_err_t app_config_flush(void)
+{
+    if (write_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    esp_err_t ret = flush_locked();
+    xSemaphoreGive(write_mutex);
+    return ret;
+}
+
+void app_config_set_commit_window(uint32_t window_ms)
+{
+    commit_window_ms = window_ms;
+}
+
+uint32_t app_config_get_commit_window(void)
+{
+    return commit_window_ms;
+}
+
+void app_config_get_commit_stats(app_config_commit_stats_t *stats)
+{
+    if (write_mutex == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    xSemaphoreTake(write_mutex, portMAX_DELAY);
+    *stats = commit_stats;
+    stats->pending = pending_changes;
+    xSemaphoreGive(write_mutex);
+}
+
+uint32_t app_config_load_us(void)
+{
+    return load_us;
+}
+
+const char *app_config_load_source(void)
+{
+    switch (load_source) {
+    case STORAGE_CONFIG_BLOB:
+        return "blob";
+    case STORAGE_CONFIG_MIGRATED:
+        return "migrated";
+    default:
+        return "defaults";
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sdkconfig.h"
+#include "app_config_defaults.h"
+
+// All persisted settings, loaded from NVS once at boot and kept in RAM.
+// Reads are lock-free (seqlock); writes are serialized and announced to
+// subscribers right away. NVS is written by a background task: changes
+// within the commit window are merged into a single commit, and anything
+// pending is flushed from a shutdown handler on esp_restart().
+typedef struct {
+    uint8_t relay_state;
+    uint8_t auto_mode;
+    float temp_high;
+    float temp_low;
+    uint8_t bmp180_oss;
+    uint16_t bmp180_temp_every_n;
+    uint32_t bmp180_temp_max_age_ms;
+} app_config_t;
+
+// Changed-field bits passed to subscribers
+#define APP_CONFIG_RELAY_STATE          (1u << 0)
+#define APP_CONFIG_AUTO_MODE            (1u << 1)
+#define APP_CONFIG_THRESHOLDS           (1u << 2)
+#define APP_CONFIG_BMP180_OSS           (1u << 3)
+#define APP_CONFIG_BMP180_TEMP_REFRESH  (1u << 4)
+#define APP_CONFIG_ALL                  0x1Fu
+
+#define APP_CONFIG_MAX_SUBSCRIBERS      8
+#define APP_CONFIG_COMMIT_WINDOW_DEFAULT_MS CONFIG_APP_CONFIG_COMMIT_WINDOW_MS
+
+typedef struct {
+    uint32_t changes;           // Setter calls that changed a value
+    uint32_t commits;           // Successful NVS commits
+    uint32_t commits_avoided;   // Changes merged into another commit or reverted in time
+    uint32_t commit_errors;     // Failed commits, retried with backoff
+    uint32_t pending;           // Changes waiting for the commit window
+} app_config_commit_stats_t;
+
+// Called on the writing task, after the new values are visible to readers
+// and while further writes are held off; keep it short. Setters called
+// from the callback do not block: the change is committed (and announced)
+// right after the current one has reached every subscriber.
+typedef void (*app_config_cb_t)(const app_config_t *config, uint32_t changed, void *arg);
+
+// Loads the config blob from NVS, timing the load (storage_init first)
+esp_err_t app_config_init(void);
+
+void app_config_get(app_config_t *out);
+
+// Increments on every change
+uint32_t app_config_version(void);
+
+// Same as app_config_get(), also returning the version of that copy
+uint32_t app_config_get_versioned(app_config_t *out);
+
+// The callback is also invoked once right away with APP_CONFIG_ALL
+esp_err_t app_config_subscribe(app_config_cb_t cb, void *arg);
+
+// Setters update RAM and notify subscribers; the NVS write follows within
+// the commit window. Unchanged values are neither written nor announced.
+esp_err_t app_config_set_relay_state(uint8_t state);
+esp_err_t app_config_set_auto_mode(uint8_t auto_mode);
+esp_err_t app_config_set_thresholds(float temp_high, float temp_low);
+esp_err_t app_config_set_bmp180_oss(uint8_t oss);
+esp_err_t app_config_set_bmp180_temp_refresh(uint16_t every_n, uint32_t max_age_ms);
+
+// Applies the fields selected by the APP_CONFIG_* mask from config as one
+// change: readers and subscribers see them together and they are written
+// in the same NVS commit. With expected_version != 0 nothing is applied
+// unless the current version still matches (ESP_ERR_INVALID_VERSION).
+// new_version (optional) receives the version after the update.
+esp_err_t app_config_update(const app_config_t *config, uint32_t fields,
+                            uint32_t expected_version, uint32_t *new_version);
+
+// Writes pending changes now
+esp_err_t app_config_flush(void);
+
+// Commit window, CONFIG_APP_CONFIG_COMMIT_WINDOW_MS (menuconfig) until
+// changed at run time
+void app_config_set_commit_window(uint32_t window_ms);
+uint32_t app_config_get_commit_window(void);
+void app_config_get_commit_stats(app_config_commit_stats_t *stats);
+
+// Boot load time and where the settings came from ("blob", "migrated", "defaults")
+uint32_t app_config_load_us(void);
+const char *app_config_load_source(void);
+
+#endif
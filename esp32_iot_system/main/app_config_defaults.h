@@ -0,0 +1,15 @@
+#ifndef APP_CONFIG_DEFAULTS_H
+#define APP_CONFIG_DEFAULTS_H
+
+// Factory values of the persisted settings, used when NVS holds nothing
+// usable. Kept in a header of their own so the storage layer does not
+// depend on the modules that consume the settings.
+#define APP_CONFIG_DEFAULT_RELAY_STATE          0
+#define APP_CONFIG_DEFAULT_AUTO_MODE            0       // Manual
+#define APP_CONFIG_DEFAULT_TEMP_HIGH            30.0f   // °C
+#define APP_CONFIG_DEFAULT_TEMP_LOW             25.0f   // °C
+#define APP_CONFIG_DEFAULT_BMP180_OSS           0
+#define APP_CONFIG_DEFAULT_BMP180_TEMP_EVERY_N  1       // Temperature on every cycle
+#define APP_CONFIG_DEFAULT_BMP180_TEMP_MAX_AGE_MS 60000
+
+#endif
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "http_stream.h"
+
+static const char *TAG = "HTTP_STREAM";
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static http_stream_stats_t stream_stats;
+
+// json_writer flush callback: the window is full, send it as a chunk
+static esp_err_t send_window(void *ctx, const char *data, size_t len)
+{
+    http_stream_t *s = ctx;
+    esp_err_t err = httpd_resp_send_chunk(s->req, data, len);
+    if (err == ESP_OK) {
+        s->chunks++;
+    }
+    return err;
+}
+
+static void record(const http_stream_t *s, bool ok)
+{
+    portENTER_CRITICAL(&stats_lock);
+    stream_stats.responses++;
+    if (s->chunks > 0) {
+        stream_stats.chunked++;
+        stream_stats.chunks += s->chunks;
+    }
+    if (!ok) {
+        stream_stats.errors++;
+    }
+    stream_stats.bytes += s->w.total;
+    if (s->w.total > stream_stats.max_bytes) {
+        stream_stats.max_bytes = s->w.total;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+json_writer_t *http_stream_begin(http_stream_t *s, httpd_req_t *req)
+{
+    s->req = req;
+    s->chunks = 0;
+    json_writer_init(&s->w, s->window, sizeof(s->window), send_window, s);
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    return &s->w;
+}
+
+esp_err_t http_stream_end(http_stream_t *s)
+{
+    json_writer_t *w = &s->w;
+    if (s->chunks == 0 && w->err == ESP_OK && w->depth == 0) {
+        esp_err_t err = httpd_resp_send(s->req, w->buf, w->len);
+        record(s, err == ESP_OK);
+        return err;
+    }
+    
+    esp_err_t err = json_writer_finish(w);
+    if (err == ESP_OK) {
+        err = httpd_resp_send_chunk(s->req, NULL, 0);
+    } else {
+        ESP_LOGE(TAG, "%s: response failed after %u bytes: %s",
+                 s->req->uri, (unsigned)w->total, esp_err_to_name(err));
+        if (s->chunks == 0) {
+            httpd_resp_send_err(s->req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
+        }
+    }
+    record(s, err == ESP_OK);
+    return err == ESP_OK ? ESP_OK : ESP_FAIL;
+}
+
+void http_stream_get_stats(http_stream_stats_t *stats)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *stats = stream_stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
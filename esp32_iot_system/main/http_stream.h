@@ -0,0 +1,55 @@
+#ifndef HTTP_STREAM_H
+#define HTTP_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+
+// Response body streaming for the JSON API. Producers write through a
+// json_writer whose buffer is a fixed window inside http_stream_t (on the
+// handler's stack). A body that fits in the window goes out with one
+// httpd_resp_send(); a larger one is sent with httpd_resp_send_chunk()
+// each time the window fills. Memory per request does not grow with the
+// response size and no heap is used.
+//
+//   http_stream_t s;
+//   json_writer_t *w = http_stream_begin(&s, req);
+//   json_obj_begin(w, NULL);
+//   ...
+//   json_obj_end(w);
+//   return http_stream_end(&s);
+
+#define HTTP_STREAM_WINDOW  512
+
+typedef struct {
+    httpd_req_t *req;
+    json_writer_t w;
+    uint32_t chunks;            // Chunks sent so far, 0 while everything fits
+    char window[HTTP_STREAM_WINDOW];
+} http_stream_t;
+
+typedef struct {
+    uint32_t responses;
+    uint32_t chunked;           // Responses larger than the window
+    uint32_t chunks;
+    uint32_t errors;            // Send failures and malformed output
+    uint64_t bytes;
+    uint32_t max_bytes;         // Largest response body
+} http_stream_stats_t;
+
+// Sets the JSON content type and CORS header. Other headers and the status
+// must be set before the output first exceeds the window (in practice:
+// before writing anything).
+json_writer_t *http_stream_begin(http_stream_t *s, httpd_req_t *req);
+
+// Sends what is left and ends the response. If nothing has gone out yet
+// and the output is malformed, a 500 is sent instead; once chunks are on
+// the wire the response is just cut short.
+esp_err_t http_stream_end(http_stream_t *s);
+
+void http_stream_get_stats(http_stream_stats_t *stats);
+
+#endif
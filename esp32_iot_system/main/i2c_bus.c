@@ -0,0 +1,244 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "i2c_bus.h"
+#include "alloc_counter.h"
+
+static const char *TAG = "I2C_BUS";
+
+#define I2C_BUS_QUEUE_LEN       8
+#define I2C_BUS_TASK_STACK      3072
+#define I2C_BUS_TASK_PRIO       6
+
+// A queued transaction. Lives on the caller's stack until it is completed.
+typedef struct {
+    void *handle;               // Device handle, NULL for a probe
+    uint8_t addr;
+    uint32_t timeout_ms;
+    const uint8_t *tx;
+    size_t tx_len;
+    uint8_t *rx;
+    size_t rx_len;
+    i2c_bus_prio_t prio;
+    int64_t enqueue_us;
+    esp_err_t result;
+    SemaphoreHandle_t done;
+} i2c_bus_txn_t;
+
+static i2c_bus_backend_t bus_backend;
+static QueueHandle_t prio_queues[I2C_BUS_PRIO_COUNT];
+static SemaphoreHandle_t pending_sem;   // One count per queued transaction
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static i2c_bus_stats_t bus_stats;
+
+// Scheduler: always serves the highest-priority queue that has work
+static void i2c_bus_task(void *pvParameters)
+{
+    alloc_counter_track_current_task();
+
+    while (1) {
+        xSemaphoreTake(pending_sem, portMAX_DELAY);
+
+        i2c_bus_txn_t *txn = NULL;
+        for (int prio = 0; prio < I2C_BUS_PRIO_COUNT && txn == NULL; prio++) {
+            if (xQueueReceive(prio_queues[prio], &txn, 0) != pdTRUE) {
+                txn = NULL;
+            }
+        }
+        if (txn == NULL) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        uint32_t wait_us = (uint32_t)(start_us - txn->enqueue_us);
+        uint32_t timeout_ms = txn->timeout_ms;
+        bool expired = wait_us >= timeout_ms * 1000;
+
+        if (expired) {
+            txn->result = ESP_ERR_TIMEOUT;
+        } else {
+            uint32_t remaining_ms = timeout_ms - wait_us / 1000;
+            if (remaining_ms == 0) {
+                remaining_ms = 1;
+            }
+            if (txn->handle == NULL) {
+                txn->result = bus_backend.probe(bus_backend.ctx, txn->addr, remaining_ms);
+            } else {
+                txn->result = bus_backend.transfer(bus_backend.ctx, txn->handle,
+                                                   txn->tx, txn->tx_len,
+                                                   txn->rx, txn->rx_len, remaining_ms);
+            }
+        }
+        int64_t end_us = esp_timer_get_time();
+
+        portENTER_CRITICAL(&stats_lock);
+        i2c_bus_prio_stats_t *ps = &bus_stats.prio[txn->prio];
+        ps->queue_depth--;
+        ps->transactions++;
+        ps->total_wait_us += wait_us;
+        if (wait_us > ps->max_wait_us) {
+            ps->max_wait_us = wait_us;
+        }
+        if (expired) {
+            ps->timeouts++;
+        } else if (txn->result != ESP_OK) {
+            ps->errors++;
+        }
+        bus_stats.busy_us += end_us - start_us;
+        portEXIT_CRITICAL(&stats_lock);
+
+        xSemaphoreGive(txn->done);
+    }
+}
+
+esp_err_t i2c_bus_init(const i2c_bus_backend_t *backend)
+{
+    if (pending_sem != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (backend == NULL || backend->add_device == NULL ||
+        backend->transfer == NULL || backend->probe == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bus_backend = *backend;
+    if (bus_backend.init) {
+        esp_err_t ret = bus_backend.init(bus_backend.ctx);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    for (int prio = 0; prio < I2C_BUS_PRIO_COUNT; prio++) {
+        prio_queues[prio] = xQueueCreate(I2C_BUS_QUEUE_LEN, sizeof(i2c_bus_txn_t *));
+        if (prio_queues[prio] == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    pending_sem = xSemaphoreCreateCounting(I2C_BUS_QUEUE_LEN * I2C_BUS_PRIO_COUNT, 0);
+    if (pending_sem == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(i2c_bus_task, "i2c_bus", I2C_BUS_TASK_STACK, NULL,
+                    I2C_BUS_TASK_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "I2C bus manager started");
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_add_device(i2c_bus_device_t *dev)
+{
+    if (pending_sem == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    esp_err_t ret = bus_backend.add_device(bus_backend.ctx, dev->addr, &dev->handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to add device 0x%02X: %s", dev->addr, esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t i2c_bus_submit(void *handle, uint8_t addr, uint32_t timeout_ms,
+                                i2c_bus_prio_t prio,
+                                const uint8_t *tx, size_t tx_len,
+                                uint8_t *rx, size_t rx_len)
+{
+    if (pending_sem == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (prio >= I2C_BUS_PRIO_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Completion semaphore lives on the stack, no heap per transaction
+    StaticSemaphore_t done_buf;
+    i2c_bus_txn_t txn = {
+        .handle = handle,
+        .addr = addr,
+        .timeout_ms = timeout_ms,
+        .tx = tx,
+        .tx_len = tx_len,
+        .rx = rx,
+        .rx_len = rx_len,
+        .prio = prio,
+        .enqueue_us = esp_timer_get_time(),
+        .result = ESP_FAIL,
+        .done = xSemaphoreCreateBinaryStatic(&done_buf),
+    };
+    i2c_bus_txn_t *txn_ptr = &txn;
+
+    portENTER_CRITICAL(&stats_lock);
+    i2c_bus_prio_stats_t *ps = &bus_stats.prio[prio];
+    ps->queue_depth++;
+    if (ps->queue_depth > ps->max_queue_depth) {
+        ps->max_queue_depth = ps->queue_depth;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (xQueueSend(prio_queues[prio], &txn_ptr, pdMS_TO_TICKS(timeout_ms)) != pdTRUE) {
+        portENTER_CRITICAL(&stats_lock);
+        ps->queue_depth--;
+        ps->timeouts++;
+        portEXIT_CRITICAL(&stats_lock);
+        vSemaphoreDelete(txn.done);
+        ESP_LOGW(TAG, "Queue full, dropping transaction to 0x%02X", addr);
+        return ESP_ERR_TIMEOUT;
+    }
+    xSemaphoreGive(pending_sem);
+
+    // The bus task always completes the transaction (possibly as expired),
+    // so txn must stay alive until then
+    xSemaphoreTake(txn.done, portMAX_DELAY);
+    vSemaphoreDelete(txn.done);
+    return txn.result;
+}
+
+static esp_err_t i2c_bus_submit_dev(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                                    const uint8_t *tx, size_t tx_len,
+                                    uint8_t *rx, size_t rx_len)
+{
+    if (dev == NULL || dev->handle == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return i2c_bus_submit(dev->handle, dev->addr, dev->timeout_ms, prio, tx, tx_len, rx, rx_len);
+}
+
+esp_err_t i2c_bus_write(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                        const uint8_t *data, size_t len)
+{
+    return i2c_bus_submit_dev(dev, prio, data, len, NULL, 0);
+}
+
+esp_err_t i2c_bus_read(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                       uint8_t *data, size_t len)
+{
+    return i2c_bus_submit_dev(dev, prio, NULL, 0, data, len);
+}
+
+esp_err_t i2c_bus_write_read(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                             const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len)
+{
+    return i2c_bus_submit_dev(dev, prio, tx, tx_len, rx, rx_len);
+}
+
+esp_err_t i2c_bus_probe(uint8_t addr, uint32_t timeout_ms, i2c_bus_prio_t prio)
+{
+    return i2c_bus_submit(NULL, addr, timeout_ms, prio, NULL, 0, NULL, 0);
+}
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *stats = bus_stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
@@ -0,0 +1,80 @@
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Pin definitions (theo board ESP32-S3 thực tế)
+#define I2C_MASTER_SCL_IO           2     // SCL pin (IO2)
+#define I2C_MASTER_SDA_IO           1     // SDA pin (IO1)
+#define I2C_MASTER_NUM              0     // I2C port number
+#define I2C_MASTER_FREQ_HZ          50000  // Giảm từ 100kHz xuống 50kHz
+
+// Transaction priority, lower value is served first
+typedef enum {
+    I2C_BUS_PRIO_CONTROL = 0,   // Control-loop sensor reads
+    I2C_BUS_PRIO_NORMAL,        // Init, configuration
+    I2C_BUS_PRIO_DIAG,          // Diagnostics such as the bus scanner
+    I2C_BUS_PRIO_COUNT
+} i2c_bus_prio_t;
+
+// A device on the bus. timeout_ms bounds the whole transaction, queueing
+// included: a request that is still waiting for the bus when it expires
+// fails with ESP_ERR_TIMEOUT without being started. handle is filled in by
+// i2c_bus_add_device() and owned by the backend.
+typedef struct {
+    uint8_t addr;
+    uint32_t timeout_ms;
+    void *handle;
+} i2c_bus_device_t;
+
+// Bus backend. transfer() runs one transaction on a device added with
+// add_device(): write tx (if any), then read rx (if any) after a repeated
+// start. probe() checks whether any device acks the address.
+typedef struct {
+    esp_err_t (*init)(void *ctx);
+    esp_err_t (*add_device)(void *ctx, uint8_t addr, void **handle);
+    esp_err_t (*transfer)(void *ctx, void *handle,
+                          const uint8_t *tx, size_t tx_len,
+                          uint8_t *rx, size_t rx_len, uint32_t timeout_ms);
+    esp_err_t (*probe)(void *ctx, uint8_t addr, uint32_t timeout_ms);
+    void *ctx;
+} i2c_bus_backend_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t errors;
+    uint32_t timeouts;          // Expired while waiting for the bus
+    uint32_t queue_depth;       // Currently waiting
+    uint32_t max_queue_depth;
+    uint64_t total_wait_us;
+    uint32_t max_wait_us;
+} i2c_bus_prio_stats_t;
+
+typedef struct {
+    i2c_bus_prio_stats_t prio[I2C_BUS_PRIO_COUNT];
+    uint64_t busy_us;           // Time spent inside backend transfers
+} i2c_bus_stats_t;
+
+// Owns the bus and starts the scheduler task on the given backend:
+// i2c_bus_hw_backend (i2c_bus_hw.h) on the device, a fake one in host tests.
+// init is optional, the other callbacks are required.
+esp_err_t i2c_bus_init(const i2c_bus_backend_t *backend);
+
+// Creates the backend handle for dev. Call once per device, before use.
+esp_err_t i2c_bus_add_device(i2c_bus_device_t *dev);
+
+// Blocking calls, usable from any task. They do not allocate memory.
+esp_err_t i2c_bus_write(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                        const uint8_t *data, size_t len);
+esp_err_t i2c_bus_read(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                       uint8_t *data, size_t len);
+esp_err_t i2c_bus_write_read(const i2c_bus_device_t *dev, i2c_bus_prio_t prio,
+                             const uint8_t *tx, size_t tx_len,
+                             uint8_t *rx, size_t rx_len);
+esp_err_t i2c_bus_probe(uint8_t addr, uint32_t timeout_ms, i2c_bus_prio_t prio);
+
+void i2c_bus_get_stats(i2c_bus_stats_t *stats);
+
+#endif
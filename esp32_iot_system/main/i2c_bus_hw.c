@@ -0,0 +1,72 @@
+#include "driver/i2c_master.h"
+#include "esp_log.h"
+#include "i2c_bus_hw.h"
+
+static const char *TAG = "I2C_BUS_HW";
+
+// Hardware backend (i2c_master driver). Device handles are created once at
+// init, transactions run synchronously without any heap allocation.
+static i2c_master_bus_handle_t hw_bus_handle;
+
+static esp_err_t hw_bus_init(void *ctx)
+{
+    i2c_master_bus_config_t bus_config = {
+        .i2c_port = I2C_MASTER_NUM,
+        .sda_io_num = I2C_MASTER_SDA_IO,
+        .scl_io_num = I2C_MASTER_SCL_IO,
+        .clk_source = I2C_CLK_SRC_DEFAULT,
+        .glitch_ignore_cnt = 7,
+        .trans_queue_depth = 0,         // Synchronous transfers only
+        .flags.enable_internal_pullup = true,
+    };
+
+    esp_err_t ret = i2c_new_master_bus(&bus_config, &hw_bus_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "I2C master bus init failed: %s", esp_err_to_name(ret));
+    }
+    return ret;
+}
+
+static esp_err_t hw_bus_add_device(void *ctx, uint8_t addr, void **handle)
+{
+    i2c_device_config_t dev_config = {
+        .dev_addr_length = I2C_ADDR_BIT_LEN_7,
+        .device_address = addr,
+        .scl_speed_hz = I2C_MASTER_FREQ_HZ,
+    };
+
+    i2c_master_dev_handle_t dev_handle;
+    esp_err_t ret = i2c_master_bus_add_device(hw_bus_handle, &dev_config, &dev_handle);
+    if (ret == ESP_OK) {
+        *handle = dev_handle;
+    }
+    return ret;
+}
+
+static esp_err_t hw_bus_transfer(void *ctx, void *handle,
+                                 const uint8_t *tx, size_t tx_len,
+                                 uint8_t *rx, size_t rx_len, uint32_t timeout_ms)
+{
+    i2c_master_dev_handle_t dev_handle = (i2c_master_dev_handle_t)handle;
+
+    if (tx_len > 0 && rx_len > 0) {
+        return i2c_master_transmit_receive(dev_handle, tx, tx_len, rx, rx_len, (int)timeout_ms);
+    }
+    if (rx_len > 0) {
+        return i2c_master_receive(dev_handle, rx, rx_len, (int)timeout_ms);
+    }
+    return i2c_master_transmit(dev_handle, tx, tx_len, (int)timeout_ms);
+}
+
+static esp_err_t hw_bus_probe(void *ctx, uint8_t addr, uint32_t timeout_ms)
+{
+    return i2c_master_probe(hw_bus_handle, addr, (int)timeout_ms);
+}
+
+const i2c_bus_backend_t i2c_bus_hw_backend = {
+    .init = hw_bus_init,
+    .add_device = hw_bus_add_device,
+    .transfer = hw_bus_transfer,
+    .probe = hw_bus_probe,
+    .ctx = NULL,
+};
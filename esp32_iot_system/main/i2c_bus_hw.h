@@ -0,0 +1,11 @@
+#ifndef I2C_BUS_HW_H
+#define I2C_BUS_HW_H
+
+#include "i2c_bus.h"
+
+// i2c_master driver backend on I2C_MASTER_NUM / I2C_MASTER_SDA_IO /
+// I2C_MASTER_SCL_IO. Kept out of i2c_bus.c so the scheduler builds on the
+// host against a fake backend.
+extern const i2c_bus_backend_t i2c_bus_hw_backend;
+
+#endif
@@ -1,7 +1,7 @@
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/i2c.h"
+#include "i2c_bus.h"
 #include "esp_log.h"
 #include "sensors.h"
 #include "relay_control.h"
@@ -16,13 +16,8 @@ esp_err_t i2c_scanner_scan_devices(void)
     uint8_t devices_found = 0;
     
     for (uint8_t address = 1; address < 127; address++) {
-        i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-        i2c_master_start(cmd);
-        i2c_master_write_byte(cmd, (address << 1) | I2C_MASTER_WRITE, true);
-        i2c_master_stop(cmd);
-        
-        esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(50));
-        i2c_cmd_link_delete(cmd);
+        // Lowest priority so the scan never delays control-loop reads
+        esp_err_t ret = i2c_bus_probe(address, 50, I2C_BUS_PRIO_DIAG);
         
         if (address % 16 == 0) {
             printf("%02x: ", address);
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "json_writer.h"
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_flush_fn_t flush, void *ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    w->flush = flush;
+    w->ctx = ctx;
+}
+
+static bool flush_buf(json_writer_t *w)
+{
+    if (w->len == 0) {
+        return true;
+    }
+    if (w->flush == NULL) {
+        w->err = ESP_ERR_NO_MEM;
+        return false;
+    }
+    esp_err_t err = w->flush(w->ctx, w->buf, w->len);
+    if (err != ESP_OK) {
+        w->err = err;
+        return false;
+    }
+    w->len = 0;
+    return true;
+}
+
+static void put(json_writer_t *w, const char *data, size_t len)
+{
+    while (len > 0 && w->err == ESP_OK) {
+        if (w->len == w->size && !flush_buf(w)) {
+            return;
+        }
+        size_t n = w->size - w->len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        w->total += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put(w, &c, 1);
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        // Copy the plain run, then the escape
+        put(w, run, s - run);
+        run = s + 1;
+        char esc[6] = { '\\', 0 };
+        size_t n = 2;
+        switch (c) {
+        case '"':  esc[1] = '"'; break;
+        case '\\': esc[1] = '\\'; break;
+        case '\n': esc[1] = 'n'; break;
+        case '\r': esc[1] = 'r'; break;
+        case '\t': esc[1] = 't'; break;
+        case '\b': esc[1] = 'b'; break;
+        case '\f': esc[1] = 'f'; break;
+        default:
+            esc[1] = 'u';
+            esc[2] = '0';
+            esc[3] = '0';
+            esc[4] = hex[c >> 4];
+            esc[5] = hex[c & 0xF];
+            n = 6;
+            break;
+        }
+        put(w, esc, n);
+    }
+    put(w, run, s - run);
+    put_char(w, '"');
+}
+
+// Comma and key before a value
+static void begin_value(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+    if (key != NULL) {
+        put_escaped(w, key);
+        put_char(w, ':');
+    }
+}
+
+static void open_container(json_writer_t *w, const char *key, char c)
+{
+    begin_value(w, key);
+    put_char(w, c);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth == 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+void json_obj_begin(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '{');
+}
+
+void json_obj_end(json_writer_t *w)
+{
+    close_container(w, '}');
+}
+
+void json_arr_begin(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '[');
+}
+
+void json_arr_end(json_writer_t *w)
+{
+    close_container(w, ']');
+}
+
+void json_string(json_writer_t *w, const char *key, const char *value)
+{
+    begin_value(w, key);
+    if (value == NULL) {
+        put(w, "null", 4);
+    } else {
+        put_escaped(w, value);
+    }
+}
+
+void json_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%" PRId64, value);
+    begin_value(w, key);
+    put(w, tmp, n);
+}
+
+void json_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    char tmp[24];
+    int n = snprintf(tmp, sizeof(tmp), "%" PRIu64, value);
+    begin_value(w, key);
+    put(w, tmp, n);
+}
+
+void json_bool(json_writer_t *w, const char *key, bool value)
+{
+    begin_value(w, key);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_null(json_writer_t *w, const char *key)
+{
+    begin_value(w, key);
+    put(w, "null", 4);
+}
+
+void json_number(json_writer_t *w, const char *key, double value, int decimals)
+{
+    if (!isfinite(value)) {
+        json_null(w, key);
+        return;
+    }
+
+    char tmp[32];
+    int n;
+    if (decimals >= 0) {
+        n = snprintf(tmp, sizeof(tmp), "%.*f", decimals > 9 ? 9 : decimals, value);
+    } else {
+        n = snprintf(tmp, sizeof(tmp), "%.7g", value);
+    }
+    if (n < 0 || n >= (int)sizeof(tmp)) {
+        // Too large for fixed point: fall back to exponent form
+        n = snprintf(tmp, sizeof(tmp), "%.7g", value);
+    }
+    // "-0.00" is valid JSON but reads badly
+    if (tmp[0] == '-' && strspn(tmp + 1, "0.") == (size_t)(n - 1)) {
+        memmove(tmp, tmp + 1, n--);
+    }
+    begin_value(w, key);
+    put(w, tmp, n);
+}
+
+void json_raw(json_writer_t *w, const char *key, const char *json, size_t len)
+{
+    begin_value(w, key);
+    put(w, json, len);
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->err == ESP_OK && w->depth != 0) {
+        w->err = ESP_ERR_INVALID_STATE;
+    }
+    if (w->err == ESP_OK && w->flush != NULL) {
+        flush_buf(w);
+    }
+    return w->err;
+}
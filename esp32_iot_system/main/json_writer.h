@@ -0,0 +1,65 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+// Streaming JSON writer: formats straight into a caller-provided buffer
+// and hands full buffers to a flush callback, so a response of any size
+// needs no heap. Commas and nesting are tracked by the writer; every
+// value call takes a key, which must be NULL inside arrays and at the top
+// level. Non-finite numbers are written as null.
+//
+//   json_writer_t w;
+//   json_writer_init(&w, buf, sizeof(buf), flush, ctx);
+//   json_obj_begin(&w, NULL);
+//   json_number(&w, "temperature", 24.5, 2);
+//   json_obj_end(&w);
+//   err = json_writer_finish(&w);
+
+#define JSON_WRITER_MAX_DEPTH   32
+#define JSON_NUM_AUTO           (-1)    // 7 significant digits (%.7g)
+
+// Called with the buffered output when the buffer fills up and from
+// json_writer_finish(); NULL means the output must fit in the buffer
+typedef esp_err_t (*json_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    json_flush_fn_t flush;
+    void *ctx;
+    uint32_t depth;
+    uint32_t has_items;     // Bit per depth: next value needs a comma
+    size_t total;           // Bytes produced so far
+    esp_err_t err;          // First error; later calls do nothing
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_flush_fn_t flush, void *ctx);
+
+void json_obj_begin(json_writer_t *w, const char *key);
+void json_obj_end(json_writer_t *w);
+void json_arr_begin(json_writer_t *w, const char *key);
+void json_arr_end(json_writer_t *w);
+
+void json_string(json_writer_t *w, const char *key, const char *value);
+void json_int(json_writer_t *w, const char *key, int64_t value);
+void json_uint(json_writer_t *w, const char *key, uint64_t value);
+void json_bool(json_writer_t *w, const char *key, bool value);
+void json_null(json_writer_t *w, const char *key);
+
+// decimals >= 0: fixed point, JSON_NUM_AUTO: %.7g
+void json_number(json_writer_t *w, const char *key, double value, int decimals);
+
+// Pre-formatted JSON value, copied as is
+void json_raw(json_writer_t *w, const char *key, const char *json, size_t len);
+
+// Flushes what is left. Returns the first error: ESP_ERR_NO_MEM when the
+// output did not fit without a flush callback, ESP_ERR_INVALID_STATE on
+// unbalanced nesting, or whatever the callback returned.
+esp_err_t json_writer_finish(json_writer_t *w);
+
+#endif
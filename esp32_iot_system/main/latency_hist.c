@@ -0,0 +1,83 @@
+#include <string.h>
+#include "latency_hist.h"
+
+static int bucket_index(uint32_t us)
+{
+    if (us < 4) {
+        return (int)us;
+    }
+    int msb = 31 - __builtin_clz(us);
+    int idx = (msb - 1) * 4 + (int)((us >> (msb - 2)) & 3);
+    return idx < LATENCY_HIST_BUCKETS ? idx : LATENCY_HIST_BUCKETS - 1;
+}
+
+uint32_t latency_hist_bucket_floor(int bucket)
+{
+    if (bucket < 4) {
+        return (uint32_t)bucket;
+    }
+    int msb = bucket / 4 + 1;
+    return (uint32_t)(4 + bucket % 4) << (msb - 2);
+}
+
+void latency_hist_init(latency_hist_t *hist)
+{
+    memset(hist, 0, sizeof(*hist));
+    hist->min_us = UINT32_MAX;
+    portMUX_INITIALIZE(&hist->lock);
+}
+
+void latency_hist_record(latency_hist_t *hist, uint32_t us)
+{
+    int idx = bucket_index(us);
+
+    portENTER_CRITICAL(&hist->lock);
+    hist->buckets[idx]++;
+    hist->count++;
+    hist->sum_us += us;
+    if (us < hist->min_us) {
+        hist->min_us = us;
+    }
+    if (us > hist->max_us) {
+        hist->max_us = us;
+    }
+    portEXIT_CRITICAL(&hist->lock);
+}
+
+void latency_hist_copy(latency_hist_t *hist, latency_hist_t *out)
+{
+    portENTER_CRITICAL(&hist->lock);
+    memcpy(out->buckets, hist->buckets, sizeof(out->buckets));
+    out->count = hist->count;
+    out->min_us = hist->min_us;
+    out->max_us = hist->max_us;
+    out->sum_us = hist->sum_us;
+    portEXIT_CRITICAL(&hist->lock);
+    portMUX_INITIALIZE(&out->lock);
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percentile)
+{
+    if (hist->count == 0) {
+        return 0;
+    }
+
+    // Rank of the requested sample, rounded up
+    uint64_t rank = ((uint64_t)hist->count * percentile + 99) / 100;
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            if (i == LATENCY_HIST_BUCKETS - 1) {
+                return hist->max_us;
+            }
+            uint32_t upper = latency_hist_bucket_floor(i + 1);
+            return upper < hist->max_us ? upper : hist->max_us;
+        }
+    }
+    return hist->max_us;
+}
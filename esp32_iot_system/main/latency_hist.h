@@ -0,0 +1,33 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+
+// Log-linear latency histogram in microseconds: 4 sub-buckets per power
+// of two (about 19% resolution), values from 0 us to ~33 s. The last
+// bucket also collects anything larger.
+#define LATENCY_HIST_BUCKETS    96
+
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    portMUX_TYPE lock;
+} latency_hist_t;
+
+void latency_hist_init(latency_hist_t *hist);
+void latency_hist_record(latency_hist_t *hist, uint32_t us);
+
+// Consistent copy for reporting
+void latency_hist_copy(latency_hist_t *hist, latency_hist_t *out);
+
+// Lower bound (us) of the given bucket
+uint32_t latency_hist_bucket_floor(int bucket);
+
+// Upper bound (us) of the bucket holding the given percentile (0..100)
+uint32_t latency_hist_percentile(const latency_hist_t *hist, uint32_t percentile);
+
+#endif
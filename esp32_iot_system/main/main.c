@@ -14,21 +14,72 @@
 #include "sensors.h"
 #include "relay_control.h"
 #include "nvs_storage.h"
+#include "sensor_acq.h"
+#include "sensor_snapshot.h"
+#include "sensor_history.h"
+#include "ts_log.h"
+#include "app_config.h"
+#include "web_events.h"
+#include "web_ws.h"
+#include "web_longpoll.h"
 
 static const char *TAG = "MAIN";
 
-// Task for automatic sensor reading and relay control
-void sensor_auto_control_task(void *pvParameters)
+#define SENSOR_SAMPLE_PERIOD_MS 10000
+
+// Auto relay control (prioritize AHT22 temperature, fallback to BMP180)
+static void run_auto_control(const sensor_data_t *data, const app_config_t *config)
+{
+    float control_temp = data->aht22_available ? data->aht22_temperature : data->bmp180_temperature;
+    auto_control_relay(control_temp, config->temp_high, config->temp_low);
+    ESP_LOGI(TAG, "Auto control using %s temperature: %.1f°C", 
+             data->aht22_available ? "AHT22" : "BMP180", control_temp);
+}
+
+// Called on the acquisition task for every completed sample
+static void on_sensor_sample(const sensor_data_t *data)
+{
+    sensor_history_add(data);
+    ts_log_append(data);
+    
+    if (get_relay_mode() == RELAY_MODE_AUTO) {
+        app_config_t config;
+        app_config_get(&config);
+        run_auto_control(data, &config);
+    }
+    
+    web_events_notify_sample();
+    web_ws_notify_sample();
+    web_longpoll_notify_sample();
+}
+
+// Applies configuration changes to the modules that use them
+static void on_config_changed(const app_config_t *config, uint32_t changed, void *arg)
 {
-    sensor_data_t data;
+    if (changed & APP_CONFIG_AUTO_MODE) {
+        set_relay_mode((relay_mode_t)config->auto_mode);
+    }
+    if ((changed & APP_CONFIG_RELAY_STATE) && get_relay_state() != config->relay_state) {
+        set_relay_state(config->relay_state);
+    }
+    if (changed & APP_CONFIG_BMP180_OSS) {
+        bmp180_set_oss(config->bmp180_oss);
+    }
+    if (changed & APP_CONFIG_BMP180_TEMP_REFRESH) {
+        sensor_acq_set_temp_refresh(config->bmp180_temp_every_n, config->bmp180_temp_max_age_ms);
+    }
+    if (changed & APP_CONFIG_THRESHOLDS) {
+        ESP_LOGI(TAG, "Temperature thresholds: High=%.1f°C, Low=%.1f°C", config->temp_high, config->temp_low);
+    }
     
-    while (1) {
-        esp_err_t ret = get_sensor_data(&data);
-        if (ret != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to read sensor data");
+    // Re-evaluate auto control against the latest sample right away;
+    // sampling itself stays on the acquisition schedule
+    if (changed != APP_CONFIG_ALL && (changed & (APP_CONFIG_AUTO_MODE | APP_CONFIG_THRESHOLDS)) &&
+        get_relay_mode() == RELAY_MODE_AUTO) {
+        sensor_snapshot_t snap;
+        if (sensor_snapshot_read(&snap)) {
+            run_auto_control(&snap.data, config);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(10000));
     }
 }
 
@@ -44,25 +95,19 @@ void app_main(void)
     ESP_ERROR_CHECK(ret);
 
     storage_init();
+    app_config_init();
     wifi_init();
     sensors_init();
     relay_init();
     
-    uint8_t saved_auto_mode;
-    storage_load_auto_mode(&saved_auto_mode);
-    set_relay_mode(saved_auto_mode);
-    
-    uint8_t saved_relay_state;
-    storage_load_relay_state(&saved_relay_state);
-    set_relay_state(saved_relay_state);
+    // Applies the loaded configuration, then follows changes
+    app_config_subscribe(on_config_changed, NULL);
     
-    float temp_high, temp_low;
-    storage_load_temp_thresholds(&temp_high, &temp_low);
-    ESP_LOGI(TAG, "Loaded temperature thresholds: High=%.1f°C, Low=%.1f°C", temp_high, temp_low);
+    sensor_history_init();
+    ts_log_init(NULL);
     init_webserver();
 
-    xTaskCreate(sensor_auto_control_task, "sensor_auto", 4096, NULL, 4, NULL);
-    ESP_LOGI(TAG, "Sensor auto control task started");
+    sensor_acq_start(SENSOR_SAMPLE_PERIOD_MS, on_sensor_sample);
 
     ESP_LOGI(TAG, "System initialized successfully");
 } 
\ No newline at end of file
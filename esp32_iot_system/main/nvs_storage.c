@@ -2,143 +2,301 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "app_config_defaults.h"
 #include <string.h>
+#include <stddef.h>
 
 static const char *TAG = "NVS_STORAGE";
 static nvs_handle_t storage_handle;
 
-esp_err_t storage_init(void)
+#define NVS_ENTRY_SIZE 32
+
+// Write telemetry (stats guarded by stats_lock)
+static storage_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_hist_t commit_hist;
+static esp_timer_handle_t stats_timer;
+
+// Legacy per-key layout, only read for the one-time migration
+#define RELAY_STATE_KEY "relay_state"
+#define AUTO_MODE_KEY "auto_mode"
+#define TEMP_THRESHOLD_HIGH_KEY "temp_high"
+#define TEMP_THRESHOLD_LOW_KEY "temp_low"
+#define BMP180_OSS_KEY "bmp180_oss"
+#define BMP180_TEMP_EVERY_KEY "bmp180_t_every"
+#define BMP180_TEMP_AGE_KEY "bmp180_t_age"
+
+static const char *legacy_keys[] = {
+    RELAY_STATE_KEY, AUTO_MODE_KEY, TEMP_THRESHOLD_HIGH_KEY, TEMP_THRESHOLD_LOW_KEY,
+    BMP180_OSS_KEY, BMP180_TEMP_EVERY_KEY, BMP180_TEMP_AGE_KEY,
+};
+
+// Counters for a key, added on first use (stats_lock held)
+static storage_key_stats_t *key_stats(const char *key)
 {
-    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &storage_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
-        return err;
+    for (uint32_t i = 0; i < stats.key_count; i++) {
+        if (strcmp(stats.keys[i].key, key) == 0) {
+            return &stats.keys[i];
+        }
     }
-    
-    ESP_LOGI(TAG, "NVS storage initialized");
-    return ESP_OK;
+    if (stats.key_count == STORAGE_STATS_KEYS_MAX) {
+        return NULL;
+    }
+    storage_key_stats_t *ks = &stats.keys[stats.key_count++];
+    strncpy(ks->key, key, sizeof(ks->key) - 1);
+    return ks;
 }
 
-esp_err_t storage_save_relay_state(uint8_t state)
+// A blob takes a data chunk (header entry + data) and an index entry
+static void record_blob_write(const char *key, size_t len, esp_err_t err)
 {
-    esp_err_t err = nvs_set_u8(storage_handle, RELAY_STATE_KEY, state);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving relay state: %s", esp_err_to_name(err));
-        return err;
+    uint32_t entries = 2 + (len + NVS_ENTRY_SIZE - 1) / NVS_ENTRY_SIZE;
+
+    portENTER_CRITICAL(&stats_lock);
+    storage_key_stats_t *ks = key_stats(key);
+    if (err == ESP_OK) {
+        stats.writes++;
+        stats.bytes_written += len;
+        stats.entries_written += entries;
+        if (ks != NULL) {
+            ks->writes++;
+            ks->bytes += len;
+            ks->entries += entries;
+        }
+    } else if (ks != NULL) {
+        ks->errors++;
     }
-    
-    err = nvs_commit(storage_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing relay state: %s", esp_err_to_name(err));
-        return err;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void record_erase(const char *key, esp_err_t err)
+{
+    portENTER_CRITICAL(&stats_lock);
+    storage_key_stats_t *ks = key_stats(key);
+    if (ks != NULL) {
+        if (err == ESP_OK) {
+            ks->erases++;
+        } else if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ks->errors++;
+        }
     }
-    
-    ESP_LOGI(TAG, "Relay state saved: %d", state);
-    return ESP_OK;
+    portEXIT_CRITICAL(&stats_lock);
 }
 
-esp_err_t storage_load_relay_state(uint8_t* state)
+static esp_err_t commit(void)
 {
-    esp_err_t err = nvs_get_u8(storage_handle, RELAY_STATE_KEY, state);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Relay state not found, setting default to 0");
-        *state = 0;
-        return ESP_OK;
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error reading relay state: %s", esp_err_to_name(err));
-        return err;
+    esp_err_t err = nvs_commit(storage_handle);
+    portENTER_CRITICAL(&stats_lock);
+    if (err == ESP_OK) {
+        stats.commits++;
+    } else {
+        stats.commit_errors++;
     }
-    
-    ESP_LOGI(TAG, "Relay state loaded: %d", *state);
-    return ESP_OK;
+    portEXIT_CRITICAL(&stats_lock);
+    return err;
 }
 
-esp_err_t storage_save_auto_mode(uint8_t auto_mode)
+// Partition usage; walks the in-RAM page table, no flash reads
+static void sample_usage(void)
 {
-    esp_err_t err = nvs_set_u8(storage_handle, AUTO_MODE_KEY, auto_mode);
+    nvs_stats_t nvs;
+    if (nvs_get_stats(NULL, &nvs) != ESP_OK) {
+        return;
+    }
+    size_t ns_entries = 0;
+    nvs_get_used_entry_count(storage_handle, &ns_entries);
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.used_entries = nvs.used_entries;
+    stats.free_entries = nvs.free_entries;
+    stats.available_entries = nvs.available_entries;
+    stats.total_entries = nvs.total_entries;
+    stats.namespace_count = nvs.namespace_count;
+    stats.namespace_entries = ns_entries;
+    stats.samples++;
+    stats.sampled_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+static void stats_timer_cb(void *arg)
+{
+    sample_usage();
+}
+
+esp_err_t storage_init(void)
+{
+    esp_err_t err = nvs_open(STORAGE_NAMESPACE, NVS_READWRITE, &storage_handle);
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving auto mode: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
         return err;
     }
     
-    err = nvs_commit(storage_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing auto mode: %s", esp_err_to_name(err));
-        return err;
+    latency_hist_init(&commit_hist);
+    sample_usage();
+    
+    esp_timer_create_args_t args = {
+        .callback = stats_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "nvs_stats",
+    };
+    if (esp_timer_create(&args, &stats_timer) == ESP_OK) {
+        esp_timer_start_periodic(stats_timer, (uint64_t)STORAGE_STATS_PERIOD_MS * 1000);
     }
     
-    ESP_LOGI(TAG, "Auto mode saved: %d", auto_mode);
+    ESP_LOGI(TAG, "NVS storage initialized (%u/%u entries used)",
+             (unsigned)stats.used_entries, (unsigned)stats.total_entries);
     return ESP_OK;
 }
 
-esp_err_t storage_load_auto_mode(uint8_t* auto_mode)
+static uint32_t config_crc(const storage_config_t *config)
 {
-    esp_err_t err = nvs_get_u8(storage_handle, AUTO_MODE_KEY, auto_mode);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Auto mode not found, setting default to 0 (manual)");
-        *auto_mode = 0;  // Mặc định là chế độ manual
-        return ESP_OK;
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error reading auto mode: %s", esp_err_to_name(err));
-        return err;
+    return esp_rom_crc32_le(0, (const uint8_t *)config, offsetof(storage_config_t, crc));
+}
+
+void storage_config_defaults(storage_config_t *config)
+{
+    memset(config, 0, sizeof(*config));
+    config->version = CONFIG_BLOB_VERSION;
+    config->size = sizeof(storage_config_t);
+    config->relay_state = APP_CONFIG_DEFAULT_RELAY_STATE;
+    config->auto_mode = APP_CONFIG_DEFAULT_AUTO_MODE;
+    config->temp_high = APP_CONFIG_DEFAULT_TEMP_HIGH;
+    config->temp_low = APP_CONFIG_DEFAULT_TEMP_LOW;
+    config->bmp180_oss = APP_CONFIG_DEFAULT_BMP180_OSS;
+    config->bmp180_temp_every_n = APP_CONFIG_DEFAULT_BMP180_TEMP_EVERY_N;
+    config->bmp180_temp_max_age_ms = APP_CONFIG_DEFAULT_BMP180_TEMP_MAX_AGE_MS;
+}
+
+// Reads whatever legacy keys exist over the defaults. Returns false if
+// there were none.
+static bool load_legacy(storage_config_t *config)
+{
+    bool found = false;
+    size_t size;
+    float value;
+    
+    if (nvs_get_u8(storage_handle, RELAY_STATE_KEY, &config->relay_state) == ESP_OK) {
+        found = true;
+    }
+    if (nvs_get_u8(storage_handle, AUTO_MODE_KEY, &config->auto_mode) == ESP_OK) {
+        found = true;
+    }
+    size = sizeof(value);
+    if (nvs_get_blob(storage_handle, TEMP_THRESHOLD_HIGH_KEY, &value, &size) == ESP_OK && size == sizeof(value)) {
+        config->temp_high = value;
+        found = true;
+    }
+    size = sizeof(value);
+    if (nvs_get_blob(storage_handle, TEMP_THRESHOLD_LOW_KEY, &value, &size) == ESP_OK && size == sizeof(value)) {
+        config->temp_low = value;
+        found = true;
+    }
+    if (nvs_get_u8(storage_handle, BMP180_OSS_KEY, &config->bmp180_oss) == ESP_OK) {
+        found = true;
     }
     
-    ESP_LOGI(TAG, "Auto mode loaded: %d", *auto_mode);
-    return ESP_OK;
+    uint16_t every_n;
+    uint32_t max_age_ms;
+    if (nvs_get_u16(storage_handle, BMP180_TEMP_EVERY_KEY, &every_n) == ESP_OK) {
+        config->bmp180_temp_every_n = every_n;
+        found = true;
+    }
+    if (nvs_get_u32(storage_handle, BMP180_TEMP_AGE_KEY, &max_age_ms) == ESP_OK) {
+        config->bmp180_temp_max_age_ms = max_age_ms;
+        found = true;
+    }
+    return found;
 }
 
-esp_err_t storage_save_temp_thresholds(float temp_high, float temp_low)
+esp_err_t storage_load_config(storage_config_t *config, storage_config_source_t *source)
 {
-    esp_err_t err;
+    size_t size = sizeof(*config);
+    esp_err_t err = nvs_get_blob(storage_handle, CONFIG_BLOB_KEY, config, &size);
+    int stored_version = (err == ESP_OK && size >= sizeof(uint16_t)) ? config->version : -1;
     
-    err = nvs_set_blob(storage_handle, TEMP_THRESHOLD_HIGH_KEY, &temp_high, sizeof(float));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving high temp threshold: %s", esp_err_to_name(err));
-        return err;
+    if (err == ESP_OK && size == sizeof(*config) && config->version == CONFIG_BLOB_VERSION &&
+        config->size == sizeof(*config) && config->crc == config_crc(config)) {
+        *source = STORAGE_CONFIG_BLOB;
+        ESP_LOGI(TAG, "Config loaded (v%d): relay=%d, auto=%d, High=%.1f°C, Low=%.1f°C, OSS=%d",
+                 config->version, config->relay_state, config->auto_mode,
+                 config->temp_high, config->temp_low, config->bmp180_oss);
+        return ESP_OK;
     }
     
-    err = nvs_set_blob(storage_handle, TEMP_THRESHOLD_LOW_KEY, &temp_low, sizeof(float));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error saving low temp threshold: %s", esp_err_to_name(err));
+    storage_config_defaults(config);
+    
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        // First boot with the blob layout: convert the per-key settings
+        if (!load_legacy(config)) {
+            ESP_LOGW(TAG, "No stored config, using defaults");
+            *source = STORAGE_CONFIG_DEFAULTS;
+            return ESP_OK;
+        }
+        
+        *source = STORAGE_CONFIG_MIGRATED;
+        err = storage_save_config(config);
+        if (err != ESP_OK) {
+            return err;
+        }
+        for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++) {
+            record_erase(legacy_keys[i], nvs_erase_key(storage_handle, legacy_keys[i]));
+        }
+        err = commit();
+        ESP_LOGI(TAG, "Config migrated from legacy keys");
         return err;
     }
     
-    err = nvs_commit(storage_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error committing temp thresholds: %s", esp_err_to_name(err));
+    if (err != ESP_OK && err != ESP_ERR_NVS_INVALID_LENGTH) {
+        ESP_LOGE(TAG, "Error reading config: %s", esp_err_to_name(err));
+        *source = STORAGE_CONFIG_DEFAULTS;
         return err;
     }
     
-    ESP_LOGI(TAG, "Temperature thresholds saved: High=%.1f°C, Low=%.1f°C", temp_high, temp_low);
+    // Wrong size, unknown version or CRC mismatch
+    ESP_LOGW(TAG, "Stored config invalid (size %u, version %d), using defaults",
+             (unsigned)size, stored_version);
+    *source = STORAGE_CONFIG_DEFAULTS;
     return ESP_OK;
 }
 
-esp_err_t storage_load_temp_thresholds(float* temp_high, float* temp_low)
+esp_err_t storage_save_config(storage_config_t *config)
 {
-    size_t required_size = sizeof(float);
-    esp_err_t err;
+    config->version = CONFIG_BLOB_VERSION;
+    config->size = sizeof(*config);
+    config->crc = config_crc(config);
     
-    // Đọc ngưỡng cao
-    err = nvs_get_blob(storage_handle, TEMP_THRESHOLD_HIGH_KEY, temp_high, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "High temp threshold not found, setting default to 30°C");
-        *temp_high = 30.0;  // Mặc định 30°C
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error reading high temp threshold: %s", esp_err_to_name(err));
+    int64_t start_us = esp_timer_get_time();
+    esp_err_t err = nvs_set_blob(storage_handle, CONFIG_BLOB_KEY, config, sizeof(*config));
+    record_blob_write(CONFIG_BLOB_KEY, sizeof(*config), err);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving config: %s", esp_err_to_name(err));
         return err;
     }
     
-    // Đọc ngưỡng thấp
-    required_size = sizeof(float);
-    err = nvs_get_blob(storage_handle, TEMP_THRESHOLD_LOW_KEY, temp_low, &required_size);
-    if (err == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGW(TAG, "Low temp threshold not found, setting default to 25°C");
-        *temp_low = 25.0;   // Mặc định 25°C
-    } else if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error reading low temp threshold: %s", esp_err_to_name(err));
+    err = commit();
+    latency_hist_record(&commit_hist, (uint32_t)(esp_timer_get_time() - start_us));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error committing config: %s", esp_err_to_name(err));
         return err;
     }
     
-    ESP_LOGI(TAG, "Temperature thresholds loaded: High=%.1f°C, Low=%.1f°C", *temp_high, *temp_low);
+    // Usage only moves on writes, so refresh it now as well
+    sample_usage();
+    
+    ESP_LOGI(TAG, "Config saved");
     return ESP_OK;
-} 
\ No newline at end of file
+}
+
+void storage_get_stats(storage_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void storage_get_commit_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&commit_hist, out);
+}
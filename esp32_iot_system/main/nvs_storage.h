@@ -1,35 +1,91 @@
 #ifndef NVS_STORAGE_H
 #define NVS_STORAGE_H
 
+#include <stdint.h>
 #include "esp_err.h"
+#include "latency_hist.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define STORAGE_NAMESPACE "iot_config"
-#define WIFI_SSID_KEY "wifi_ssid"
-#define WIFI_PASS_KEY "wifi_pass"
-#define RELAY_STATE_KEY "relay_state"
-#define SENSOR_INTERVAL_KEY "sensor_interval"
-#define AUTO_MODE_KEY "auto_mode"
-#define TEMP_THRESHOLD_HIGH_KEY "temp_high"
-#define TEMP_THRESHOLD_LOW_KEY "temp_low"
+#define CONFIG_BLOB_KEY "config"
+#define CONFIG_BLOB_VERSION 1
 
+// All persistent settings, stored as one blob. Bump CONFIG_BLOB_VERSION
+// when the layout changes (and teach storage_load_config to convert).
+typedef struct __attribute__((packed)) {
+    uint16_t version;
+    uint16_t size;                  // sizeof(storage_config_t)
+    uint8_t relay_state;
+    uint8_t auto_mode;
+    float temp_high;
+    float temp_low;
+    uint8_t bmp180_oss;
+    uint16_t bmp180_temp_every_n;
+    uint32_t bmp180_temp_max_age_ms;
+    uint32_t crc;                   // CRC32 of everything above
+} storage_config_t;
+
+// Where storage_load_config got the settings from
+typedef enum {
+    STORAGE_CONFIG_BLOB = 0,
+    STORAGE_CONFIG_MIGRATED,        // Legacy per-key layout, converted
+    STORAGE_CONFIG_DEFAULTS,        // Nothing stored, or blob failed its checks
+} storage_config_source_t;
 
 esp_err_t storage_init(void);
 
-esp_err_t storage_save_relay_state(uint8_t state);
-esp_err_t storage_load_relay_state(uint8_t* state);
+void storage_config_defaults(storage_config_t *config);
+
+// One blob read. Falls back to the legacy keys (then writes the blob and
+// erases them) or to defaults on a version, size or CRC mismatch.
+esp_err_t storage_load_config(storage_config_t *config, storage_config_source_t *source);
+
+esp_err_t storage_save_config(storage_config_t *config);
+
+// Write telemetry, to estimate flash wear. NVS stores data in 32-byte
+// entries (126 per 4 KB page); a page is erased once all of its entries
+// are used up, so entries_written tracks page wear.
+#define STORAGE_STATS_KEYS_MAX      8
+#define STORAGE_STATS_PERIOD_MS     60000   // nvs_get_stats sampling
 
-esp_err_t storage_save_auto_mode(uint8_t auto_mode);
-esp_err_t storage_load_auto_mode(uint8_t* auto_mode);
+typedef struct {
+    char key[16];                   // NVS_KEY_NAME_MAX_SIZE
+    uint32_t writes;
+    uint32_t erases;
+    uint32_t errors;
+    uint32_t bytes;                 // Payload bytes written
+    uint32_t entries;               // Entries written, including headers
+} storage_key_stats_t;
 
-esp_err_t storage_save_temp_thresholds(float temp_high, float temp_low);
-esp_err_t storage_load_temp_thresholds(float* temp_high, float* temp_low);
+typedef struct {
+    storage_key_stats_t keys[STORAGE_STATS_KEYS_MAX];
+    uint32_t key_count;
+    uint32_t writes;
+    uint32_t bytes_written;
+    uint32_t entries_written;
+    uint32_t commits;
+    uint32_t commit_errors;
+    // Last nvs_get_stats sample for the default partition
+    uint32_t used_entries;
+    uint32_t free_entries;
+    uint32_t available_entries;     // Free minus the page NVS keeps in reserve
+    uint32_t total_entries;
+    uint32_t namespace_count;
+    uint32_t namespace_entries;     // Used by STORAGE_NAMESPACE
+    uint32_t samples;
+    int64_t sampled_us;             // esp_timer time of the last sample
+} storage_stats_t;
+
+void storage_get_stats(storage_stats_t *stats);
+
+// Time per write-and-commit of the config blob
+void storage_get_commit_hist(latency_hist_t *out);
 
 #ifdef __cplusplus
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -6,7 +6,7 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "relay_control.h"
-#include "nvs_storage.h"
+#include "app_config.h"
 
 static const char *TAG = "RELAY";
 static bool relay_state = false;
@@ -88,9 +88,9 @@ esp_err_t auto_control_relay(float temperature, float temp_high, float temp_low)
     // Cập nhật relay nếu có thay đổi
     if (new_state != current_state) {
         set_relay_state(new_state ? 1 : 0);
-        // Lưu state mới vào NVS khi auto control thay đổi
-        storage_save_relay_state(new_state ? 1 : 0);
-        ESP_LOGI(TAG, "AUTO: Relay state changed to %s and saved to NVS", new_state ? "ON" : "OFF");
+        // Lưu state mới (RAM config, ghi xuống NVS) khi auto control thay đổi
+        app_config_set_relay_state(new_state ? 1 : 0);
+        ESP_LOGI(TAG, "AUTO: Relay state changed to %s and saved", new_state ? "ON" : "OFF");
     }
     
     return ESP_OK;
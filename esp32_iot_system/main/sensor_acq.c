@@ -0,0 +1,602 @@
+#include <stdint.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sensor_acq.h"
+#include "sensor_snapshot.h"
+#include "alloc_counter.h"
+
+static const char *TAG = "SENSOR_ACQ";
+
+#define SENSOR_ACQ_TASK_STACK   3072
+#define SENSOR_ACQ_TASK_PRIO    4
+
+// Events for the acquisition task (from esp_timer callbacks or callers),
+// posted as task notification bits: a post never fails and repeated posts
+// of one event coalesce, so a burst of triggers cannot crowd out a
+// conversion-ready event
+#define ACQ_EVT_START           (1u << 0)
+#define ACQ_EVT_AHT20_READY     (1u << 1)
+#define ACQ_EVT_BMP180_READY    (1u << 2)
+#define ACQ_EVT_FRESH           (1u << 3)   // Like START, but not an overrun while a cycle runs
+
+typedef enum {
+    AHT20_STATE_IDLE = 0,
+    AHT20_STATE_MEASURING,
+    AHT20_STATE_DONE,
+} aht20_state_t;
+
+typedef enum {
+    BMP180_STATE_IDLE = 0,
+    BMP180_STATE_TEMPERATURE,
+    BMP180_STATE_PRESSURE,
+    BMP180_STATE_DONE,
+} bmp180_state_t;
+
+// Status poll schedule of one conversion
+typedef struct {
+    uint32_t first_poll_us;
+    uint32_t poll_interval_us;
+    uint32_t max_us;            // Datasheet maximum, read unconditionally after this
+} conv_schedule_t;
+
+// Conversion in flight on one sensor
+typedef struct {
+    esp_timer_handle_t timer;
+    esp_err_t (*is_busy)(bool *busy);
+    sensor_conv_t conv;
+    const conv_schedule_t *sched;
+    int64_t start_us;
+} conv_tracker_t;
+
+static const conv_schedule_t aht20_sched = {
+    AHT20_POLL_FIRST_US, AHT20_POLL_INTERVAL_US, AHT20_MEASURE_TIME_US
+};
+static const conv_schedule_t bmp180_temp_sched = {
+    BMP180_POLL_FIRST_US, BMP180_POLL_INTERVAL_US, BMP180_TEMP_CONV_TIME_US
+};
+// Pressure conversion time grows with the oversampling setting (datasheet
+// typical / maximum)
+static const conv_schedule_t bmp180_press_sched[BMP180_OSS_MAX + 1] = {
+    {  3000, BMP180_POLL_INTERVAL_US,  4500 },
+    {  5000, BMP180_POLL_INTERVAL_US,  7500 },
+    {  9000, BMP180_POLL_INTERVAL_US, 13500 },
+    { 17000, BMP180_POLL_INTERVAL_US, 25500 },
+};
+
+static TaskHandle_t acq_task;
+static esp_timer_handle_t period_timer;
+static sensor_acq_cb_t sample_cb;
+static conv_tracker_t aht20_conv = { .is_busy = aht20_is_busy };
+static conv_tracker_t bmp180_conv = { .is_busy = bmp180_is_busy };
+static latency_hist_t conv_hist[SENSOR_CONV_COUNT];
+
+// State of the cycle in progress, only touched by the acquisition task
+static aht20_state_t aht20_state;
+static bmp180_state_t bmp180_state;
+static sensor_data_t sample;
+static int64_t cycle_start_us;
+static uint32_t cycle_start_allocs;
+
+// Cached B5 term, only touched by the acquisition task
+static bool bmp180_b5_valid;
+static int32_t bmp180_b5;
+static int64_t bmp180_b5_us;
+static uint16_t bmp180_pressure_since_temp;
+
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static sensor_acq_stats_t acq_stats;
+static uint16_t temp_every_n = SENSOR_ACQ_TEMP_EVERY_N_DEFAULT;
+static uint32_t temp_max_age_ms = SENSOR_ACQ_TEMP_MAX_AGE_DEFAULT_MS;
+
+// Tasks blocked in sensor_acq_read_fresh() (guarded by fresh_lock). Every
+// publish bumps fresh_gen and wakes them all.
+static portMUX_TYPE fresh_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t fresh_waiters[SENSOR_ACQ_FRESH_WAITERS_MAX];
+static uint32_t fresh_waiter_count;
+static bool fresh_in_flight;
+static volatile uint32_t fresh_gen;
+static latency_hist_t fresh_wait_hist;
+
+static void post_event(uint32_t evt)
+{
+    xTaskNotify(acq_task, evt, eSetBits);
+}
+
+static void acq_timer_cb(void *arg)
+{
+    post_event((uint32_t)(uintptr_t)arg);
+}
+
+static bool acq_cycle_running(void)
+{
+    return aht20_state != AHT20_STATE_IDLE || bmp180_state != BMP180_STATE_IDLE;
+}
+
+static void conv_begin(conv_tracker_t *c, sensor_conv_t conv, const conv_schedule_t *sched)
+{
+    c->conv = conv;
+    c->sched = sched;
+    c->start_us = esp_timer_get_time();
+    esp_timer_start_once(c->timer, sched->first_poll_us);
+}
+
+// Called when the conversion timer fires. Returns true when the result can
+// be read, otherwise re-arms the timer for the next status poll.
+static bool conv_poll(conv_tracker_t *c)
+{
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - c->start_us);
+
+    if (elapsed_us < c->sched->max_us) {
+        bool busy = true;
+        esp_err_t ret = c->is_busy(&busy);
+        if (ret == ESP_OK && !busy) {
+            latency_hist_record(&conv_hist[c->conv], elapsed_us);
+            return true;
+        }
+
+        uint32_t remaining_us = c->sched->max_us - elapsed_us;
+        uint32_t next_us = remaining_us;
+        if (ret == ESP_OK && c->sched->poll_interval_us < remaining_us) {
+            next_us = c->sched->poll_interval_us;
+        }
+        // Status unreadable: fall back to the datasheet maximum
+        esp_timer_start_once(c->timer, next_us);
+        return false;
+    }
+
+    latency_hist_record(&conv_hist[c->conv], elapsed_us);
+    portENTER_CRITICAL(&stats_lock);
+    acq_stats.conv_timeouts[c->conv]++;
+    portEXIT_CRITICAL(&stats_lock);
+    return true;
+}
+
+// Temperature conversion is due when there is no B5 yet, after every_n
+// pressure samples, or when the cached B5 is too old
+static bool bmp180_need_temperature(void)
+{
+    uint16_t every_n;
+    uint32_t max_age_ms;
+    sensor_acq_get_temp_refresh(&every_n, &max_age_ms);
+
+    if (!bmp180_b5_valid || bmp180_pressure_since_temp >= every_n) {
+        return true;
+    }
+    return (esp_timer_get_time() - bmp180_b5_us) >= (int64_t)max_age_ms * 1000;
+}
+
+static bool bmp180_begin_pressure(void)
+{
+    if (bmp180_start_pressure(sample.bmp180_oss) != ESP_OK) {
+        return false;
+    }
+    bmp180_state = BMP180_STATE_PRESSURE;
+    conv_begin(&bmp180_conv, SENSOR_CONV_BMP180_PRESSURE, &bmp180_press_sched[sample.bmp180_oss]);
+    return true;
+}
+
+static void acq_cycle_begin(void)
+{
+    if (acq_cycle_running()) {
+        portENTER_CRITICAL(&stats_lock);
+        acq_stats.overruns++;
+        portEXIT_CRITICAL(&stats_lock);
+        return;
+    }
+
+    cycle_start_us = esp_timer_get_time();
+    cycle_start_allocs = alloc_counter_get();
+
+    // Default values until the sensors report
+    sample.aht22_temperature = 25.0;
+    sample.aht22_humidity = 50.0;
+    sample.aht22_available = false;
+    sample.bmp180_temperature = 25.0;
+    sample.bmp180_pressure = 1013.2;
+    sample.bmp180_available = false;
+    sample.bmp180_oss = bmp180_get_oss();
+    sample.timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
+
+    // Start both conversions back to back, then wait for whichever ends first
+    if (aht20_start_measurement() == ESP_OK) {
+        aht20_state = AHT20_STATE_MEASURING;
+        conv_begin(&aht20_conv, SENSOR_CONV_AHT20, &aht20_sched);
+    } else {
+        ESP_LOGE(TAG, "Failed to read AHT20");
+        aht20_state = AHT20_STATE_DONE;
+    }
+
+    if (!bmp180_need_temperature()) {
+        // Cached B5 still valid: pressure conversion only
+        if (!bmp180_begin_pressure()) {
+            ESP_LOGE(TAG, "Failed to read BMP180");
+            bmp180_state = BMP180_STATE_DONE;
+        }
+    } else if (bmp180_start_temperature() == ESP_OK) {
+        bmp180_state = BMP180_STATE_TEMPERATURE;
+        conv_begin(&bmp180_conv, SENSOR_CONV_BMP180_TEMP, &bmp180_temp_sched);
+    } else {
+        ESP_LOGE(TAG, "Failed to read BMP180");
+        bmp180_state = BMP180_STATE_DONE;
+    }
+}
+
+static void acq_handle_aht20_ready(void)
+{
+    if (aht20_state != AHT20_STATE_MEASURING || !conv_poll(&aht20_conv)) {
+        return;
+    }
+
+    aht22_data_t aht_data;
+    if (aht20_read_measurement(&aht_data) == ESP_OK) {
+        sample.aht22_temperature = aht_data.temperature;
+        sample.aht22_humidity = aht_data.humidity;
+        sample.aht22_available = true;
+        ESP_LOGI(TAG, "AHT22 - Temp: %.1f°C, Humidity: %.1f%%", aht_data.temperature, aht_data.humidity);
+    } else {
+        ESP_LOGE(TAG, "Failed to read AHT20");
+    }
+    aht20_state = AHT20_STATE_DONE;
+}
+
+static void acq_handle_bmp180_ready(void)
+{
+    if (bmp180_state != BMP180_STATE_TEMPERATURE && bmp180_state != BMP180_STATE_PRESSURE) {
+        return;
+    }
+    if (!conv_poll(&bmp180_conv)) {
+        return;
+    }
+
+    switch (bmp180_state) {
+    case BMP180_STATE_TEMPERATURE: {
+        // Temperature done: refresh B5, then chain the pressure conversion
+        int32_t ut;
+        if (bmp180_read_temperature_raw(&ut) == ESP_OK) {
+            bmp180_b5 = bmp180_compute_b5(ut);
+            bmp180_b5_us = esp_timer_get_time();
+            bmp180_b5_valid = true;
+            bmp180_pressure_since_temp = 0;
+            portENTER_CRITICAL(&stats_lock);
+            acq_stats.bmp180_temp_reads++;
+            portEXIT_CRITICAL(&stats_lock);
+
+            if (bmp180_begin_pressure()) {
+                return;
+            }
+        }
+        break;
+    }
+
+    case BMP180_STATE_PRESSURE: {
+        int32_t up;
+        if (bmp180_read_pressure_raw(sample.bmp180_oss, &up) == ESP_OK) {
+            bmp180_data_t bmp_data;
+            bmp180_compensate(bmp180_b5, up, sample.bmp180_oss, &bmp_data);
+            if (bmp180_pressure_since_temp > 0) {
+                portENTER_CRITICAL(&stats_lock);
+                acq_stats.bmp180_b5_reused++;
+                portEXIT_CRITICAL(&stats_lock);
+            }
+            bmp180_pressure_since_temp++;
+            sample.bmp180_temperature = bmp_data.temperature;
+            sample.bmp180_pressure = bmp_data.pressure;
+            sample.bmp180_available = true;
+            ESP_LOGI(TAG, "BMP180 - Temp: %.1f°C, Pressure: %.1f hPa", bmp_data.temperature, bmp_data.pressure);
+            bmp180_state = BMP180_STATE_DONE;
+            return;
+        }
+        break;
+    }
+
+    default:
+        return;
+    }
+
+    ESP_LOGE(TAG, "Failed to read BMP180");
+    bmp180_state = BMP180_STATE_DONE;
+}
+
+// Gives up on conversions still running at the cycle deadline, so a
+// sensor that never completes cannot hold the state machine: they are
+// reported as failed and the cycle publishes what it has
+static void acq_cycle_check_deadline(void)
+{
+    if (!acq_cycle_running() ||
+        esp_timer_get_time() - cycle_start_us < (int64_t)SENSOR_ACQ_CYCLE_DEADLINE_MS * 1000) {
+        return;
+    }
+
+    if (aht20_state != AHT20_STATE_DONE) {
+        esp_timer_stop(aht20_conv.timer);
+        aht20_state = AHT20_STATE_DONE;
+    }
+    if (bmp180_state != BMP180_STATE_DONE) {
+        esp_timer_stop(bmp180_conv.timer);
+        bmp180_state = BMP180_STATE_DONE;
+    }
+    portENTER_CRITICAL(&stats_lock);
+    acq_stats.cycle_timeouts++;
+    portEXIT_CRITICAL(&stats_lock);
+    ESP_LOGW(TAG, "Cycle exceeded %d ms, aborting", SENSOR_ACQ_CYCLE_DEADLINE_MS);
+}
+
+// Wakes every task waiting for a fresh sample; called after each publish
+static void fresh_complete(void)
+{
+    TaskHandle_t waiters[SENSOR_ACQ_FRESH_WAITERS_MAX];
+    uint32_t count;
+
+    portENTER_CRITICAL(&fresh_lock);
+    fresh_gen++;
+    fresh_in_flight = false;
+    count = fresh_waiter_count;
+    memcpy(waiters, fresh_waiters, count * sizeof(waiters[0]));
+    fresh_waiter_count = 0;
+    portEXIT_CRITICAL(&fresh_lock);
+
+    for (uint32_t i = 0; i < count; i++) {
+        xTaskNotifyGive(waiters[i]);
+    }
+}
+
+// Publishes the sample once both sensors have finished (or failed)
+static void acq_cycle_check_done(void)
+{
+    if (aht20_state != AHT20_STATE_DONE || bmp180_state != BMP180_STATE_DONE) {
+        return;
+    }
+    aht20_state = AHT20_STATE_IDLE;
+    bmp180_state = BMP180_STATE_IDLE;
+
+    uint32_t cycle_us = (uint32_t)(esp_timer_get_time() - cycle_start_us);
+    uint32_t cycle_allocs = alloc_counter_get() - cycle_start_allocs;
+    portENTER_CRITICAL(&stats_lock);
+    // The first cycle may still hit lazy one-time allocations
+    if (acq_stats.cycles > 0 && cycle_allocs > 0) {
+        acq_stats.cycles_with_allocs++;
+    }
+    acq_stats.last_cycle_allocs = cycle_allocs;
+    acq_stats.cycles++;
+    acq_stats.last_cycle_us = cycle_us;
+    if (cycle_us > acq_stats.max_cycle_us) {
+        acq_stats.max_cycle_us = cycle_us;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    sensor_snapshot_publish(&sample);
+    fresh_complete();
+    if (sample_cb) {
+        sample_cb(&sample);
+    }
+}
+
+static void sensor_acq_task(void *pvParameters)
+{
+    alloc_counter_track_current_task();
+
+    while (1) {
+        // While a cycle runs, wake up at its deadline even without events
+        TickType_t wait = portMAX_DELAY;
+        if (acq_cycle_running()) {
+            int64_t left_us = cycle_start_us + (int64_t)SENSOR_ACQ_CYCLE_DEADLINE_MS * 1000 -
+                              esp_timer_get_time();
+            wait = left_us > 0 ? pdMS_TO_TICKS(left_us / 1000) + 1 : 0;
+        }
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, wait);
+
+        // Finish the running cycle first, so a start posted at the same
+        // time begins the next one instead of counting as an overrun
+        if (events & ACQ_EVT_AHT20_READY) {
+            acq_handle_aht20_ready();
+        }
+        if (events & ACQ_EVT_BMP180_READY) {
+            acq_handle_bmp180_ready();
+        }
+        acq_cycle_check_deadline();
+        acq_cycle_check_done();
+
+        if (events & ACQ_EVT_START) {
+            acq_cycle_begin();
+        } else if ((events & ACQ_EVT_FRESH) && !acq_cycle_running()) {
+            // A running cycle publishes soon enough for the waiters
+            acq_cycle_begin();
+        }
+        acq_cycle_check_done();
+    }
+}
+
+static esp_err_t create_timer(const char *name, uint32_t evt, esp_timer_handle_t *out)
+{
+    esp_timer_create_args_t args = {
+        .callback = acq_timer_cb,
+        .arg = (void *)(uintptr_t)evt,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = name,
+    };
+    return esp_timer_create(&args, out);
+}
+
+esp_err_t sensor_acq_start(uint32_t period_ms, sensor_acq_cb_t on_sample)
+{
+    if (acq_task != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sample_cb = on_sample;
+    for (int i = 0; i < SENSOR_CONV_COUNT; i++) {
+        latency_hist_init(&conv_hist[i]);
+    }
+    latency_hist_init(&fresh_wait_hist);
+
+    esp_err_t ret = create_timer("acq_period", ACQ_EVT_START, &period_timer);
+    if (ret == ESP_OK) {
+        ret = create_timer("acq_aht20", ACQ_EVT_AHT20_READY, &aht20_conv.timer);
+    }
+    if (ret == ESP_OK) {
+        ret = create_timer("acq_bmp180", ACQ_EVT_BMP180_READY, &bmp180_conv.timer);
+    }
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Timer creation failed: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    if (xTaskCreate(sensor_acq_task, "sensor_acq", SENSOR_ACQ_TASK_STACK, NULL,
+                    SENSOR_ACQ_TASK_PRIO, &acq_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // First sample right away, then periodically
+    post_event(ACQ_EVT_START);
+    ret = esp_timer_start_periodic(period_timer, (uint64_t)period_ms * 1000);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Sensor acquisition started (period %lu ms)", (unsigned long)period_ms);
+    return ESP_OK;
+}
+
+void sensor_acq_trigger(void)
+{
+    if (acq_task != NULL) {
+        post_event(ACQ_EVT_START);
+    }
+}
+
+esp_err_t sensor_acq_read_fresh(uint32_t max_age_ms, uint32_t timeout_ms, sensor_snapshot_t *out)
+{
+    if (acq_task == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (sensor_snapshot_read(out) && sensor_snapshot_age_ms(out) <= max_age_ms) {
+        portENTER_CRITICAL(&stats_lock);
+        acq_stats.fresh_requests++;
+        acq_stats.fresh_cached++;
+        portEXIT_CRITICAL(&stats_lock);
+        return ESP_OK;
+    }
+
+    // Join the acquisition in flight, or become the one that starts it
+    int64_t start_us = esp_timer_get_time();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    bool full = false;
+    bool leader = false;
+    uint32_t gen;
+    portENTER_CRITICAL(&fresh_lock);
+    gen = fresh_gen;
+    if (fresh_waiter_count == SENSOR_ACQ_FRESH_WAITERS_MAX) {
+        full = true;
+    } else {
+        fresh_waiters[fresh_waiter_count++] = self;
+        leader = !fresh_in_flight;
+        fresh_in_flight = true;
+    }
+    portEXIT_CRITICAL(&fresh_lock);
+
+    portENTER_CRITICAL(&stats_lock);
+    acq_stats.fresh_requests++;
+    if (full) {
+        acq_stats.fresh_rejected++;
+    } else if (leader) {
+        acq_stats.fresh_started++;
+    } else {
+        acq_stats.fresh_joined++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    if (full) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (leader) {
+        post_event(ACQ_EVT_FRESH);
+    }
+
+    // A late wake-up from an earlier timed-out wait only costs a loop
+    TickType_t wait_start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeout_ms);
+    esp_err_t ret = ESP_OK;
+    while (fresh_gen == gen) {
+        TickType_t waited = xTaskGetTickCount() - wait_start;
+        if (waited >= timeout) {
+            ret = ESP_ERR_TIMEOUT;
+            break;
+        }
+        ulTaskNotifyTake(pdTRUE, timeout - waited);
+    }
+
+    if (ret == ESP_ERR_TIMEOUT) {
+        portENTER_CRITICAL(&fresh_lock);
+        if (fresh_gen == gen) {
+            for (uint32_t i = 0; i < fresh_waiter_count; i++) {
+                if (fresh_waiters[i] == self) {
+                    fresh_waiters[i] = fresh_waiters[--fresh_waiter_count];
+                    break;
+                }
+            }
+            // Let the next caller start another cycle
+            fresh_in_flight = false;
+        } else {
+            ret = ESP_OK;
+        }
+        portEXIT_CRITICAL(&fresh_lock);
+    }
+    if (ret == ESP_ERR_TIMEOUT) {
+        portENTER_CRITICAL(&stats_lock);
+        acq_stats.fresh_timeouts++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+
+    latency_hist_record(&fresh_wait_hist, (uint32_t)(esp_timer_get_time() - start_us));
+    sensor_snapshot_read(out);
+    return ret;
+}
+
+void sensor_acq_get_fresh_wait_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&fresh_wait_hist, out);
+}
+
+void sensor_acq_get_stats(sensor_acq_stats_t *stats)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *stats = acq_stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+esp_err_t sensor_acq_set_temp_refresh(uint16_t every_n, uint32_t max_age_ms)
+{
+    if (every_n < 1 || every_n > SENSOR_ACQ_TEMP_EVERY_N_MAX ||
+        max_age_ms < SENSOR_ACQ_TEMP_MAX_AGE_MIN_MS || max_age_ms > SENSOR_ACQ_TEMP_MAX_AGE_MAX_MS) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    temp_every_n = every_n;
+    temp_max_age_ms = max_age_ms;
+    portEXIT_CRITICAL(&stats_lock);
+
+    ESP_LOGI(TAG, "BMP180 temperature refresh: every %u samples, max age %lu ms",
+             every_n, (unsigned long)max_age_ms);
+    return ESP_OK;
+}
+
+void sensor_acq_get_temp_refresh(uint16_t *every_n, uint32_t *max_age_ms)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *every_n = temp_every_n;
+    *max_age_ms = temp_max_age_ms;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void sensor_acq_get_conv_hist(sensor_conv_t conv, latency_hist_t *out)
+{
+    if (conv < SENSOR_CONV_COUNT) {
+        latency_hist_copy(&conv_hist[conv], out);
+    }
+}
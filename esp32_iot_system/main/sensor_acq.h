@@ -0,0 +1,88 @@
+#ifndef SENSOR_ACQ_H
+#define SENSOR_ACQ_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "sensors.h"
+#include "sensor_snapshot.h"
+#include "latency_hist.h"
+#include "app_config_defaults.h"
+
+typedef void (*sensor_acq_cb_t)(const sensor_data_t *data);
+
+// Conversions with their own latency histogram
+typedef enum {
+    SENSOR_CONV_AHT20 = 0,
+    SENSOR_CONV_BMP180_TEMP,
+    SENSOR_CONV_BMP180_PRESSURE,
+    SENSOR_CONV_COUNT
+} sensor_conv_t;
+
+typedef struct {
+    uint32_t cycles;
+    uint32_t overruns;          // Triggers ignored because a cycle was still running
+    uint32_t cycle_timeouts;    // Cycles aborted at SENSOR_ACQ_CYCLE_DEADLINE_MS
+    uint32_t last_cycle_us;     // Trigger of first conversion to publish
+    uint32_t max_cycle_us;
+    uint32_t conv_timeouts[SENSOR_CONV_COUNT];  // Read at the datasheet maximum without a ready status
+    uint32_t last_cycle_allocs;  // Heap allocations by the acquisition and bus tasks
+    uint32_t cycles_with_allocs; // Steady-state cycles (after the first) that allocated
+    uint32_t bmp180_temp_reads;  // Cycles that refreshed the BMP180 temperature / B5
+    uint32_t bmp180_b5_reused;   // Pressure-only cycles compensated with the cached B5
+    uint32_t fresh_requests;     // sensor_acq_read_fresh() calls
+    uint32_t fresh_cached;       // ... answered by a sample within max_age_ms
+    uint32_t fresh_started;      // ... that had to start an acquisition
+    uint32_t fresh_joined;       // ... that waited on one already in flight
+    uint32_t fresh_timeouts;
+    uint32_t fresh_rejected;     // Over SENSOR_ACQ_FRESH_WAITERS_MAX
+} sensor_acq_stats_t;
+
+// A cycle still running after this long is aborted: conversions that have
+// not completed are reported as failed and the sample is published. Well
+// above the slowest cycle (AHT20 80 ms, BMP180 4.5 + 25.5 ms at OSS 3).
+#define SENSOR_ACQ_CYCLE_DEADLINE_MS        500
+
+// BMP180 temperature decimation. The temperature conversion only refreshes
+// the B5 compensation term, so it runs every `every_n` pressure samples or
+// once the cached B5 is older than max_age_ms; cycles in between convert
+// pressure only. every_n = 1 converts the temperature on every cycle.
+#define SENSOR_ACQ_TEMP_EVERY_N_DEFAULT     APP_CONFIG_DEFAULT_BMP180_TEMP_EVERY_N
+#define SENSOR_ACQ_TEMP_EVERY_N_MAX         100
+#define SENSOR_ACQ_TEMP_MAX_AGE_DEFAULT_MS  APP_CONFIG_DEFAULT_BMP180_TEMP_MAX_AGE_MS
+#define SENSOR_ACQ_TEMP_MAX_AGE_MIN_MS      1000
+#define SENSOR_ACQ_TEMP_MAX_AGE_MAX_MS      3600000
+
+// On-demand reads: callers wanting a sample no older than max_age_ms share
+// a single acquisition (single-flight) instead of starting one each
+#define SENSOR_ACQ_FRESH_MAX_AGE_DEFAULT_MS 1000
+#define SENSOR_ACQ_FRESH_TIMEOUT_MS         500     // Several worst-case cycles
+#define SENSOR_ACQ_FRESH_WAITERS_MAX        8
+
+// Starts the acquisition task and samples every period_ms. Both sensors
+// convert in parallel; each completed sample is published to
+// sensor_snapshot and then passed to on_sample (on the acquisition task).
+esp_err_t sensor_acq_start(uint32_t period_ms, sensor_acq_cb_t on_sample);
+
+// Starts a cycle now (ignored if one is already running). Triggers that
+// arrive before the acquisition task runs are merged into one.
+void sensor_acq_trigger(void);
+
+// Copies the latest sample into out if it is at most max_age_ms old.
+// Otherwise blocks the calling task until the next sample is published:
+// the first caller starts a cycle (unless one is already running), later
+// callers wait on the same one. Returns ESP_ERR_TIMEOUT (out = latest
+// sample) after timeout_ms, ESP_ERR_NO_MEM when too many tasks wait.
+esp_err_t sensor_acq_read_fresh(uint32_t max_age_ms, uint32_t timeout_ms, sensor_snapshot_t *out);
+
+// Time callers spent waiting in sensor_acq_read_fresh()
+void sensor_acq_get_fresh_wait_hist(latency_hist_t *out);
+
+void sensor_acq_get_stats(sensor_acq_stats_t *stats);
+
+esp_err_t sensor_acq_set_temp_refresh(uint16_t every_n, uint32_t max_age_ms);
+void sensor_acq_get_temp_refresh(uint16_t *every_n, uint32_t *max_age_ms);
+
+// Measured trigger-to-ready latency of a conversion
+void sensor_acq_get_conv_hist(sensor_conv_t conv, latency_hist_t *out);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SENSOR_COMP_H
+#define SENSOR_COMP_H
+
+#include <stdint.h>
+
+// Compensation kernels for the AHT20 and BMP180, integer/fixed-point only.
+// Results are centi-units (0.01 °C, 0.01 %RH) and pascal; the float
+// accessors are single precision so nothing here pulls in soft-float
+// double math.
+
+// BMP180 Calibration data structure (khác hoàn toàn so với BMP280)
+typedef struct {
+    int16_t ac1;
+    int16_t ac2;
+    int16_t ac3;
+    uint16_t ac4;
+    uint16_t ac5;
+    uint16_t ac6;
+    int16_t b1;
+    int16_t b2;
+    int16_t mb;
+    int16_t mc;
+    int16_t md;
+} bmp180_calib_data_t;
+
+// AHT20: 20-bit raw values. RH = raw / 2^20 * 100, T = raw / 2^20 * 200 - 50,
+// rewritten as raw * 625 / 2^16 and raw * 1250 / 2^16 (fits in 32 bits).
+static inline int32_t aht20_comp_humidity_centi(uint32_t raw)
+{
+    return (int32_t)((raw * 625u + 32768u) >> 16);
+}
+
+static inline int32_t aht20_comp_temperature_centi(uint32_t raw)
+{
+    return (int32_t)((raw * 1250u + 32768u) >> 16) - 5000;
+}
+
+// BMP180 (datasheet section 3.5). B5 depends only on the temperature and
+// is shared by the temperature and pressure calculations.
+static inline int32_t bmp180_comp_b5(const bmp180_calib_data_t *cal, int32_t ut)
+{
+    int32_t x1 = ((ut - cal->ac6) * cal->ac5) >> 15;
+    int32_t x2 = (cal->mc * 2048) / (x1 + cal->md);
+    return x1 + x2;
+}
+
+// Temperature in 0.01 °C (the sensor resolves 0.1 °C)
+static inline int32_t bmp180_comp_temperature_centi(int32_t b5)
+{
+    return ((b5 + 8) >> 4) * 10;
+}
+
+// Pressure in Pa for the given oversampling setting (0..3)
+static inline int32_t bmp180_comp_pressure_pa(const bmp180_calib_data_t *cal, int32_t b5,
+                                              int32_t up, uint8_t oss)
+{
+    int32_t b6 = b5 - 4000;
+    int32_t x1 = (cal->b2 * ((b6 * b6) >> 12)) >> 11;
+    int32_t x2 = (cal->ac2 * b6) >> 11;
+    int32_t x3 = x1 + x2;
+    int32_t b3 = (((cal->ac1 * 4 + x3) << oss) + 2) >> 2;
+    x1 = (cal->ac3 * b6) >> 13;
+    x2 = (cal->b1 * ((b6 * b6) >> 12)) >> 16;
+    x3 = ((x1 + x2) + 2) >> 2;
+    uint32_t b4 = (cal->ac4 * (uint32_t)(x3 + 32768)) >> 15;
+    uint32_t b7 = ((uint32_t)up - b3) * (50000 >> oss);
+
+    int32_t p;
+    if (b7 < 0x80000000) {
+        p = (b7 * 2) / b4;
+    } else {
+        p = (b7 / b4) * 2;
+    }
+
+    x1 = (p >> 8) * (p >> 8);
+    x1 = (x1 * 3038) >> 16;
+    x2 = (-7357 * p) >> 16;
+    return p + ((x1 + x2 + 3791) >> 4);
+}
+
+// Float accessors
+static inline float sensor_comp_centi_to_float(int32_t centi)
+{
+    return (float)centi * 0.01f;
+}
+
+static inline float sensor_comp_pa_to_hpa(int32_t pa)
+{
+    return (float)pa * 0.01f;
+}
+
+#endif
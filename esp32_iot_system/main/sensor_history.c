@@ -0,0 +1,329 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "sensor_history.h"
+
+static const char *TAG = "SENSOR_HISTORY";
+
+// Capacities per tier. PSRAM: ~24 h raw at 10 s, 48 h of minutes, 45 days
+// of hours (uptime ms wraps after 49 days). Internal RAM: 1 h, 3 h, 3 days.
+#define HISTORY_RAW_CAP_PSRAM       8640
+#define HISTORY_MINUTE_CAP_PSRAM    2880
+#define HISTORY_HOUR_CAP_PSRAM      1080
+#define HISTORY_RAW_CAP_INTERNAL    360
+#define HISTORY_MINUTE_CAP_INTERNAL 180
+#define HISTORY_HOUR_CAP_INTERNAL   72
+
+// Raw sample, much smaller than a rollup point
+typedef struct {
+    uint32_t t_ms;
+    float value[SENSOR_HISTORY_CH_COUNT];
+    uint8_t valid;          // Bit per channel
+} raw_record_t;
+
+// Ring of fixed-size records, every record starts with its uint32_t t_ms
+typedef struct {
+    uint8_t *buf;
+    size_t rec_size;
+    uint32_t capacity;
+    uint32_t head;          // Next slot to write
+    uint32_t count;
+} history_ring_t;
+
+static history_ring_t rings[SENSOR_HISTORY_TIER_COUNT];
+static bool in_psram;
+
+// Rollup interval still being filled (minute, hour)
+static sensor_history_point_t open_point[SENSOR_HISTORY_TIER_COUNT];
+static bool open_valid[SENSOR_HISTORY_TIER_COUNT];
+
+static SemaphoreHandle_t history_mutex;
+
+static const uint32_t tier_resolution_ms[SENSOR_HISTORY_TIER_COUNT] = {
+    0, SENSOR_HISTORY_MINUTE_MS, SENSOR_HISTORY_HOUR_MS
+};
+
+static void *ring_slot(const history_ring_t *r, uint32_t index)
+{
+    // index 0 = oldest
+    uint32_t pos = (r->head + r->capacity - r->count + index) % r->capacity;
+    return r->buf + (size_t)pos * r->rec_size;
+}
+
+static uint32_t ring_time(const history_ring_t *r, uint32_t index)
+{
+    uint32_t t;
+    memcpy(&t, ring_slot(r, index), sizeof(t));
+    return t;
+}
+
+static void ring_push(history_ring_t *r, const void *rec)
+{
+    memcpy(r->buf + (size_t)r->head * r->rec_size, rec, r->rec_size);
+    r->head = (r->head + 1) % r->capacity;
+    if (r->count < r->capacity) {
+        r->count++;
+    }
+}
+
+// First index with t_ms >= t (records are in time order)
+static uint32_t ring_lower_bound(const history_ring_t *r, uint32_t t)
+{
+    uint32_t lo = 0, hi = r->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ring_time(r, mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static esp_err_t ring_alloc(history_ring_t *r, size_t rec_size, uint32_t capacity, uint32_t caps)
+{
+    r->buf = heap_caps_malloc(rec_size * capacity, caps);
+    if (r->buf == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    r->rec_size = rec_size;
+    r->capacity = capacity;
+    r->head = 0;
+    r->count = 0;
+    return ESP_OK;
+}
+
+static void agg_merge(sensor_history_agg_t *dst, const sensor_history_agg_t *src)
+{
+    if (src->n == 0) {
+        return;
+    }
+    if (dst->n == 0) {
+        *dst = *src;
+        return;
+    }
+    if (src->min < dst->min) {
+        dst->min = src->min;
+    }
+    if (src->max > dst->max) {
+        dst->max = src->max;
+    }
+    dst->sum += src->sum;
+    dst->n += src->n;
+}
+
+void sensor_history_merge(sensor_history_point_t *dst, const sensor_history_point_t *src)
+{
+    for (int i = 0; i < SENSOR_HISTORY_CH_COUNT; i++) {
+        agg_merge(&dst->ch[i], &src->ch[i]);
+    }
+}
+
+static void raw_to_point(const raw_record_t *rec, sensor_history_point_t *p)
+{
+    p->t_ms = rec->t_ms;
+    for (int i = 0; i < SENSOR_HISTORY_CH_COUNT; i++) {
+        sensor_history_agg_t *a = &p->ch[i];
+        if (rec->valid & (1u << i)) {
+            a->min = a->max = a->sum = rec->value[i];
+            a->n = 1;
+        } else {
+            memset(a, 0, sizeof(*a));
+        }
+    }
+}
+
+// Adds a raw sample to the open interval of a rollup tier, closing the
+// previous interval into the ring when the sample starts a new one
+static void rollup_add(sensor_history_tier_t tier, const sensor_history_point_t *sample)
+{
+    uint32_t start = sample->t_ms - sample->t_ms % tier_resolution_ms[tier];
+    sensor_history_point_t *open = &open_point[tier];
+
+    if (open_valid[tier] && open->t_ms != start) {
+        ring_push(&rings[tier], open);
+        open_valid[tier] = false;
+    }
+    if (!open_valid[tier]) {
+        memset(open, 0, sizeof(*open));
+        open->t_ms = start;
+        open_valid[tier] = true;
+    }
+    sensor_history_merge(open, sample);
+}
+
+esp_err_t sensor_history_init(void)
+{
+    if (history_mutex != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    history_mutex = xSemaphoreCreateMutex();
+    if (history_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // PSRAM first, then fall back to the small internal-RAM layout
+    in_psram = ring_alloc(&rings[SENSOR_HISTORY_TIER_RAW], sizeof(raw_record_t),
+                          HISTORY_RAW_CAP_PSRAM, MALLOC_CAP_SPIRAM) == ESP_OK &&
+               ring_alloc(&rings[SENSOR_HISTORY_TIER_MINUTE], sizeof(sensor_history_point_t),
+                          HISTORY_MINUTE_CAP_PSRAM, MALLOC_CAP_SPIRAM) == ESP_OK &&
+               ring_alloc(&rings[SENSOR_HISTORY_TIER_HOUR], sizeof(sensor_history_point_t),
+                          HISTORY_HOUR_CAP_PSRAM, MALLOC_CAP_SPIRAM) == ESP_OK;
+
+    if (!in_psram) {
+        for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+            heap_caps_free(rings[i].buf);
+            rings[i].buf = NULL;
+        }
+
+        const uint32_t caps = MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+        if (ring_alloc(&rings[SENSOR_HISTORY_TIER_RAW], sizeof(raw_record_t),
+                       HISTORY_RAW_CAP_INTERNAL, caps) != ESP_OK ||
+            ring_alloc(&rings[SENSOR_HISTORY_TIER_MINUTE], sizeof(sensor_history_point_t),
+                       HISTORY_MINUTE_CAP_INTERNAL, caps) != ESP_OK ||
+            ring_alloc(&rings[SENSOR_HISTORY_TIER_HOUR], sizeof(sensor_history_point_t),
+                       HISTORY_HOUR_CAP_INTERNAL, caps) != ESP_OK) {
+            ESP_LOGE(TAG, "History buffer allocation failed");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+        total += rings[i].rec_size * rings[i].capacity;
+    }
+    ESP_LOGI(TAG, "History in %s: %lu raw, %lu minute, %lu hour points (%u bytes)",
+             in_psram ? "PSRAM" : "internal RAM",
+             (unsigned long)rings[SENSOR_HISTORY_TIER_RAW].capacity,
+             (unsigned long)rings[SENSOR_HISTORY_TIER_MINUTE].capacity,
+             (unsigned long)rings[SENSOR_HISTORY_TIER_HOUR].capacity, (unsigned)total);
+    return ESP_OK;
+}
+
+void sensor_history_add(const sensor_data_t *data)
+{
+    if (history_mutex == NULL) {
+        return;
+    }
+
+    raw_record_t rec = {
+        .t_ms = data->timestamp,
+        .value = {
+            data->aht22_temperature, data->aht22_humidity,
+            data->bmp180_temperature, data->bmp180_pressure,
+        },
+        .valid = 0,
+    };
+    if (data->aht22_available) {
+        rec.valid |= (1u << SENSOR_HISTORY_CH_AHT22_TEMPERATURE) | (1u << SENSOR_HISTORY_CH_AHT22_HUMIDITY);
+    }
+    if (data->bmp180_available) {
+        rec.valid |= (1u << SENSOR_HISTORY_CH_BMP180_TEMPERATURE) | (1u << SENSOR_HISTORY_CH_BMP180_PRESSURE);
+    }
+
+    sensor_history_point_t point;
+    raw_to_point(&rec, &point);
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    ring_push(&rings[SENSOR_HISTORY_TIER_RAW], &rec);
+    rollup_add(SENSOR_HISTORY_TIER_MINUTE, &point);
+    rollup_add(SENSOR_HISTORY_TIER_HOUR, &point);
+    xSemaphoreGive(history_mutex);
+}
+
+uint32_t sensor_history_tier_resolution_ms(sensor_history_tier_t tier)
+{
+    return tier < SENSOR_HISTORY_TIER_COUNT ? tier_resolution_ms[tier] : 0;
+}
+
+sensor_history_tier_t sensor_history_pick_tier(uint32_t from_ms, uint32_t step_ms)
+{
+    sensor_history_tier_t tier = SENSOR_HISTORY_TIER_RAW;
+    if (step_ms >= SENSOR_HISTORY_HOUR_MS) {
+        tier = SENSOR_HISTORY_TIER_HOUR;
+    } else if (step_ms >= SENSOR_HISTORY_MINUTE_MS) {
+        tier = SENSOR_HISTORY_TIER_MINUTE;
+    }
+
+    if (history_mutex == NULL) {
+        return tier;
+    }
+
+    // Range starts before this tier's oldest point: use the next tier if
+    // it reaches further back
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    while (tier + 1 < SENSOR_HISTORY_TIER_COUNT) {
+        const history_ring_t *cur = &rings[tier];
+        const history_ring_t *next = &rings[tier + 1];
+        if (cur->count > 0 && ring_time(cur, 0) <= from_ms) {
+            break;
+        }
+        if (next->count == 0 || (cur->count > 0 && ring_time(next, 0) >= ring_time(cur, 0))) {
+            break;
+        }
+        tier++;
+    }
+    xSemaphoreGive(history_mutex);
+    return tier;
+}
+
+size_t sensor_history_read(sensor_history_tier_t tier, uint32_t *cursor_ms, uint32_t to_ms,
+                           sensor_history_point_t *out, size_t max)
+{
+    if (history_mutex == NULL || tier >= SENSOR_HISTORY_TIER_COUNT || *cursor_ms > to_ms) {
+        return 0;
+    }
+
+    const history_ring_t *r = &rings[tier];
+    size_t n = 0;
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    for (uint32_t i = ring_lower_bound(r, *cursor_ms); i < r->count && n < max; i++) {
+        const void *rec = ring_slot(r, i);
+        if (ring_time(r, i) > to_ms) {
+            break;
+        }
+        if (tier == SENSOR_HISTORY_TIER_RAW) {
+            raw_to_point(rec, &out[n]);
+        } else {
+            memcpy(&out[n], rec, sizeof(out[n]));
+        }
+        n++;
+    }
+
+    // The open interval is newer than anything in the ring
+    if (n < max && tier != SENSOR_HISTORY_TIER_RAW && open_valid[tier]) {
+        const sensor_history_point_t *open = &open_point[tier];
+        uint32_t after = n > 0 ? out[n - 1].t_ms + 1 : *cursor_ms;
+        if (open->t_ms >= after && open->t_ms <= to_ms) {
+            out[n++] = *open;
+        }
+    }
+    xSemaphoreGive(history_mutex);
+
+    if (n > 0) {
+        *cursor_ms = out[n - 1].t_ms + 1;
+    }
+    return n;
+}
+
+void sensor_history_get_info(sensor_history_info_t *info)
+{
+    memset(info, 0, sizeof(*info));
+    if (history_mutex == NULL) {
+        return;
+    }
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    info->psram = in_psram;
+    for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+        info->capacity[i] = rings[i].capacity;
+        info->count[i] = rings[i].count;
+        info->oldest_ms[i] = rings[i].count > 0 ? ring_time(&rings[i], 0) : 0;
+    }
+    xSemaphoreGive(history_mutex);
+}
@@ -0,0 +1,80 @@
+#ifndef SENSOR_HISTORY_H
+#define SENSOR_HISTORY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sensors.h"
+
+// Fixed-size sample history in three tiers: raw samples, 1-minute and
+// 1-hour min/avg/max rollups. Buffers live in PSRAM when available,
+// otherwise in internal RAM with smaller capacities. Timestamps are
+// uptime milliseconds (sensor_data_t.timestamp).
+
+typedef enum {
+    SENSOR_HISTORY_TIER_RAW = 0,
+    SENSOR_HISTORY_TIER_MINUTE,
+    SENSOR_HISTORY_TIER_HOUR,
+    SENSOR_HISTORY_TIER_COUNT
+} sensor_history_tier_t;
+
+typedef enum {
+    SENSOR_HISTORY_CH_AHT22_TEMPERATURE = 0,
+    SENSOR_HISTORY_CH_AHT22_HUMIDITY,
+    SENSOR_HISTORY_CH_BMP180_TEMPERATURE,
+    SENSOR_HISTORY_CH_BMP180_PRESSURE,
+    SENSOR_HISTORY_CH_COUNT
+} sensor_history_channel_t;
+
+#define SENSOR_HISTORY_MINUTE_MS    60000
+#define SENSOR_HISTORY_HOUR_MS      3600000
+
+// Aggregate of one channel; n = 0 means the sensor had no reading
+typedef struct {
+    float min;
+    float max;
+    float sum;
+    uint16_t n;
+} sensor_history_agg_t;
+
+// One point of any tier (raw samples have n = 1)
+typedef struct {
+    uint32_t t_ms;          // Sample time, or start of the rollup interval
+    sensor_history_agg_t ch[SENSOR_HISTORY_CH_COUNT];
+} sensor_history_point_t;
+
+typedef struct {
+    bool psram;
+    uint32_t capacity[SENSOR_HISTORY_TIER_COUNT];
+    uint32_t count[SENSOR_HISTORY_TIER_COUNT];
+    uint32_t oldest_ms[SENSOR_HISTORY_TIER_COUNT];  // Valid when count > 0
+} sensor_history_info_t;
+
+esp_err_t sensor_history_init(void);
+
+// Single producer (the acquisition task)
+void sensor_history_add(const sensor_data_t *data);
+
+// Resolution of a tier in ms (0 for raw)
+uint32_t sensor_history_tier_resolution_ms(sensor_history_tier_t tier);
+
+// Coarsest tier not coarser than step_ms, moved to a coarser tier when
+// the finer one no longer reaches back to from_ms
+sensor_history_tier_t sensor_history_pick_tier(uint32_t from_ms, uint32_t step_ms);
+
+// Copies up to max points of a tier with *cursor_ms <= t_ms <= to_ms,
+// oldest first, and advances the cursor past the last one. Rollup points
+// are matched by interval start, so a first read meant to include the
+// interval containing some time t starts at t - t % resolution. The open
+// (not yet complete) rollup interval is included last. Returns the
+// number of points copied, 0 when done.
+size_t sensor_history_read(sensor_history_tier_t tier, uint32_t *cursor_ms, uint32_t to_ms,
+                           sensor_history_point_t *out, size_t max);
+
+// Merges the aggregates of src into dst (dst keeps its t_ms)
+void sensor_history_merge(sensor_history_point_t *dst, const sensor_history_point_t *src);
+
+void sensor_history_get_info(sensor_history_info_t *info);
+
+#endif
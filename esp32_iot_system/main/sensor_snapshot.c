@@ -0,0 +1,46 @@
+#include <string.h>
+#include "esp_timer.h"
+#include "seqlock.h"
+#include "sensor_snapshot.h"
+
+static seqlock_t snapshot_lock;
+static sensor_snapshot_t snapshot_buf[2];
+
+void sensor_snapshot_publish(const sensor_data_t *data)
+{
+    sensor_snapshot_t snap = {
+        .data = *data,
+        .seq = seqlock_generation(&snapshot_lock) + 1,
+        .published_us = esp_timer_get_time(),
+    };
+
+    // Update both copies; readers always have the other one available
+    uint32_t idx = seqlock_write_next(&snapshot_lock);
+    snapshot_buf[idx] = snap;
+    idx = seqlock_write_next(&snapshot_lock);
+    snapshot_buf[idx] = snap;
+}
+
+bool sensor_snapshot_read(sensor_snapshot_t *out)
+{
+    uint32_t seq;
+    do {
+        seq = seqlock_read_begin(&snapshot_lock);
+        *out = snapshot_buf[seq & 1];
+    } while (seqlock_read_retry(&snapshot_lock, seq));
+
+    return out->seq != 0;
+}
+
+uint32_t sensor_snapshot_seq(void)
+{
+    return seqlock_generation(&snapshot_lock);
+}
+
+uint32_t sensor_snapshot_age_ms(const sensor_snapshot_t *snap)
+{
+    if (snap->seq == 0) {
+        return 0;
+    }
+    return (uint32_t)((esp_timer_get_time() - snap->published_us) / 1000);
+}
@@ -0,0 +1,25 @@
+#ifndef SENSOR_SNAPSHOT_H
+#define SENSOR_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sensors.h"
+
+// Latest completed sample, published by the sensor task and read lock-free
+// by any other task (HTTP handlers etc.)
+typedef struct {
+    sensor_data_t data;
+    uint32_t seq;           // Sample sequence number, starts at 1
+    int64_t published_us;   // esp_timer time when the sample was published
+} sensor_snapshot_t;
+
+// Single producer only (the sensor task)
+void sensor_snapshot_publish(const sensor_data_t *data);
+
+// Returns false if no sample has been published yet
+bool sensor_snapshot_read(sensor_snapshot_t *out);
+
+uint32_t sensor_snapshot_seq(void);
+uint32_t sensor_snapshot_age_ms(const sensor_snapshot_t *snap);
+
+#endif
@@ -3,35 +3,32 @@
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "driver/i2c.h"
 #include "esp_log.h"
 #include "sensors.h"
-#include "relay_control.h"
-#include "nvs_storage.h"
+#include "i2c_bus_hw.h"
 
 static const char *TAG = "SENSORS";
 static bmp180_calib_data_t bmp180_calib;
+static volatile uint8_t bmp180_oss = 0;    // Configured oversampling setting
+
+static i2c_bus_device_t aht20_dev = { .addr = AHT20_ADDR, .timeout_ms = 1000 };
+static i2c_bus_device_t bmp180_dev = { .addr = BMP180_ADDR, .timeout_ms = 1000 };
 
 esp_err_t sensors_init(void)
 {
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = I2C_MASTER_SDA_IO,
-        .scl_io_num = I2C_MASTER_SCL_IO,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = I2C_MASTER_FREQ_HZ,
-    };
-
-    esp_err_t ret = i2c_param_config(I2C_MASTER_NUM, &conf);
+    esp_err_t ret = i2c_bus_init(&i2c_bus_hw_backend);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C param config failed");
+        ESP_LOGE(TAG, "I2C bus init failed");
         return ret;
     }
 
-    ret = i2c_driver_install(I2C_MASTER_NUM, conf.mode, 0, 0, 0);
+    // Device handles are created once and reused for every transaction
+    ret = i2c_bus_add_device(&aht20_dev);
+    if (ret == ESP_OK) {
+        ret = i2c_bus_add_device(&bmp180_dev);
+    }
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "I2C driver install failed");
+        ESP_LOGE(TAG, "I2C device setup failed");
         return ret;
     }
 
@@ -40,13 +37,7 @@ esp_err_t sensors_init(void)
     // Initialize AHT20
     vTaskDelay(pdMS_TO_TICKS(500));
     uint8_t aht20_init_cmd[] = {0xAC, 0x33, 0x00};
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (AHT20_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, aht20_init_cmd, sizeof(aht20_init_cmd), true);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+    ret = i2c_bus_write(&aht20_dev, I2C_BUS_PRIO_NORMAL, aht20_init_cmd, sizeof(aht20_init_cmd));
 
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "AHT20 initialized successfully");
@@ -60,16 +51,7 @@ esp_err_t sensors_init(void)
     // Read chip ID first (should be 0x55 for BMP180)
     uint8_t chip_id;
     uint8_t reg_addr = 0xD0; // Chip ID register
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read_byte(cmd, &chip_id, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+    ret = i2c_bus_write_read(&bmp180_dev, I2C_BUS_PRIO_NORMAL, &reg_addr, 1, &chip_id, 1);
     
     if (ret == ESP_OK) {
         if (chip_id == 0x55) {
@@ -86,16 +68,7 @@ esp_err_t sensors_init(void)
     // Read BMP180 calibration coefficients (0xAA to 0xBF, 22 bytes)
     uint8_t calib_data[22];
     reg_addr = 0xAA; // Start of calibration data
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, calib_data, 22, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+    ret = i2c_bus_write_read(&bmp180_dev, I2C_BUS_PRIO_NORMAL, &reg_addr, 1, calib_data, sizeof(calib_data));
 
     if (ret == ESP_OK) {
         // Parse BMP180 calibration data (Big Endian format)
@@ -128,37 +101,34 @@ esp_err_t sensors_init(void)
     return ESP_OK;
 }
 
-esp_err_t read_aht22(aht22_data_t *data)
+// AHT20: trigger a measurement
+esp_err_t aht20_start_measurement(void)
 {
-    uint8_t trigger_cmd[] = {0xAC, 0x33, 0x00};
-    uint8_t read_data[6];
-
-    // Send trigger command
-    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (AHT20_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, trigger_cmd, sizeof(trigger_cmd), true);
-    i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+    static const uint8_t trigger_cmd[] = {0xAC, 0x33, 0x00};
 
+    esp_err_t ret = i2c_bus_write(&aht20_dev, I2C_BUS_PRIO_CONTROL, trigger_cmd, sizeof(trigger_cmd));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "AHT20 trigger command failed");
-        return ret;
     }
+    return ret;
+}
 
-    // Wait for measurement (AHT20 needs at least 75ms)
-    vTaskDelay(pdMS_TO_TICKS(100));
+// AHT20: status byte bit 7 is set while a measurement is in progress
+esp_err_t aht20_is_busy(bool *busy)
+{
+    uint8_t status;
+    esp_err_t ret = i2c_bus_read(&aht20_dev, I2C_BUS_PRIO_CONTROL, &status, 1);
+    if (ret == ESP_OK) {
+        *busy = (status & 0x80) != 0;
+    }
+    return ret;
+}
 
-    // Read data
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (AHT20_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, read_data, sizeof(read_data), I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
+esp_err_t aht20_read_measurement(aht22_data_t *data)
+{
+    uint8_t read_data[6];
 
+    esp_err_t ret = i2c_bus_read(&aht20_dev, I2C_BUS_PRIO_CONTROL, read_data, sizeof(read_data));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "AHT20 read data failed");
         return ret;
@@ -168,182 +138,106 @@ esp_err_t read_aht22(aht22_data_t *data)
     uint32_t humidity_raw = ((uint32_t)read_data[1] << 12) | ((uint32_t)read_data[2] << 4) | (read_data[3] >> 4);
     uint32_t temperature_raw = ((uint32_t)(read_data[3] & 0x0F) << 16) | ((uint32_t)read_data[4] << 8) | read_data[5];
 
-    data->humidity = (float)humidity_raw / 1048576.0 * 100.0;
-    data->temperature = (float)temperature_raw / 1048576.0 * 200.0 - 50.0;
+    data->humidity = sensor_comp_centi_to_float(aht20_comp_humidity_centi(humidity_raw));
+    data->temperature = sensor_comp_centi_to_float(aht20_comp_temperature_centi(temperature_raw));
 
     return ESP_OK;
 }
 
-esp_err_t read_bmp180(bmp180_data_t *data)
+// BMP180: write a measurement command to the control register (0xF4)
+static esp_err_t bmp180_start_conversion(uint8_t command)
 {
-    esp_err_t ret;
-    i2c_cmd_handle_t cmd;
-    
-    // Step 1: Read uncompensated temperature (UT)
-    // Write temperature measurement command (0x2E) to control register (0xF4)
-    uint8_t temp_cmd[] = {0xF4, 0x2E};
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, temp_cmd, sizeof(temp_cmd), true);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
+    uint8_t ctrl_cmd[] = {0xF4, command};
+    return i2c_bus_write(&bmp180_dev, I2C_BUS_PRIO_CONTROL, ctrl_cmd, sizeof(ctrl_cmd));
+}
+
+// BMP180: read the conversion result from registers 0xF6..
+static esp_err_t bmp180_read_result(uint8_t *buf, size_t len)
+{
+    uint8_t reg_addr = 0xF6;
+    return i2c_bus_write_read(&bmp180_dev, I2C_BUS_PRIO_CONTROL, &reg_addr, 1, buf, len);
+}
+
+// BMP180: control register bit 5 (SCO) stays set until the conversion is done
+esp_err_t bmp180_is_busy(bool *busy)
+{
+    uint8_t reg_addr = 0xF4;
+    uint8_t ctrl;
+    esp_err_t ret = i2c_bus_write_read(&bmp180_dev, I2C_BUS_PRIO_CONTROL, &reg_addr, 1, &ctrl, 1);
+    if (ret == ESP_OK) {
+        *busy = (ctrl & 0x20) != 0;
+    }
+    return ret;
+}
+
+// Uncompensated temperature (UT)
+esp_err_t bmp180_start_temperature(void)
+{
+    esp_err_t ret = bmp180_start_conversion(0x2E);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "BMP180 temperature command failed");
-        return ret;
     }
-    
-    // Wait for temperature conversion (at least 4.5ms)
-    vTaskDelay(pdMS_TO_TICKS(10));
-    
-    // Read temperature data from registers 0xF6 and 0xF7
+    return ret;
+}
+
+esp_err_t bmp180_read_temperature_raw(int32_t *ut)
+{
     uint8_t temp_data[2];
-    uint8_t reg_addr = 0xF6;
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, temp_data, 2, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
+    esp_err_t ret = bmp180_read_result(temp_data, sizeof(temp_data));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "BMP180 temperature read failed");
         return ret;
     }
-    
-    int32_t ut = (temp_data[0] << 8) | temp_data[1];
-    
-    // Step 2: Read uncompensated pressure (UP)
-    // Write pressure measurement command (0x34 + (OSS << 6), OSS=0 for simplicity)
-    uint8_t press_cmd[] = {0xF4, 0x34}; // OSS = 0 (ultra low power)
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write(cmd, press_cmd, sizeof(press_cmd), true);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
+
+    *ut = (temp_data[0] << 8) | temp_data[1];
+    return ESP_OK;
+}
+
+esp_err_t bmp180_set_oss(uint8_t oss)
+{
+    if (oss > BMP180_OSS_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    bmp180_oss = oss;
+    ESP_LOGI(TAG, "BMP180 oversampling set to OSS=%d", oss);
+    return ESP_OK;
+}
+
+uint8_t bmp180_get_oss(void)
+{
+    return bmp180_oss;
+}
+
+// Uncompensated pressure (UP), oss 0 (ultra low power) .. 3 (ultra high resolution)
+esp_err_t bmp180_start_pressure(uint8_t oss)
+{
+    esp_err_t ret = bmp180_start_conversion(0x34 + (oss << 6));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "BMP180 pressure command failed");
-        return ret;
     }
-    
-    // Wait for pressure conversion (at least 4.5ms for OSS=0)
-    vTaskDelay(pdMS_TO_TICKS(10));
-    
-    // Read pressure data from registers 0xF6, 0xF7, 0xF8
+    return ret;
+}
+
+esp_err_t bmp180_read_pressure_raw(uint8_t oss, int32_t *up)
+{
     uint8_t press_data[3];
-    reg_addr = 0xF6;
-    cmd = i2c_cmd_link_create();
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_WRITE, true);
-    i2c_master_write_byte(cmd, reg_addr, true);
-    i2c_master_start(cmd);
-    i2c_master_write_byte(cmd, (BMP180_ADDR << 1) | I2C_MASTER_READ, true);
-    i2c_master_read(cmd, press_data, 3, I2C_MASTER_LAST_NACK);
-    i2c_master_stop(cmd);
-    ret = i2c_master_cmd_begin(I2C_MASTER_NUM, cmd, pdMS_TO_TICKS(1000));
-    i2c_cmd_link_delete(cmd);
-    
+    esp_err_t ret = bmp180_read_result(press_data, sizeof(press_data));
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "BMP180 pressure read failed");
         return ret;
     }
-    
-    int32_t up = ((press_data[0] << 16) | (press_data[1] << 8) | press_data[2]) >> 8; // OSS = 0
-    
-    // Step 3: Calculate true temperature
-    int32_t x1 = ((ut - bmp180_calib.ac6) * bmp180_calib.ac5) >> 15;
-    int32_t x2 = (bmp180_calib.mc << 11) / (x1 + bmp180_calib.md);
-    int32_t b5 = x1 + x2;
-    int32_t t = (b5 + 8) >> 4; // Temperature in 0.1°C
-    
-    data->temperature = t / 10.0; // Convert to °C
-    
-    // Step 4: Calculate true pressure
-    int32_t b6 = b5 - 4000;
-    x1 = (bmp180_calib.b2 * ((b6 * b6) >> 12)) >> 11;
-    x2 = (bmp180_calib.ac2 * b6) >> 11;
-    int32_t x3 = x1 + x2;
-    int32_t b3 = (((bmp180_calib.ac1 * 4 + x3) << 0) + 2) >> 2; // OSS = 0
-    x1 = (bmp180_calib.ac3 * b6) >> 13;
-    x2 = (bmp180_calib.b1 * ((b6 * b6) >> 12)) >> 16;
-    x3 = ((x1 + x2) + 2) >> 2;
-    uint32_t b4 = (bmp180_calib.ac4 * (uint32_t)(x3 + 32768)) >> 15;
-    uint32_t b7 = ((uint32_t)up - b3) * (50000 >> 0); // OSS = 0
-    
-    int32_t p;
-    if (b7 < 0x80000000) {
-        p = (b7 * 2) / b4;
-    } else {
-        p = (b7 / b4) * 2;
-    }
-    
-    x1 = (p >> 8) * (p >> 8);
-    x1 = (x1 * 3038) >> 16;
-    x2 = (-7357 * p) >> 16;
-    p = p + ((x1 + x2 + 3791) >> 4); // Pressure in Pa
-    
-    data->pressure = p / 100.0; // Convert to hPa
-    
-    // BMP180 reading successful
-    
+
+    *up = ((press_data[0] << 16) | (press_data[1] << 8) | press_data[2]) >> (8 - oss);
     return ESP_OK;
 }
 
-esp_err_t get_sensor_data(sensor_data_t *data)
+int32_t bmp180_compute_b5(int32_t ut)
 {
-    aht22_data_t aht_data;
-    bmp180_data_t bmp_data;
-    
-    // Set default values
-    data->aht22_temperature = 25.0;
-    data->aht22_humidity = 50.0;
-    data->aht22_available = false;
-    data->bmp180_temperature = 25.0;
-    data->bmp180_pressure = 1013.2;
-    data->bmp180_available = false;
-    data->timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    
-    // Try to read AHT20
-    esp_err_t aht_ret = read_aht22(&aht_data);
-    if (aht_ret == ESP_OK) {
-        data->aht22_temperature = aht_data.temperature;
-        data->aht22_humidity = aht_data.humidity;
-        data->aht22_available = true;
-        ESP_LOGI(TAG, "AHT22 - Temp: %.1f°C, Humidity: %.1f%%", aht_data.temperature, aht_data.humidity);
-    } else {
-        ESP_LOGE(TAG, "Failed to read AHT20");
-    }
-    
-    // Try to read BMP180
-    esp_err_t bmp_ret = read_bmp180(&bmp_data);
-    if (bmp_ret == ESP_OK) {
-        data->bmp180_temperature = bmp_data.temperature;
-        data->bmp180_pressure = bmp_data.pressure;
-        data->bmp180_available = true;
-        ESP_LOGI(TAG, "BMP180 - Temp: %.1f°C, Pressure: %.1f hPa", bmp_data.temperature, bmp_data.pressure);
-    } else {
-        ESP_LOGE(TAG, "Failed to read BMP180");
-    }
-    
-    // Auto relay control if in auto mode (prioritize AHT22 temperature, fallback to BMP180)
-    if (get_relay_mode() == RELAY_MODE_AUTO) {
-        float temp_high = 30.0, temp_low = 20.0;  // Default values
-        storage_load_temp_thresholds(&temp_high, &temp_low);
-        
-        float control_temp = data->aht22_available ? data->aht22_temperature : data->bmp180_temperature;
-        auto_control_relay(control_temp, temp_high, temp_low);
-        ESP_LOGI(TAG, "Auto control using %s temperature: %.1f°C", 
-                 data->aht22_available ? "AHT22" : "BMP180", control_temp);
-    }
-    
-    return ESP_OK;
-} 
\ No newline at end of file
+    return bmp180_comp_b5(&bmp180_calib, ut);
+}
+
+void bmp180_compensate(int32_t b5, int32_t up, uint8_t oss, bmp180_data_t *data)
+{
+    data->temperature = sensor_comp_centi_to_float(bmp180_comp_temperature_centi(b5));
+    data->pressure = sensor_comp_pa_to_hpa(bmp180_comp_pressure_pa(&bmp180_calib, b5, up, oss));
+}
@@ -1,13 +1,11 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include <stdbool.h>
 #include "esp_err.h"
-
-// Pin definitions (theo board ESP32-S3 thực tế)
-#define I2C_MASTER_SCL_IO           2     // SCL pin (IO2)
-#define I2C_MASTER_SDA_IO           1     // SDA pin (IO1)
-#define I2C_MASTER_NUM              0     // I2C port number
-#define I2C_MASTER_FREQ_HZ          50000  // Giảm từ 100kHz xuống 50kHz
+#include "i2c_bus.h"
+#include "sensor_comp.h"
+#include "app_config_defaults.h"
 
 // AHT20 I2C address (same as AHT22)
 #define AHT20_ADDR                  0x38
@@ -15,21 +13,6 @@
 #define BMP180_ADDR                 0x77
 #define BMP180_ADDR_ALT             0x76
 
-// BMP180 Calibration data structure (khác hoàn toàn so với BMP280)
-typedef struct {
-    int16_t ac1;
-    int16_t ac2;
-    int16_t ac3;
-    uint16_t ac4;
-    uint16_t ac5;
-    uint16_t ac6;
-    int16_t b1;
-    int16_t b2;
-    int16_t mb;
-    int16_t mc;
-    int16_t md;
-} bmp180_calib_data_t;
-
 typedef struct {
     float temperature;
     float humidity;
@@ -51,13 +34,46 @@ typedef struct {
     float bmp180_temperature;
     float bmp180_pressure;
     bool bmp180_available;
+    uint8_t bmp180_oss;         // Oversampling setting used for the pressure
     
     uint32_t timestamp;
 } sensor_data_t;
 
+// Conversion timing: first status poll, poll interval, datasheet maximum.
+// Results are read as soon as the busy bit clears; the maximum is only
+// used as a fallback when the status never reports completion.
+#define AHT20_POLL_FIRST_US         40000
+#define AHT20_POLL_INTERVAL_US      5000
+#define AHT20_MEASURE_TIME_US       80000
+#define BMP180_POLL_FIRST_US        3000
+#define BMP180_POLL_INTERVAL_US     500
+#define BMP180_TEMP_CONV_TIME_US    4500
+
+// BMP180 pressure oversampling (OSS): 0 = 1 sample / 4.5 ms max,
+// 1 = 2 / 7.5 ms, 2 = 4 / 13.5 ms, 3 = 8 / 25.5 ms
+#define BMP180_OSS_MAX              3
+#define BMP180_OSS_DEFAULT          APP_CONFIG_DEFAULT_BMP180_OSS
+
 esp_err_t sensors_init(void);
-esp_err_t read_aht22(aht22_data_t *data);
-esp_err_t read_bmp180(bmp180_data_t *data);
-esp_err_t get_sensor_data(sensor_data_t *data);
+
+// Split-phase drivers: start a conversion, poll *_is_busy(), then read the
+// result. Sequencing is done by sensor_acq.
+esp_err_t aht20_start_measurement(void);
+esp_err_t aht20_is_busy(bool *busy);
+esp_err_t aht20_read_measurement(aht22_data_t *data);
+
+esp_err_t bmp180_is_busy(bool *busy);
+esp_err_t bmp180_start_temperature(void);
+esp_err_t bmp180_read_temperature_raw(int32_t *ut);
+esp_err_t bmp180_start_pressure(uint8_t oss);
+esp_err_t bmp180_read_pressure_raw(uint8_t oss, int32_t *up);
+// B5 compensation term from the uncompensated temperature; it can be
+// reused for pressure samples taken while the temperature is unchanged
+int32_t bmp180_compute_b5(int32_t ut);
+void bmp180_compensate(int32_t b5, int32_t up, uint8_t oss, bmp180_data_t *data);
+
+// Oversampling used for the next pressure conversion
+esp_err_t bmp180_set_oss(uint8_t oss);
+uint8_t bmp180_get_oss(void);
 
 #endif 
\ No newline at end of file
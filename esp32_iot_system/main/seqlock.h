@@ -0,0 +1,48 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single-writer, double-buffered sequence lock.
+// The writer keeps two copies of the data and flips the sequence before
+// rewriting each one, so a reader always finds a stable copy at index
+// (seq & 1) and never waits for the writer. A reader only retries if a
+// full update raced with its copy.
+//
+// Writer:  idx = seqlock_write_next(&l); buf[idx] = v;
+//          idx = seqlock_write_next(&l); buf[idx] = v;
+// Reader:  do { s = seqlock_read_begin(&l); v = buf[s & 1]; }
+//          while (seqlock_read_retry(&l, s));
+typedef struct {
+    volatile uint32_t seq;
+} seqlock_t;
+
+static inline uint32_t seqlock_read_begin(const seqlock_t *lock)
+{
+    return __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE);
+}
+
+static inline bool seqlock_read_retry(const seqlock_t *lock, uint32_t start)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->seq, __ATOMIC_RELAXED) != start;
+}
+
+// Returns the index of the copy that readers are no longer using.
+static inline uint32_t seqlock_write_next(seqlock_t *lock)
+{
+    uint32_t seq = lock->seq + 1;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&lock->seq, seq, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return (seq & 1) ^ 1;
+}
+
+// Number of completed two-copy updates.
+static inline uint32_t seqlock_generation(const seqlock_t *lock)
+{
+    return __atomic_load_n(&lock->seq, __ATOMIC_ACQUIRE) / 2;
+}
+
+#endif
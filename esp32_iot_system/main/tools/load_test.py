@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Check that slow requests do not delay fast ones.
+
+Usage: load_test.py BASE_URL [SECONDS] [SLOW_CLIENTS]
+
+Polls /api/relay from one client and prints its latency percentiles in two
+phases: alone, then while SLOW_CLIENTS threads keep requesting history
+exports, log exports and fresh sensor reads. With slow routes on the worker
+pool, p99 of /api/relay should stay about the same in both phases.
+Needs only the standard library. Run it from a host on the device's network.
+"""
+import sys
+import threading
+import time
+import urllib.error
+import urllib.request
+
+SLOW_PATHS = [
+    '/api/history?from=0&step=0',
+    '/api/log?limit=5000',
+    '/api/sensors?fresh=1&max_age=0',
+]
+FAST_PATH = '/api/relay'
+FAST_INTERVAL_S = 0.05
+
+
+def fetch(url, timeout=10):
+    """Reads the whole body; returns (seconds, status) or (seconds, None)."""
+    start = time.monotonic()
+    try:
+        with urllib.request.urlopen(url, timeout=timeout) as resp:
+            resp.read()
+            status = resp.status
+    except urllib.error.HTTPError as e:
+        status = e.code
+    except (urllib.error.URLError, OSError):
+        status = None
+    return time.monotonic() - start, status
+
+
+def percentile(values, pct):
+    if not values:
+        return float('nan')
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * pct / 100))]
+
+
+def poll_fast(base, seconds):
+    latencies = []
+    errors = 0
+    end = time.monotonic() + seconds
+    while time.monotonic() < end:
+        elapsed, status = fetch(base + FAST_PATH)
+        if status == 200:
+            latencies.append(elapsed * 1000)
+        else:
+            errors += 1
+        time.sleep(FAST_INTERVAL_S)
+    return latencies, errors
+
+
+def slow_client(base, index, stop, counts):
+    i = index
+    while not stop.is_set():
+        _, status = fetch(base + SLOW_PATHS[i % len(SLOW_PATHS)], timeout=30)
+        counts[status] = counts.get(status, 0) + 1
+        i += 1
+
+
+def report(name, latencies, errors):
+    print(f'{name:>8}: n={len(latencies)} errors={errors} '
+          f'p50={percentile(latencies, 50):.1f} ms '
+          f'p90={percentile(latencies, 90):.1f} ms '
+          f'p99={percentile(latencies, 99):.1f} ms '
+          f'max={max(latencies, default=float("nan")):.1f} ms')
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit(__doc__)
+    base = sys.argv[1].rstrip('/')
+    seconds = float(sys.argv[2]) if len(sys.argv) > 2 else 30
+    slow_clients = int(sys.argv[3]) if len(sys.argv) > 3 else 3
+
+    report('idle', *poll_fast(base, seconds))
+
+    stop = threading.Event()
+    counts = {}
+    threads = [threading.Thread(target=slow_client, args=(base, i, stop, counts), daemon=True)
+               for i in range(slow_clients)]
+    for t in threads:
+        t.start()
+    report('loaded', *poll_fast(base, seconds))
+    stop.set()
+    for t in threads:
+        t.join(timeout=35)
+    print(f'slow requests by status: {counts}')
+
+
+if __name__ == '__main__':
+    main()
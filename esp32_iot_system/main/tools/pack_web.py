@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Minify and gzip the web UI into a C source for the firmware.
+
+Usage: pack_web.py OUT_C FILE=URI [FILE=URI ...]
+
+Each FILE is minified (comments and indentation removed, line breaks kept
+so JavaScript semicolon insertion is unaffected), gzipped and emitted as a
+byte array with a strong ETag taken from a hash of the compressed bytes.
+References to the other assets inside HTML are rewritten to "name?v=<hash>"
+so those assets can be cached as immutable. Output is deterministic.
+"""
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+}
+
+
+def strip_comments(text, line_comments, quotes):
+    """Drops /* */ (and // when line_comments) outside string literals."""
+    out = []
+    i = 0
+    n = len(text)
+    quote = None
+    while i < n:
+        c = text[i]
+        if quote:
+            out.append(c)
+            if c == '\\' and i + 1 < n:
+                out.append(text[i + 1])
+                i += 2
+                continue
+            if c == quote:
+                quote = None
+            i += 1
+        elif c in quotes:
+            quote = c
+            out.append(c)
+            i += 1
+        elif text.startswith('/*', i):
+            end = text.find('*/', i + 2)
+            i = n if end < 0 else end + 2
+        elif line_comments and text.startswith('//', i):
+            end = text.find('\n', i)
+            i = n if end < 0 else end
+        else:
+            out.append(c)
+            i += 1
+    return ''.join(out)
+
+
+def strip_lines(text):
+    lines = (line.strip() for line in text.splitlines())
+    return '\n'.join(line for line in lines if line) + '\n'
+
+
+def minify(name, text):
+    ext = os.path.splitext(name)[1]
+    if ext == '.css':
+        text = strip_lines(strip_comments(text, False, '"\''))
+        text = re.sub(r'\s*([{};,>])\s*', r'\1', text)
+        text = re.sub(r':\s+', ':', text)
+        return text.replace(';}', '}')
+    if ext == '.js':
+        return strip_lines(strip_comments(text, True, '"\'`'))
+    if ext == '.html':
+        return strip_lines(re.sub(r'<!--.*?-->', '', text, flags=re.S))
+    return text
+
+
+def c_name(name):
+    return re.sub(r'\W', '_', name)
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.exit(__doc__)
+    out_c = sys.argv[1]
+    assets = []
+    for arg in sys.argv[2:]:
+        path, uri = arg.split('=', 1)
+        with open(path, encoding='utf-8') as f:
+            text = f.read()
+        assets.append({'path': path, 'name': os.path.basename(path), 'uri': uri, 'text': text})
+
+    # Sub-resources first, so the HTML can reference their hashes
+    versions = {}
+    for a in sorted(assets, key=lambda a: a['name'].endswith('.html')):
+        text = minify(a['name'], a['text'])
+        if a['name'].endswith('.html'):
+            for name, version in versions.items():
+                text = re.sub(r'(["\'])%s\1' % re.escape(name), r'\g<1>%s?v=%s\1' % (name, version), text)
+        raw = text.encode('utf-8')
+        gz = gzip.compress(raw, compresslevel=9, mtime=0)
+        a['raw_size'] = len(a['text'].encode('utf-8'))
+        a['min_size'] = len(raw)
+        a['gz'] = gz
+        a['etag'] = hashlib.sha256(gz).hexdigest()[:16]
+        versions[a['name']] = a['etag']
+
+    lines = [
+        '// Generated by pack_web.py, do not edit',
+        '#include "web_assets.h"',
+        '',
+    ]
+    for a in assets:
+        lines.append('static const uint8_t %s_gz[%d] = {' % (c_name(a['name']), len(a['gz'])))
+        gz = a['gz']
+        for i in range(0, len(gz), 16):
+            lines.append('    ' + ', '.join('0x%02x' % b for b in gz[i:i + 16]) + ',')
+        lines.append('};')
+        lines.append('')
+
+    lines.append('const web_asset_t web_assets[] = {')
+    for a in assets:
+        ext = os.path.splitext(a['name'])[1]
+        immutable = not a['name'].endswith('.html')
+        lines.append('    {')
+        lines.append('        .uri = "%s",' % a['uri'])
+        lines.append('        .content_type = "%s",' % CONTENT_TYPES.get(ext, 'application/octet-stream'))
+        lines.append('        .data = %s_gz,' % c_name(a['name']))
+        lines.append('        .size = sizeof(%s_gz),' % c_name(a['name']))
+        lines.append('        .raw_size = %d,' % a['raw_size'])
+        lines.append('        .etag = "\\"%s\\"",' % a['etag'])
+        lines.append('        .immutable = %s,' % ('true' if immutable else 'false'))
+        lines.append('    },')
+    lines.append('};')
+    lines.append('')
+    lines.append('const size_t web_assets_count = sizeof(web_assets) / sizeof(web_assets[0]);')
+    lines.append('')
+
+    with open(out_c, 'w', encoding='utf-8') as f:
+        f.write('\n'.join(lines))
+
+    for a in assets:
+        print('%s: %d -> %d minified -> %d gzip' % (a['name'], a['raw_size'], a['min_size'], len(a['gz'])))
+
+
+if __name__ == '__main__':
+    main()
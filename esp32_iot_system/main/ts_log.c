@@ -0,0 +1,377 @@
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "ts_log.h"
+
+static const char *TAG = "TS_LOG";
+
+#define TS_LOG_MAGIC            0x474C5354  // "TSLG"
+#define TS_LOG_VERSION          1
+#define TS_LOG_T_FREE           UINT64_MAX
+
+// Segment header, padded to one record slot so records stay aligned
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t seq;           // Increments for every segment opened
+    uint32_t crc;
+} ts_log_header_t;
+
+#define TS_LOG_HEADER_SPACE     sizeof(ts_log_record_t)
+#define TS_LOG_RECORDS_PER_SEG  ((TS_LOG_SEGMENT_SIZE - TS_LOG_HEADER_SPACE) / sizeof(ts_log_record_t))
+
+// RAM index entry of one segment
+typedef struct {
+    uint32_t seq;
+    uint16_t count;         // Slots used, including records that failed CRC
+    bool used;              // Valid header
+    bool has_data;          // At least one valid record, first/last below
+    uint64_t first_ms;
+    uint64_t last_ms;
+} ts_log_segment_t;
+
+static ts_log_flash_t flash;
+static ts_log_segment_t *segments;
+static uint32_t segment_count;
+static int32_t active = -1;     // Segment being appended to
+static uint64_t time_base_ms;
+static uint64_t newest_ms;
+static bool has_records;
+
+static SemaphoreHandle_t log_mutex;
+static ts_log_stats_t log_stats;
+
+_Static_assert(sizeof(ts_log_record_t) == 32, "ts_log_record_t must stay 32 bytes");
+_Static_assert(sizeof(ts_log_header_t) <= TS_LOG_HEADER_SPACE, "header larger than a record slot");
+
+static esp_err_t partition_read(void *ctx, size_t offset, void *buf, size_t len)
+{
+    return esp_partition_read((const esp_partition_t *)ctx, offset, buf, len);
+}
+
+static esp_err_t partition_write(void *ctx, size_t offset, const void *buf, size_t len)
+{
+    return esp_partition_write((const esp_partition_t *)ctx, offset, buf, len);
+}
+
+static esp_err_t partition_erase(void *ctx, size_t offset, size_t len)
+{
+    return esp_partition_erase_range((const esp_partition_t *)ctx, offset, len);
+}
+
+static size_t slot_offset(uint32_t seg, uint32_t slot)
+{
+    return (size_t)seg * TS_LOG_SEGMENT_SIZE + TS_LOG_HEADER_SPACE + (size_t)slot * sizeof(ts_log_record_t);
+}
+
+static uint32_t record_crc(const ts_log_record_t *rec)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)rec, offsetof(ts_log_record_t, crc));
+}
+
+static bool read_record(uint32_t seg, uint32_t slot, ts_log_record_t *rec)
+{
+    if (flash.read(flash.ctx, slot_offset(seg, slot), rec, sizeof(*rec)) != ESP_OK) {
+        return false;
+    }
+    return rec->t_ms != TS_LOG_T_FREE && rec->crc == record_crc(rec);
+}
+
+static uint64_t read_slot_time(uint32_t seg, uint32_t slot)
+{
+    uint64_t t = TS_LOG_T_FREE;
+    flash.read(flash.ctx, slot_offset(seg, slot), &t, sizeof(t));
+    return t;
+}
+
+// First slot with t_ms >= t (records are appended in time order, free
+// slots read as UINT64_MAX)
+static uint32_t segment_lower_bound(uint32_t seg, uint32_t count, uint64_t t)
+{
+    uint32_t lo = 0, hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (read_slot_time(seg, mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Rebuilds the index entry of one segment from flash
+static void scan_segment(uint32_t seg)
+{
+    ts_log_segment_t *s = &segments[seg];
+    ts_log_header_t hdr;
+    memset(s, 0, sizeof(*s));
+
+    if (flash.read(flash.ctx, (size_t)seg * TS_LOG_SEGMENT_SIZE, &hdr, sizeof(hdr)) != ESP_OK ||
+        hdr.magic != TS_LOG_MAGIC || hdr.version != TS_LOG_VERSION ||
+        hdr.record_size != sizeof(ts_log_record_t) ||
+        hdr.crc != esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(ts_log_header_t, crc))) {
+        return;
+    }
+    s->used = true;
+    s->seq = hdr.seq;
+    s->count = segment_lower_bound(seg, TS_LOG_RECORDS_PER_SEG, TS_LOG_T_FREE);
+
+    // First and last records that pass CRC (a torn write can leave a bad one)
+    ts_log_record_t rec;
+    for (uint32_t i = 0; i < s->count; i++) {
+        if (read_record(seg, i, &rec)) {
+            s->first_ms = rec.t_ms;
+            s->has_data = true;
+            break;
+        }
+    }
+    for (uint32_t i = s->count; s->has_data && i > 0; i--) {
+        if (read_record(seg, i - 1, &rec)) {
+            s->last_ms = rec.t_ms;
+            break;
+        }
+    }
+}
+
+// Erases the segment after the active one (the oldest once the log has
+// wrapped) and makes it the active segment
+static esp_err_t open_next_segment(void)
+{
+    uint32_t next = active < 0 ? 0 : ((uint32_t)active + 1) % segment_count;
+    uint32_t seq = active < 0 ? 1 : segments[active].seq + 1;
+
+    esp_err_t ret = flash.erase(flash.ctx, (size_t)next * TS_LOG_SEGMENT_SIZE, TS_LOG_SEGMENT_SIZE);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Segment %lu erase failed: %s", (unsigned long)next, esp_err_to_name(ret));
+        return ret;
+    }
+    log_stats.segments_erased++;
+
+    ts_log_header_t hdr = {
+        .magic = TS_LOG_MAGIC,
+        .version = TS_LOG_VERSION,
+        .record_size = sizeof(ts_log_record_t),
+        .seq = seq,
+    };
+    hdr.crc = esp_rom_crc32_le(0, (const uint8_t *)&hdr, offsetof(ts_log_header_t, crc));
+    ret = flash.write(flash.ctx, (size_t)next * TS_LOG_SEGMENT_SIZE, &hdr, sizeof(hdr));
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Segment %lu header write failed: %s", (unsigned long)next, esp_err_to_name(ret));
+        memset(&segments[next], 0, sizeof(segments[next]));
+        return ret;
+    }
+    log_stats.bytes_written += sizeof(hdr);
+
+    segments[next] = (ts_log_segment_t){ .seq = seq, .used = true };
+    active = next;
+    return ESP_OK;
+}
+
+esp_err_t ts_log_init(const ts_log_flash_t *ops)
+{
+    if (log_mutex != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    int64_t start_us = esp_timer_get_time();
+
+    if (ops != NULL) {
+        flash = *ops;
+    } else {
+        const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                               ESP_PARTITION_SUBTYPE_ANY,
+                                                               TS_LOG_PARTITION_LABEL);
+        if (part == NULL) {
+            ESP_LOGE(TAG, "Partition '%s' not found", TS_LOG_PARTITION_LABEL);
+            return ESP_ERR_NOT_FOUND;
+        }
+        flash = (ts_log_flash_t){
+            .read = partition_read,
+            .write = partition_write,
+            .erase = partition_erase,
+            .size = part->size,
+            .ctx = (void *)part,
+        };
+    }
+
+    segment_count = flash.size / TS_LOG_SEGMENT_SIZE;
+    if (segment_count < 2) {
+        ESP_LOGE(TAG, "Log area too small (%u bytes)", (unsigned)flash.size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    segments = calloc(segment_count, sizeof(ts_log_segment_t));
+    log_mutex = xSemaphoreCreateMutex();
+    if (segments == NULL || log_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Index every segment; the newest sequence number is the active one
+    for (uint32_t i = 0; i < segment_count; i++) {
+        scan_segment(i);
+        const ts_log_segment_t *s = &segments[i];
+        if (s->used && (active < 0 || s->seq > segments[active].seq)) {
+            active = i;
+        }
+        if (s->has_data && (!has_records || s->last_ms > newest_ms)) {
+            newest_ms = s->last_ms;
+            has_records = true;
+        }
+    }
+
+    // Resume log time after the newest record
+    time_base_ms = has_records ? newest_ms + 1 : 0;
+
+    log_stats.segments = segment_count;
+    log_stats.records_per_segment = TS_LOG_RECORDS_PER_SEG;
+    log_stats.mount_us = (uint32_t)(esp_timer_get_time() - start_us);
+
+    ESP_LOGI(TAG, "Mounted %lu segments in %lu us, active %ld, log time resumes at %llu ms",
+             (unsigned long)segment_count, (unsigned long)log_stats.mount_us, (long)active,
+             (unsigned long long)time_base_ms);
+    return ESP_OK;
+}
+
+uint64_t ts_log_now_ms(void)
+{
+    return time_base_ms + (uint64_t)(esp_timer_get_time() / 1000);
+}
+
+esp_err_t ts_log_append(const sensor_data_t *data)
+{
+    if (log_mutex == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    ts_log_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.t_ms = ts_log_now_ms();
+    rec.value[TS_LOG_CH_AHT22_TEMPERATURE] = lrintf(data->aht22_temperature * 100.0f);
+    rec.value[TS_LOG_CH_AHT22_HUMIDITY] = lrintf(data->aht22_humidity * 100.0f);
+    rec.value[TS_LOG_CH_BMP180_TEMPERATURE] = lrintf(data->bmp180_temperature * 100.0f);
+    rec.value[TS_LOG_CH_BMP180_PRESSURE] = lrintf(data->bmp180_pressure * 100.0f);
+    if (data->aht22_available) {
+        rec.valid |= (1u << TS_LOG_CH_AHT22_TEMPERATURE) | (1u << TS_LOG_CH_AHT22_HUMIDITY);
+    }
+    if (data->bmp180_available) {
+        rec.valid |= (1u << TS_LOG_CH_BMP180_TEMPERATURE) | (1u << TS_LOG_CH_BMP180_PRESSURE);
+    }
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    // Keep record times strictly increasing within the log
+    if (has_records && rec.t_ms <= newest_ms) {
+        rec.t_ms = newest_ms + 1;
+    }
+    rec.crc = record_crc(&rec);
+
+    if (active < 0 || segments[active].count >= TS_LOG_RECORDS_PER_SEG) {
+        ret = open_next_segment();
+    }
+    if (ret == ESP_OK) {
+        ts_log_segment_t *s = &segments[active];
+        ret = flash.write(flash.ctx, slot_offset(active, s->count), &rec, sizeof(rec));
+        // The slot is consumed even on failure, it may be partly programmed
+        s->count++;
+        if (ret == ESP_OK) {
+            if (!s->has_data) {
+                s->first_ms = rec.t_ms;
+                s->has_data = true;
+            }
+            s->last_ms = rec.t_ms;
+            newest_ms = rec.t_ms;
+            has_records = true;
+            log_stats.bytes_written += sizeof(rec);
+        }
+    }
+
+    if (ret == ESP_OK) {
+        log_stats.appends++;
+    } else {
+        log_stats.append_errors++;
+    }
+    xSemaphoreGive(log_mutex);
+    return ret;
+}
+
+size_t ts_log_read(uint64_t *cursor_ms, uint64_t to_ms, ts_log_record_t *out, size_t max)
+{
+    if (log_mutex == NULL || active < 0 || *cursor_ms > to_ms) {
+        return 0;
+    }
+
+    size_t n = 0;
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+
+    // Segments are opened round-robin, so physical order after the active
+    // segment is oldest to newest
+    for (uint32_t k = 1; k <= segment_count && n < max; k++) {
+        uint32_t seg = ((uint32_t)active + k) % segment_count;
+        const ts_log_segment_t *s = &segments[seg];
+        if (!s->has_data || s->last_ms < *cursor_ms) {
+            continue;
+        }
+        if (s->first_ms > to_ms) {
+            break;
+        }
+
+        for (uint32_t i = segment_lower_bound(seg, s->count, *cursor_ms); i < s->count && n < max; i++) {
+            ts_log_record_t rec;
+            if (!read_record(seg, i, &rec)) {
+                log_stats.crc_errors++;
+                continue;
+            }
+            // A torn slot keeps a partly programmed, too large timestamp,
+            // which can only move the binary search earlier
+            if (rec.t_ms < *cursor_ms) {
+                continue;
+            }
+            if (rec.t_ms > to_ms) {
+                break;
+            }
+            out[n++] = rec;
+        }
+    }
+    xSemaphoreGive(log_mutex);
+
+    if (n > 0) {
+        *cursor_ms = out[n - 1].t_ms + 1;
+    }
+    return n;
+}
+
+void ts_log_get_stats(ts_log_stats_t *stats)
+{
+    if (log_mutex == NULL) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+
+    xSemaphoreTake(log_mutex, portMAX_DELAY);
+    *stats = log_stats;
+    stats->segments_used = 0;
+    stats->records = 0;
+    bool have_oldest = false;
+    for (uint32_t i = 0; i < segment_count; i++) {
+        const ts_log_segment_t *s = &segments[i];
+        if (!s->used) {
+            continue;
+        }
+        stats->segments_used++;
+        stats->records += s->count;
+        if (s->has_data && (!have_oldest || s->first_ms < stats->oldest_ms)) {
+            stats->oldest_ms = s->first_ms;
+            have_oldest = true;
+        }
+    }
+    stats->newest_ms = newest_ms;
+    xSemaphoreGive(log_mutex);
+}
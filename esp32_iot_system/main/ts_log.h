@@ -0,0 +1,78 @@
+#ifndef TS_LOG_H
+#define TS_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "sensors.h"
+
+// Append-only sample log on the "tslog" data partition. The partition is
+// split into fixed-size segments, each with a header carrying a sequence
+// number, followed by CRC-protected fixed-size records. A RAM index of
+// segment time ranges lets range queries skip straight to the right
+// segments; when the log is full the oldest segment is erased and reused.
+//
+// Log time is a persisted monotonic clock in ms: at boot it resumes from
+// the newest record in the log, then advances with uptime.
+
+#define TS_LOG_PARTITION_LABEL  "tslog"
+#define TS_LOG_SEGMENT_SIZE     8192    // Multiple of the flash erase size
+
+typedef enum {
+    TS_LOG_CH_AHT22_TEMPERATURE = 0,    // 0.01 °C
+    TS_LOG_CH_AHT22_HUMIDITY,           // 0.01 %RH
+    TS_LOG_CH_BMP180_TEMPERATURE,       // 0.01 °C
+    TS_LOG_CH_BMP180_PRESSURE,          // Pa
+    TS_LOG_CH_COUNT
+} ts_log_channel_t;
+
+// On-flash record, 32 bytes. An all-0xFF slot is free.
+typedef struct {
+    uint64_t t_ms;
+    int32_t value[TS_LOG_CH_COUNT];
+    uint8_t valid;          // Bit per channel
+    uint8_t reserved[3];
+    uint32_t crc;           // CRC32 of everything above
+} ts_log_record_t;
+
+// Flash access, so the log can run on something other than the partition
+typedef struct {
+    esp_err_t (*read)(void *ctx, size_t offset, void *buf, size_t len);
+    esp_err_t (*write)(void *ctx, size_t offset, const void *buf, size_t len);
+    esp_err_t (*erase)(void *ctx, size_t offset, size_t len);
+    size_t size;
+    void *ctx;
+} ts_log_flash_t;
+
+typedef struct {
+    uint32_t segments;
+    uint32_t segments_used;
+    uint32_t records_per_segment;
+    uint32_t records;           // Records currently stored
+    uint64_t oldest_ms;         // Valid when records > 0
+    uint64_t newest_ms;
+    uint32_t appends;
+    uint32_t append_errors;
+    uint32_t segments_erased;   // Since boot
+    uint32_t crc_errors;        // Records skipped on read
+    uint64_t bytes_written;     // Including segment headers
+    uint32_t mount_us;
+} ts_log_stats_t;
+
+// Mounts the log on the given flash, or on the "tslog" partition when
+// flash is NULL. Rebuilds the segment index from the segment headers.
+esp_err_t ts_log_init(const ts_log_flash_t *flash);
+
+uint64_t ts_log_now_ms(void);
+
+esp_err_t ts_log_append(const sensor_data_t *data);
+
+// Copies up to max valid records with *cursor_ms <= t_ms <= to_ms, oldest
+// first, and advances the cursor past the last one. Returns the number of
+// records copied, 0 when done.
+size_t ts_log_read(uint64_t *cursor_ms, uint64_t to_ms, ts_log_record_t *out, size_t max);
+
+void ts_log_get_stats(ts_log_stats_t *stats);
+
+#endif
@@ -1,6 +1,12 @@
 let autoRefreshInterval = null;
 let isAutoRefreshEnabled = true;
 
+// Live updates come from /api/events; polling is only the fallback
+let eventSource = null;
+let eventRetryTimer = null;
+const POLL_INTERVAL_MS = 1000;
+const EVENT_RETRY_MS = 30000;
+
 const aht22TemperatureElement = document.getElementById('aht22-temperature');
 const aht22HumidityElement = document.getElementById('aht22-humidity');
 const aht22StatusElement = document.getElementById('aht22-status');
@@ -28,11 +34,11 @@ document.addEventListener('DOMContentLoaded', async function() {
 
 async function loadInitialThresholds() {
     try {
-        const response = await fetch('/api/relay');
+        const response = await fetch('/api/state?fields=thresholds');
         if (response.ok) {
             const data = await response.json();
-            document.getElementById('tempHigh').value = data.threshold_high;
-            document.getElementById('tempLow').value = data.threshold_low;
+            document.getElementById('tempHigh').value = data.thresholds.high;
+            document.getElementById('tempLow').value = data.thresholds.low;
         }
     } catch (error) {
         console.error('Error loading initial thresholds:', error);
@@ -58,83 +64,113 @@ function formatTimestamp() {
     return now.toLocaleTimeString(); 
 }
 
-async function fetchSensorData() {
-    try {
-        const response = await fetch('/api/sensors');
-        if (!response.ok) {
-            throw new Error(`HTTP error! status: ${response.status}`);
-        }
-        const data = await response.json();
-        
-        if (data.aht22.available) {
-            aht22TemperatureElement.textContent = data.aht22.temperature.toFixed(1);
-            aht22HumidityElement.textContent = data.aht22.humidity.toFixed(1);
-            aht22StatusElement.textContent = 'Online';
-            aht22StatusElement.className = 'sensor-value online';
-        } else {
-            aht22TemperatureElement.textContent = '--';
-            aht22HumidityElement.textContent = '--';
-            aht22StatusElement.textContent = 'Offline';
-            aht22StatusElement.className = 'sensor-value offline';
-        }
-        
-        if (data.bmp180.available) {
-            bmp180TemperatureElement.textContent = data.bmp180.temperature.toFixed(1);
-            bmp180PressureElement.textContent = data.bmp180.pressure.toFixed(1);
-            bmp180StatusElement.textContent = 'Online';
-            bmp180StatusElement.className = 'sensor-value online';
-        } else {
-            bmp180TemperatureElement.textContent = '--';
-            bmp180PressureElement.textContent = '--';
-            bmp180StatusElement.textContent = 'Offline';
-            bmp180StatusElement.className = 'sensor-value offline';
-        }
-        
-        lastUpdateElement.textContent = formatTimestamp();
-        
-        connectionStatusElement.textContent = 'Connected';
-        connectionStatusElement.className = 'status-value connected';
-        
-        return data;
-    } catch (error) {
-        console.error('Error fetching sensor data:', error);
+function setConnectionStatus(connected) {
+    connectionStatusElement.textContent = connected ? 'Connected' : 'Disconnected';
+    connectionStatusElement.className = connected ? 'status-value connected' : 'status-value disconnected';
+}
+
+function updateSensorUI(data) {
+    if (data.aht22.available) {
+        aht22TemperatureElement.textContent = data.aht22.temperature.toFixed(1);
+        aht22HumidityElement.textContent = data.aht22.humidity.toFixed(1);
+        aht22StatusElement.textContent = 'Online';
+        aht22StatusElement.className = 'sensor-value online';
+    } else {
         aht22TemperatureElement.textContent = '--';
         aht22HumidityElement.textContent = '--';
-        aht22StatusElement.textContent = 'Error';
+        aht22StatusElement.textContent = 'Offline';
+        aht22StatusElement.className = 'sensor-value offline';
+    }
+    
+    if (data.bmp180.available) {
+        bmp180TemperatureElement.textContent = data.bmp180.temperature.toFixed(1);
+        bmp180PressureElement.textContent = data.bmp180.pressure.toFixed(1);
+        bmp180StatusElement.textContent = 'Online';
+        bmp180StatusElement.className = 'sensor-value online';
+    } else {
         bmp180TemperatureElement.textContent = '--';
         bmp180PressureElement.textContent = '--';
-        bmp180StatusElement.textContent = 'Error';
-        lastUpdateElement.textContent = 'Error';
-        
-        connectionStatusElement.textContent = 'Disconnected';
-        connectionStatusElement.className = 'status-value disconnected';
-        
-        throw error;
+        bmp180StatusElement.textContent = 'Offline';
+        bmp180StatusElement.className = 'sensor-value offline';
     }
+    
+    lastUpdateElement.textContent = formatTimestamp();
 }
 
-async function fetchRelayStatus() {
+function showSensorError() {
+    aht22TemperatureElement.textContent = '--';
+    aht22HumidityElement.textContent = '--';
+    aht22StatusElement.textContent = 'Error';
+    bmp180TemperatureElement.textContent = '--';
+    bmp180PressureElement.textContent = '--';
+    bmp180StatusElement.textContent = 'Error';
+    lastUpdateElement.textContent = 'Error';
+}
+
+// ETag of the last full response per URL. While nothing changed the
+// server answers 304 without a body and the UI is left as it is.
+const stateEtags = {};
+
+// One request for everything the dashboard shows; fields narrows it down
+// (sensors, relay, thresholds). Returns null when nothing changed.
+async function fetchState(fields) {
+    const url = fields ? `/api/state?fields=${fields}` : '/api/state';
     try {
-        const response = await fetch('/api/relay');
+        const headers = {};
+        if (stateEtags[url]) {
+            headers['If-None-Match'] = stateEtags[url];
+        }
+        // Revalidation is done here, keep the browser cache out of it
+        const response = await fetch(url, { headers, cache: 'no-store' });
+        if (response.status === 304) {
+            setConnectionStatus(true);
+            return null;
+        }
         if (!response.ok) {
             throw new Error(`HTTP error! status: ${response.status}`);
         }
         const data = await response.json();
+        stateEtags[url] = response.headers.get('ETag');
         
-        // Update UI
-        updateRelayStatusUI(data.state);
-        updateRelayModeUI(data.mode);
-        updateThresholdDisplay(data.threshold_high, data.threshold_low);
+        updateStateUI(data);
+        setConnectionStatus(true);
         
         return data;
     } catch (error) {
-        console.error('Error fetching relay status:', error);
-        relayStatusElement.textContent = 'ERROR';
-        relayStatusElement.className = 'status-indicator error';
+        console.error('Error fetching state:', error);
+        // The error display replaced the data; the next answer must be a full one
+        delete stateEtags[url];
+        if (!fields || fields.includes('sensors')) {
+            showSensorError();
+        }
+        if (!fields || fields.includes('relay')) {
+            relayStatusElement.textContent = 'ERROR';
+            relayStatusElement.className = 'status-indicator error';
+        }
+        setConnectionStatus(false);
+        
         throw error;
     }
 }
 
+function fetchRelayStatus() {
+    return fetchState('relay,thresholds');
+}
+
+// Applies whichever /api/state sections are present (also the "relay" event)
+function updateStateUI(data) {
+    if (data.sensors) {
+        updateSensorUI(data.sensors);
+    }
+    if (data.relay) {
+        updateRelayStatusUI(data.relay.state);
+        updateRelayModeUI(data.relay.mode);
+    }
+    if (data.thresholds) {
+        updateThresholdDisplay(data.thresholds.high, data.thresholds.low);
+    }
+}
+
 function updateRelayStatusUI(state) {
     if (state === 1) {
         relayStatusElement.textContent = 'ON';
@@ -213,12 +249,11 @@ async function refreshData() {
         bmp180PressureElement.classList.add('loading');
         relayStatusElement.classList.add('loading');
         
-        const [sensorData, relayData] = await Promise.all([
-            fetchSensorData(),
-            fetchRelayStatus()
-        ]);
+        const data = await fetchState();
         
-        console.log('Data refreshed:', { sensorData, relayData });
+        if (data) {
+            console.log('Data refreshed:', data);
+        }
         
     } catch (error) {
         console.error('Error refreshing data:', error);
@@ -232,20 +267,78 @@ async function refreshData() {
     }
 }
 
-function startAutoRefresh() {
+function startPolling() {
+    if (autoRefreshInterval) {
+        return;
+    }
+    autoRefreshInterval = setInterval(refreshData, POLL_INTERVAL_MS);
+}
+
+function stopPolling() {
     if (autoRefreshInterval) {
         clearInterval(autoRefreshInterval);
+        autoRefreshInterval = null;
+    }
+}
+
+// Server pushes a "sensors" event per sample and a "relay" event per
+// state/config change; the browser reconnects by itself after errors
+function startEventStream() {
+    if (eventSource || !window.EventSource) {
+        return false;
     }
     
-    autoRefreshInterval = setInterval(() => {
-        if (isAutoRefreshEnabled) {
-            refreshData();
+    eventSource = new EventSource('/api/events');
+    eventSource.addEventListener('sensors', (event) => {
+        updateSensorUI(JSON.parse(event.data));
+    });
+    eventSource.addEventListener('relay', (event) => {
+        updateStateUI(JSON.parse(event.data));
+    });
+    eventSource.onopen = () => {
+        stopPolling();
+        setConnectionStatus(true);
+    };
+    eventSource.onerror = () => {
+        setConnectionStatus(false);
+        if (eventSource.readyState === EventSource.CLOSED) {
+            // Refused (e.g. too many clients): poll, try again later
+            stopEventStream();
+            startPolling();
+            eventRetryTimer = setTimeout(() => {
+                eventRetryTimer = null;
+                if (isAutoRefreshEnabled && !document.hidden) {
+                    startEventStream();
+                }
+            }, EVENT_RETRY_MS);
         }
-    }, 1000);
-    
+    };
+    return true;
+}
+
+function stopEventStream() {
+    if (eventSource) {
+        eventSource.close();
+        eventSource = null;
+    }
+}
+
+function startAutoRefresh() {
+    if (!startEventStream() && !eventSource) {
+        startPolling();
+    }
     updateAutoRefreshStatus();
 }
 
+function stopAutoRefresh() {
+    stopEventStream();
+    stopPolling();
+    if (eventRetryTimer) {
+        clearTimeout(eventRetryTimer);
+        eventRetryTimer = null;
+    }
+}
+
 function toggleAutoRefresh() {
     isAutoRefreshEnabled = !isAutoRefreshEnabled;
     updateAutoRefreshStatus();
@@ -255,10 +348,7 @@ function toggleAutoRefresh() {
         startAutoRefresh();
     } else {
         showToast('Auto-refresh disabled', 'warning');
-        if (autoRefreshInterval) {
-            clearInterval(autoRefreshInterval);
-            autoRefreshInterval = null;
-        }
+        stopAutoRefresh();
     }
 }
 
@@ -272,16 +362,12 @@ function updateAutoRefreshStatus() {
     }
 }
 
+// Hidden tabs give their event stream slot back
 document.addEventListener('visibilitychange', function() {
     if (document.hidden) {
-        if (autoRefreshInterval) {
-            clearInterval(autoRefreshInterval);
-            autoRefreshInterval = null;
-        }
-    } else {
-        if (isAutoRefreshEnabled && !autoRefreshInterval) {
-            startAutoRefresh();
-        }
+        stopAutoRefresh();
+    } else if (isAutoRefreshEnabled) {
+        startAutoRefresh();
     }
 });
 
@@ -299,29 +385,6 @@ document.addEventListener('keydown', function(event) {
     }
 });
 
-function monitorConnection() {
-    setInterval(async () => {
-        try {
-            const response = await fetch('/api/sensors', {
-                method: 'GET',
-                cache: 'no-cache'
-            });
-            
-            if (response.ok) {
-                connectionStatusElement.textContent = 'Connected';
-                connectionStatusElement.className = 'status-value connected';
-            } else {
-                throw new Error('Connection failed');
-            }
-        } catch (error) {
-            connectionStatusElement.textContent = 'Disconnected';
-            connectionStatusElement.className = 'status-value disconnected';
-        }
-    }, 30000);
-}
-
-monitorConnection();
-
 async function setRelayMode(mode) {
     try {
         const response = await fetch('/api/relay', {
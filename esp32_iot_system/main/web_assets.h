@@ -0,0 +1,26 @@
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Web UI files, minified and gzipped at build time by tools/pack_web.py
+// (the table itself is generated into the build directory). The ETag is
+// a hash of the compressed bytes. The HTML references the other assets
+// by "name?v=<hash>", so those never change under a given URL and can be
+// cached as immutable.
+typedef struct {
+    const char *uri;
+    const char *content_type;
+    const uint8_t *data;        // gzip
+    size_t size;
+    size_t raw_size;            // Before minification and compression
+    const char *etag;           // Quoted
+    bool immutable;
+} web_asset_t;
+
+extern const web_asset_t web_assets[];
+extern const size_t web_assets_count;
+
+#endif
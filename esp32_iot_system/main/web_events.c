@@ -0,0 +1,266 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "web_events.h"
+#include "web_sockets.h"
+#include "sensor_snapshot.h"
+#include "app_config.h"
+
+static const char *TAG = "WEB_EVENTS";
+
+#define EVENTS_TASK_STACK   3072
+#define EVENTS_TASK_PRIO    3
+
+// Notification bits for the event task
+#define EVT_SAMPLE  (1u << 0)
+#define EVT_RELAY   (1u << 1)
+
+static TaskHandle_t events_task;
+static web_events_sensors_fn_t sensors_fn;
+static web_events_relay_fn_t relay_fn;
+
+// Async request per client. Added by the HTTP task, removed (and completed)
+// only by the event task.
+static httpd_req_t *clients[WEB_EVENTS_MAX_CLIENTS];
+static SemaphoreHandle_t clients_mutex;
+
+static web_events_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_hist_t encode_hist;
+
+// Event header, the JSON object written by the route's writer straight
+// into buf, then the blank line. Returns the length, or 0 if it did not fit.
+static int format_event(char *buf, size_t size, const char *header, const sensor_snapshot_t *snap)
+{
+    size_t head = strlen(header);
+    if (head + 2 >= size) {
+        return 0;
+    }
+    memcpy(buf, header, head);
+
+    json_writer_t w;
+    json_writer_init(&w, buf + head, size - head - 2, NULL, NULL);
+    json_obj_begin(&w, NULL);
+    if (snap != NULL) {
+        sensors_fn(&w, snap);
+    } else {
+        relay_fn(&w);
+    }
+    json_obj_end(&w);
+    if (json_writer_finish(&w) != ESP_OK) {
+        return 0;
+    }
+    memcpy(buf + head + w.len, "\n\n", 2);
+    return (int)(head + w.len + 2);
+}
+
+static int format_sensors(char *buf, size_t size)
+{
+    sensor_snapshot_t snap;
+    if (!sensor_snapshot_read(&snap)) {
+        return 0;
+    }
+    char header[40];
+    snprintf(header, sizeof(header), "id: %lu\nevent: sensors\ndata: ", (unsigned long)snap.seq);
+    return format_event(buf, size, header, &snap);
+}
+
+static int format_relay(char *buf, size_t size)
+{
+    return format_event(buf, size, "event: relay\ndata: ", NULL);
+}
+
+// Writes one payload to every client, dropping those that fail
+static void broadcast(const char *buf, int len)
+{
+    httpd_req_t *targets[WEB_EVENTS_MAX_CLIENTS];
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    memcpy(targets, clients, sizeof(targets));
+    xSemaphoreGive(clients_mutex);
+
+    // Sends happen outside the lock so a slow client cannot stall new connections
+    uint32_t sent = 0, failed = 0;
+    for (int i = 0; i < WEB_EVENTS_MAX_CLIENTS; i++) {
+        if (targets[i] == NULL) {
+            continue;
+        }
+        if (httpd_resp_send_chunk(targets[i], buf, len) == ESP_OK) {
+            web_sockets_touch(targets[i]->handle, httpd_req_to_sockfd(targets[i]));
+            sent++;
+            continue;
+        }
+
+        xSemaphoreTake(clients_mutex, portMAX_DELAY);
+        clients[i] = NULL;
+        xSemaphoreGive(clients_mutex);
+        httpd_req_async_handler_complete(targets[i]);
+        web_sockets_release(WEB_SOCKET_EVENTS);
+        failed++;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.events++;
+    stats.deliveries += sent;
+    stats.bytes_sent += (uint64_t)sent * len;
+    stats.send_errors += failed;
+    stats.clients -= failed;
+    portEXIT_CRITICAL(&stats_lock);
+
+    if (failed > 0) {
+        ESP_LOGI(TAG, "%lu event client(s) disconnected", (unsigned long)failed);
+    }
+}
+
+static void web_events_task(void *pvParameters)
+{
+    static char payload[WEB_EVENTS_PAYLOAD_MAX];
+
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(WEB_EVENTS_KEEPALIVE_MS));
+
+        uint32_t clients_now;
+        portENTER_CRITICAL(&stats_lock);
+        clients_now = stats.clients;
+        portEXIT_CRITICAL(&stats_lock);
+        if (clients_now == 0) {
+            continue;
+        }
+
+        if (bits == 0) {
+            broadcast(": ping\n\n", 8);
+            continue;
+        }
+        int len;
+        if (bits & EVT_SAMPLE) {
+            int64_t start_us = esp_timer_get_time();
+            len = format_sensors(payload, sizeof(payload));
+            latency_hist_record(&encode_hist, (uint32_t)(esp_timer_get_time() - start_us));
+            if (len > 0) {
+                portENTER_CRITICAL(&stats_lock);
+                stats.sensors_bytes = len;
+                portEXIT_CRITICAL(&stats_lock);
+                broadcast(payload, len);
+            }
+        }
+        if ((bits & EVT_RELAY) && (len = format_relay(payload, sizeof(payload))) > 0) {
+            broadcast(payload, len);
+        }
+    }
+}
+
+// Runs with the config write lock held: only wake the event task
+static void on_config_changed(const app_config_t *config, uint32_t changed, void *arg)
+{
+    if ((changed & (APP_CONFIG_RELAY_STATE | APP_CONFIG_AUTO_MODE | APP_CONFIG_THRESHOLDS)) &&
+        events_task != NULL) {
+        xTaskNotify(events_task, EVT_RELAY, eSetBits);
+    }
+}
+
+esp_err_t web_events_init(web_events_sensors_fn_t sensors, web_events_relay_fn_t relay)
+{
+    if (clients_mutex != NULL || sensors == NULL || relay == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sensors_fn = sensors;
+    relay_fn = relay;
+    clients_mutex = xSemaphoreCreateMutex();
+    if (clients_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    latency_hist_init(&encode_hist);
+    if (xTaskCreate(web_events_task, "web_events", EVENTS_TASK_STACK, NULL,
+                    EVENTS_TASK_PRIO, &events_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_config_subscribe(on_config_changed, NULL);
+}
+
+void web_events_notify_sample(void)
+{
+    if (events_task != NULL) {
+        xTaskNotify(events_task, EVT_SAMPLE, eSetBits);
+    }
+}
+
+esp_err_t web_events_handler(httpd_req_t *req)
+{
+    if (clients_mutex == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Events not initialized");
+        return ESP_FAIL;
+    }
+
+    int slot = -1;
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    for (int i = 0; i < WEB_EVENTS_MAX_CLIENTS; i++) {
+        if (clients[i] == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(clients_mutex);
+
+    // A free slot is not enough: the socket must also fit the shared budget
+    if (slot < 0 || !web_sockets_acquire(WEB_SOCKET_EVENTS)) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.rejected++;
+        portEXIT_CRITICAL(&stats_lock);
+        // Clients fall back to polling
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_send(req, "Too many event clients", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+
+    // Current state first, so the page does not wait for the next change
+    char buf[WEB_EVENTS_PAYLOAD_MAX];
+    int len = snprintf(buf, sizeof(buf), "retry: %d\n\n", WEB_EVENTS_RETRY_MS);
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK ||
+        ((len = format_relay(buf, sizeof(buf))) > 0 && httpd_resp_send_chunk(req, buf, len) != ESP_OK) ||
+        ((len = format_sensors(buf, sizeof(buf))) > 0 && httpd_resp_send_chunk(req, buf, len) != ESP_OK)) {
+        web_sockets_release(WEB_SOCKET_EVENTS);
+        return ESP_FAIL;
+    }
+
+    // Keep the connection open past this handler
+    httpd_req_t *async_req;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach event client: %s", esp_err_to_name(err));
+        web_sockets_release(WEB_SOCKET_EVENTS);
+        return err;
+    }
+
+    // Only this (HTTP server) task adds clients, so the slot is still free
+    portENTER_CRITICAL(&stats_lock);
+    stats.clients++;
+    stats.connects++;
+    portEXIT_CRITICAL(&stats_lock);
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    clients[slot] = async_req;
+    xSemaphoreGive(clients_mutex);
+
+    ESP_LOGI(TAG, "Event client connected (slot %d)", slot);
+    return ESP_OK;
+}
+
+void web_events_get_stats(web_events_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void web_events_get_encode_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&encode_hist, out);
+}
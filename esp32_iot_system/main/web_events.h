@@ -0,0 +1,55 @@
+#ifndef WEB_EVENTS_H
+#define WEB_EVENTS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "latency_hist.h"
+#include "json_writer.h"
+#include "sensor_snapshot.h"
+
+// Server-Sent Events for the dashboard (GET /api/events). Connected
+// clients are kept as async requests; a single task formats each event
+// once and writes the same bytes to every client:
+//   event: sensors   new sample published (same fields as /api/sensors)
+//   event: relay     relay state, mode or thresholds changed (same
+//                    fields as /api/state?fields=relay,thresholds)
+// A comment line is sent when idle so dead clients are noticed.
+
+#define WEB_EVENTS_MAX_CLIENTS      4       // Also bounded by the web_sockets.h budget
+#define WEB_EVENTS_KEEPALIVE_MS     15000
+#define WEB_EVENTS_RETRY_MS         3000    // Browser reconnect delay
+#define WEB_EVENTS_PAYLOAD_MAX      512
+
+// Write the fields of an event's JSON object, which the caller opens and
+// closes; run on the event task, and on the HTTP task for the state sent
+// to a new client
+typedef void (*web_events_sensors_fn_t)(json_writer_t *w, const sensor_snapshot_t *snap);
+typedef void (*web_events_relay_fn_t)(json_writer_t *w);
+
+typedef struct {
+    uint32_t clients;
+    uint32_t connects;
+    uint32_t rejected;          // Over WEB_EVENTS_MAX_CLIENTS or the socket budget
+    uint32_t events;            // Payloads formatted
+    uint32_t deliveries;        // Payload writes to clients
+    uint32_t send_errors;       // Clients dropped
+    uint64_t bytes_sent;
+    uint32_t sensors_bytes;     // Size of the last "sensors" event
+} web_events_stats_t;
+
+// Starts the event task and subscribes to configuration changes
+esp_err_t web_events_init(web_events_sensors_fn_t sensors, web_events_relay_fn_t relay);
+
+// URI handler for /api/events
+esp_err_t web_events_handler(httpd_req_t *req);
+
+// Call after a new sample has been published to sensor_snapshot
+void web_events_notify_sample(void);
+
+void web_events_get_stats(web_events_stats_t *stats);
+
+// Time to format one "sensors" event
+void web_events_get_encode_hist(latency_hist_t *out);
+
+#endif
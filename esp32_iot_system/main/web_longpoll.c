@@ -0,0 +1,254 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "web_longpoll.h"
+#include "web_sockets.h"
+#include "http_stream.h"
+#include "sensor_snapshot.h"
+#include "app_config.h"
+
+static const char *TAG = "WEB_LONGPOLL";
+
+#define LONGPOLL_TASK_STACK 4096
+#define LONGPOLL_TASK_PRIO  3
+
+// Notification bits for the long-poll task
+#define EVT_CHANGE  (1u << 0)   // New sample or config change
+#define EVT_PARKED  (1u << 1)   // New request, recompute the next deadline
+
+typedef struct {
+    httpd_req_t *req;           // Async copy, NULL = free slot
+    uint32_t since_seq;
+    uint32_t config_version;
+    int64_t parked_us;
+    int64_t deadline_us;
+} parked_req_t;
+
+static TaskHandle_t longpoll_task;
+static web_longpoll_body_fn_t body_fn;
+
+// Added by the HTTP task, removed (and completed) only by the long-poll task
+static parked_req_t parked[WEB_LONGPOLL_MAX_CLIENTS];
+static SemaphoreHandle_t parked_mutex;
+
+static web_longpoll_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_hist_t wait_hist;
+
+static bool has_changed(uint32_t since_seq, uint32_t config_version)
+{
+    // != rather than >: after a reboot the sequence starts over
+    return sensor_snapshot_seq() != since_seq || app_config_version() != config_version;
+}
+
+static esp_err_t send_body(httpd_req_t *req)
+{
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    body_fn(w);
+    return http_stream_end(&stream);
+}
+
+static esp_err_t send_no_change(httpd_req_t *req)
+{
+    httpd_resp_set_status(req, "204 No Content");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    return httpd_resp_send(req, NULL, 0);
+}
+
+// Answers every parked request that has something new or has expired;
+// returns the ticks until the next deadline (portMAX_DELAY if none)
+static TickType_t service_parked(void)
+{
+    parked_req_t slots[WEB_LONGPOLL_MAX_CLIENTS];
+    xSemaphoreTake(parked_mutex, portMAX_DELAY);
+    memcpy(slots, parked, sizeof(slots));
+    xSemaphoreGive(parked_mutex);
+
+    // Sends happen outside the lock so a slow client cannot stall new requests
+    int64_t now_us = esp_timer_get_time();
+    int64_t next_us = INT64_MAX;
+    for (int i = 0; i < WEB_LONGPOLL_MAX_CLIENTS; i++) {
+        parked_req_t *p = &slots[i];
+        if (p->req == NULL) {
+            continue;
+        }
+        bool changed = has_changed(p->since_seq, p->config_version);
+        if (!changed && now_us < p->deadline_us) {
+            // Still waiting: keep it out of reach of LRU purging
+            web_sockets_touch(p->req->handle, httpd_req_to_sockfd(p->req));
+            if (p->deadline_us < next_us) {
+                next_us = p->deadline_us;
+            }
+            continue;
+        }
+
+        esp_err_t err = changed ? send_body(p->req) : send_no_change(p->req);
+        latency_hist_record(&wait_hist, (uint32_t)(esp_timer_get_time() - p->parked_us));
+
+        xSemaphoreTake(parked_mutex, portMAX_DELAY);
+        parked[i].req = NULL;
+        xSemaphoreGive(parked_mutex);
+        httpd_req_async_handler_complete(p->req);
+        web_sockets_release(WEB_SOCKET_LONGPOLL);
+
+        portENTER_CRITICAL(&stats_lock);
+        stats.parked--;
+        if (changed) {
+            stats.changed++;
+        } else {
+            stats.timeouts++;
+        }
+        if (err != ESP_OK) {
+            stats.send_errors++;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+
+    if (next_us == INT64_MAX) {
+        return portMAX_DELAY;
+    }
+    if (next_us - now_us > (int64_t)WEB_LONGPOLL_LRU_REFRESH_MS * 1000) {
+        return pdMS_TO_TICKS(WEB_LONGPOLL_LRU_REFRESH_MS);
+    }
+    // Round up so the request has expired when the task wakes
+    return pdMS_TO_TICKS((next_us - now_us + 999) / 1000) + 1;
+}
+
+static void web_longpoll_task(void *pvParameters)
+{
+    TickType_t wait = portMAX_DELAY;
+    while (1) {
+        xTaskNotifyWait(0, UINT32_MAX, NULL, wait);
+        wait = service_parked();
+    }
+}
+
+// Runs with the config write lock held: only wake the long-poll task
+static void on_config_changed(const app_config_t *config, uint32_t changed, void *arg)
+{
+    if (longpoll_task != NULL) {
+        xTaskNotify(longpoll_task, EVT_CHANGE, eSetBits);
+    }
+}
+
+esp_err_t web_longpoll_init(web_longpoll_body_fn_t body)
+{
+    if (parked_mutex != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    parked_mutex = xSemaphoreCreateMutex();
+    if (parked_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    body_fn = body;
+    latency_hist_init(&wait_hist);
+    if (xTaskCreate(web_longpoll_task, "web_longpoll", LONGPOLL_TASK_STACK, NULL,
+                    LONGPOLL_TASK_PRIO, &longpoll_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return app_config_subscribe(on_config_changed, NULL);
+}
+
+void web_longpoll_notify_sample(void)
+{
+    if (longpoll_task != NULL) {
+        xTaskNotify(longpoll_task, EVT_CHANGE, eSetBits);
+    }
+}
+
+esp_err_t web_longpoll_handler(httpd_req_t *req, uint32_t since_seq, uint32_t config_version,
+                               uint32_t timeout_ms)
+{
+    if (parked_mutex == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Long poll not initialized");
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.requests++;
+    portEXIT_CRITICAL(&stats_lock);
+
+    // Already something new: answer right here
+    bool changed = has_changed(since_seq, config_version);
+    if (changed || timeout_ms == 0) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.immediate++;
+        portEXIT_CRITICAL(&stats_lock);
+        return changed ? send_body(req) : send_no_change(req);
+    }
+
+    int slot = -1;
+    xSemaphoreTake(parked_mutex, portMAX_DELAY);
+    for (int i = 0; i < WEB_LONGPOLL_MAX_CLIENTS; i++) {
+        if (parked[i].req == NULL) {
+            slot = i;
+            break;
+        }
+    }
+    xSemaphoreGive(parked_mutex);
+
+    // A free slot is not enough: the socket must also fit the shared budget
+    if (slot < 0 || !web_sockets_acquire(WEB_SOCKET_LONGPOLL)) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.rejected++;
+        portEXIT_CRITICAL(&stats_lock);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_send(req, "Too many long-poll clients", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    httpd_req_t *async_req;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to park request: %s", esp_err_to_name(err));
+        web_sockets_release(WEB_SOCKET_LONGPOLL);
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to park request");
+        return ESP_FAIL;
+    }
+
+    if (timeout_ms > WEB_LONGPOLL_TIMEOUT_MAX_MS) {
+        timeout_ms = WEB_LONGPOLL_TIMEOUT_MAX_MS;
+    }
+    int64_t now_us = esp_timer_get_time();
+
+    // Only this (HTTP server) task adds requests, so the slot is still free
+    portENTER_CRITICAL(&stats_lock);
+    stats.parked++;
+    if (stats.parked > stats.max_parked) {
+        stats.max_parked = stats.parked;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    xSemaphoreTake(parked_mutex, portMAX_DELAY);
+    parked[slot] = (parked_req_t) {
+        .req = async_req,
+        .since_seq = since_seq,
+        .config_version = config_version,
+        .parked_us = now_us,
+        .deadline_us = now_us + (int64_t)timeout_ms * 1000,
+    };
+    xSemaphoreGive(parked_mutex);
+
+    // Also catches a change that happened since the check above
+    xTaskNotify(longpoll_task, EVT_PARKED, eSetBits);
+    return ESP_OK;
+}
+
+void web_longpoll_get_stats(web_longpoll_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void web_longpoll_get_wait_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&wait_hist, out);
+}
@@ -0,0 +1,55 @@
+#ifndef WEB_LONGPOLL_H
+#define WEB_LONGPOLL_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "json_writer.h"
+#include "latency_hist.h"
+
+// Long polling for clients that cannot hold an event stream or WebSocket
+// open: GET /api/sensors?since=<seq>[&config=<version>][&timeout=<ms>].
+// If the latest sample is not `since` and the config version is still
+// `config` (default: the current one), the request is detached with
+// httpd_req_async_handler_begin() and parked; the HTTP server moves on.
+// A single task answers parked requests as soon as a new sample or config
+// change arrives, or with 204 once their timeout expires. Nothing runs
+// while requests are parked and nothing changes.
+
+#define WEB_LONGPOLL_MAX_CLIENTS            4   // Each holds a socket, see web_sockets.h
+#define WEB_LONGPOLL_TIMEOUT_DEFAULT_MS     30000
+#define WEB_LONGPOLL_TIMEOUT_MAX_MS         60000
+#define WEB_LONGPOLL_LRU_REFRESH_MS         5000    // Parked sessions marked used at least this often
+
+// Writes the response body (one JSON object); runs on the long-poll task
+// for parked requests and on the HTTP task for immediate answers
+typedef void (*web_longpoll_body_fn_t)(json_writer_t *w);
+
+typedef struct {
+    uint32_t parked;            // Currently waiting
+    uint32_t max_parked;
+    uint32_t requests;
+    uint32_t immediate;         // Answered without parking
+    uint32_t changed;           // Parked, answered on a new sample / config change
+    uint32_t timeouts;          // Parked, answered with 204
+    uint32_t rejected;          // Over WEB_LONGPOLL_MAX_CLIENTS or the socket budget
+    uint32_t send_errors;
+} web_longpoll_stats_t;
+
+// Starts the long-poll task and subscribes to configuration changes
+esp_err_t web_longpoll_init(web_longpoll_body_fn_t body);
+
+// Called by the /api/sensors handler when the query has `since`;
+// timeout_ms is clamped to WEB_LONGPOLL_TIMEOUT_MAX_MS
+esp_err_t web_longpoll_handler(httpd_req_t *req, uint32_t since_seq, uint32_t config_version,
+                               uint32_t timeout_ms);
+
+// Call after a new sample has been published to sensor_snapshot
+void web_longpoll_notify_sample(void);
+
+void web_longpoll_get_stats(web_longpoll_stats_t *stats);
+
+// Time parked requests waited before being answered
+void web_longpoll_get_wait_hist(latency_hist_t *out);
+
+#endif
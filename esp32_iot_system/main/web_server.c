@@ -1,18 +1,37 @@
 #include <string.h>
+#include <stdlib.h>
 #include <math.h>
+#include <unistd.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "esp_http_server.h"
 #include "cJSON.h"
 
 #include "web_server.h"
 #include "sensors.h"
+#include "sensor_snapshot.h"
+#include "sensor_acq.h"
 #include "relay_control.h"
+#include "app_config.h"
+#include "i2c_bus.h"
+#include "alloc_counter.h"
+#include "sensor_history.h"
+#include "ts_log.h"
 #include "nvs_storage.h"
+#include "web_assets.h"
+#include "web_events.h"
+#include "web_ws.h"
+#include "web_longpoll.h"
+#include "web_workers.h"
+#include "web_sockets.h"
+#include "json_writer.h"
+#include "http_stream.h"
 
 #ifndef MIN
 #define MIN(a, b) ((a) < (b) ? (a) : (b))
@@ -21,131 +40,353 @@
 static const char *TAG = "WEB_SERVER";
 static httpd_handle_t server = NULL;
 
-// External declarations for embedded files
-extern const uint8_t index_html_start[] asm("_binary_index_html_start");
-extern const uint8_t index_html_end[]   asm("_binary_index_html_end");
-extern const uint8_t style_css_start[] asm("_binary_style_css_start");
-extern const uint8_t style_css_end[]   asm("_binary_style_css_end");
-extern const uint8_t script_js_start[] asm("_binary_script_js_start");
-extern const uint8_t script_js_end[]   asm("_binary_script_js_end");
+// JSON build + print cost of /api/sensors, for comparison with the
+// event stream and WebSocket encodings
+static latency_hist_t sensors_json_hist;
+static volatile uint32_t sensors_json_bytes;
 
-// HTTP GET handler for root
-static esp_err_t root_get_handler(httpd_req_t *req)
+#define STATIC_CACHE_IMMUTABLE  "public, max-age=31536000, immutable"
+#define STATIC_CACHE_REVALIDATE "no-cache"
+#define IF_NONE_MATCH_MAX       128
+
+// True if the request's If-None-Match lists the given (quoted) ETag or "*"
+static bool etag_matches(httpd_req_t *req, const char *etag)
 {
-    const size_t index_html_size = (index_html_end - index_html_start);
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)index_html_start, index_html_size);
-    return ESP_OK;
+    char value[IF_NONE_MATCH_MAX];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+    return strstr(value, etag) != NULL || strcmp(value, "*") == 0;
 }
 
-// HTTP GET handler for CSS
-static esp_err_t style_get_handler(httpd_req_t *req)
+// Query parameter as an unsigned number, def when missing
+static uint64_t query_u64(const char *query, const char *key, uint64_t def)
 {
-    const size_t style_css_size = (style_css_end - style_css_start);
-    httpd_resp_set_type(req, "text/css");
-    httpd_resp_send(req, (const char *)style_css_start, style_css_size);
-    return ESP_OK;
+    char value[24];
+    if (query == NULL || httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return def;
+    }
+    return strtoull(value, NULL, 10);
 }
 
-// HTTP GET handler for JavaScript
-static esp_err_t script_get_handler(httpd_req_t *req)
+// HTTP GET handler for the web UI files (user_ctx = web_asset_t).
+// Always sent gzipped; every browser accepts it and the device keeps no
+// uncompressed copy.
+static esp_err_t static_get_handler(httpd_req_t *req)
 {
-    const size_t script_js_size = (script_js_end - script_js_start);
-    httpd_resp_set_type(req, "application/javascript");
-    httpd_resp_send(req, (const char *)script_js_start, script_js_size);
+    const web_asset_t *asset = req->user_ctx;
+    
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control",
+                       asset->immutable ? STATIC_CACHE_IMMUTABLE : STATIC_CACHE_REVALIDATE);
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    
+    if (etag_matches(req, asset->etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+    
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_send(req, (const char *)asset->data, asset->size);
     return ESP_OK;
 }
 
-// HTTP GET handler for sensor data API
-static esp_err_t api_sensors_get_handler(httpd_req_t *req)
+// Conditional GET for the polled JSON endpoints. ETags are built from the
+// sample sequence number and/or config version, behind a per-boot id so a
+// tag cached before a reboot never matches the restarted counters.
+typedef enum {
+    COND_SENSORS,
+    COND_RELAY,
+    COND_STATE,
+    COND_COUNT
+} cond_route_t;
+
+static const char *const cond_route_names[COND_COUNT] = { "sensors", "relay", "state" };
+
+static uint32_t etag_boot_id;
+static portMUX_TYPE cond_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t cond_full[COND_COUNT];          // 200 with a body
+static uint32_t cond_not_modified[COND_COUNT];  // 304
+
+// Sets the ETag and answers with a bodyless 304 when If-None-Match has it.
+// Returns true if the response has been sent.
+static bool send_if_not_modified(httpd_req_t *req, cond_route_t route, const char *etag)
+{
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    bool match = etag_matches(req, etag);
+    
+    portENTER_CRITICAL(&cond_lock);
+    if (match) {
+        cond_not_modified[route]++;
+    } else {
+        cond_full[route]++;
+    }
+    portEXIT_CRITICAL(&cond_lock);
+    
+    if (!match) {
+        return false;
+    }
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_status(req, "304 Not Modified");
+    httpd_resp_send(req, NULL, 0);
+    return true;
+}
+
+// Latest sample (or defaults before the first one, snap->seq == 0) as
+// /api/sensors fields
+static void write_sensors(json_writer_t *w, const sensor_snapshot_t *snap)
 {
     sensor_data_t data;
-    esp_err_t ret = get_sensor_data(&data);
     
-    if (ret != ESP_OK) {
-        // Return default values if sensor read fails
+    if (snap->seq != 0) {
+        data = snap->data;
+    } else {
+        // No sample published yet, return default values
         data.aht22_temperature = 25.0;
         data.aht22_humidity = 50.0;
         data.aht22_available = false;
         data.bmp180_temperature = 25.0;
         data.bmp180_pressure = 1013.25;
         data.bmp180_available = false;
+        data.bmp180_oss = bmp180_get_oss();
         data.timestamp = xTaskGetTickCount() * portTICK_PERIOD_MS;
     }
     
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
-        return ESP_FAIL;
-    }
-    
     // AHT22 sensor data
-    cJSON *aht22 = cJSON_CreateObject();
-    cJSON_AddNumberToObject(aht22, "temperature", data.aht22_temperature);
-    cJSON_AddNumberToObject(aht22, "humidity", data.aht22_humidity);
-    cJSON_AddBoolToObject(aht22, "available", data.aht22_available);
-    cJSON_AddItemToObject(json, "aht22", aht22);
+    json_obj_begin(w, "aht22");
+    json_number(w, "temperature", data.aht22_temperature, JSON_NUM_AUTO);
+    json_number(w, "humidity", data.aht22_humidity, JSON_NUM_AUTO);
+    json_bool(w, "available", data.aht22_available);
+    json_obj_end(w);
     
     // BMP180 sensor data
-    cJSON *bmp180 = cJSON_CreateObject();
-    cJSON_AddNumberToObject(bmp180, "temperature", data.bmp180_temperature);
-    cJSON_AddNumberToObject(bmp180, "pressure", data.bmp180_pressure);
-    cJSON_AddBoolToObject(bmp180, "available", data.bmp180_available);
-    cJSON_AddItemToObject(json, "bmp180", bmp180);
+    json_obj_begin(w, "bmp180");
+    json_number(w, "temperature", data.bmp180_temperature, JSON_NUM_AUTO);
+    json_number(w, "pressure", data.bmp180_pressure, JSON_NUM_AUTO);
+    json_bool(w, "available", data.bmp180_available);
+    json_uint(w, "oss", data.bmp180_oss);
+    json_obj_end(w);
     
-    cJSON_AddNumberToObject(json, "timestamp", data.timestamp);
+    json_uint(w, "timestamp", data.timestamp);
+    json_uint(w, "sequence", snap->seq);
+    json_uint(w, "age_ms", sensor_snapshot_age_ms(snap));
+}
+
+// HTTP GET handler for sensor data API.
+// Serves the last sample published by the sensor task; never touches the I2C bus.
+// With ?fresh=1[&max_age=ms] a sample older than max_age is not good
+// enough: the handler waits for a new one, sharing the acquisition with
+// any other caller doing the same. With ?since=<seq> the request is a
+// long poll (see web_longpoll.h). The ETag changes with each new sample.
+static esp_err_t api_sensors_get_handler(httpd_req_t *req)
+{
+    char query[80];
+    const char *q = NULL;
+    char value[12];
+    if (httpd_req_get_url_query_len(req) < sizeof(query) &&
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        q = query;
+    }
     
-    char *json_string = cJSON_Print(json);
-    if (json_string == NULL) {
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
-        return ESP_FAIL;
+    if (q != NULL && httpd_query_key_value(q, "since", value, sizeof(value)) == ESP_OK) {
+        return web_longpoll_handler(req, (uint32_t)strtoul(value, NULL, 10),
+                                    (uint32_t)query_u64(q, "config", app_config_version()),
+                                    (uint32_t)query_u64(q, "timeout", WEB_LONGPOLL_TIMEOUT_DEFAULT_MS));
     }
     
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, json_string, HTTPD_RESP_USE_STRLEN);
+    sensor_snapshot_t snap;
+    if (query_u64(q, "fresh", 0) != 0) {
+        // May block for a sensor cycle: not on the server task
+        if (!web_workers_in_worker()) {
+            return web_workers_offload(req, api_sensors_get_handler);
+        }
+        uint32_t max_age_ms = (uint32_t)query_u64(q, "max_age", SENSOR_ACQ_FRESH_MAX_AGE_DEFAULT_MS);
+        if (sensor_acq_read_fresh(max_age_ms, SENSOR_ACQ_FRESH_TIMEOUT_MS, &snap) != ESP_OK) {
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+            httpd_resp_set_hdr(req, "Retry-After", "1");
+            httpd_resp_send(req, "No fresh sample available", HTTPD_RESP_USE_STRLEN);
+            return ESP_OK;
+        }
+    } else {
+        sensor_snapshot_read(&snap);
+    }
     
-    free(json_string);
-    cJSON_Delete(json);
-    return ESP_OK;
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)etag_boot_id, (unsigned long)snap.seq);
+    if (send_if_not_modified(req, COND_SENSORS, etag)) {
+        return ESP_OK;
+    }
+    
+    int64_t start_us = esp_timer_get_time();
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    write_sensors(w, &snap);
+    json_obj_end(w);
+    
+    latency_hist_record(&sensors_json_hist, (uint32_t)(esp_timer_get_time() - start_us));
+    sensors_json_bytes = w->total;
+    
+    return http_stream_end(&stream);
 }
 
-// HTTP GET handler for relay status API
-static esp_err_t api_relay_get_handler(httpd_req_t *req)
+// Long-poll answer: /api/sensors fields plus the relay and config version,
+// so the client has both values for its next ?since=&config=
+static void write_longpoll_body(json_writer_t *w)
 {
-    uint8_t relay_state = get_relay_state();
-    relay_mode_t relay_mode = get_relay_mode();
+    sensor_snapshot_t snap;
+    sensor_snapshot_read(&snap);
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
     
-    // Load thresholds for display
-    float temp_high = 30.0, temp_low = 20.0;  // Default values
-    storage_load_temp_thresholds(&temp_high, &temp_low);
+    json_obj_begin(w, NULL);
+    write_sensors(w, &snap);
+    json_obj_begin(w, "relay");
+    json_uint(w, "state", config.relay_state);
+    json_uint(w, "mode", config.auto_mode);
+    json_obj_end(w);
+    json_uint(w, "config_version", version);
+    json_obj_end(w);
+}
+
+// Sections of /api/state, selectable with ?fields=a,b
+#define STATE_SENSORS       (1u << 0)
+#define STATE_RELAY         (1u << 1)
+#define STATE_THRESHOLDS    (1u << 2)
+#define STATE_ALL           0x07u
+
+static const char *const state_field_names[] = { "sensors", "relay", "thresholds" };
+
+// Parses a comma-separated field list; returns 0 on an unknown name
+static uint32_t parse_state_fields(const char *list)
+{
+    uint32_t mask = 0;
+    while (*list != '\0') {
+        size_t len = strcspn(list, ",");
+        uint32_t bit = 0;
+        for (size_t i = 0; i < sizeof(state_field_names) / sizeof(state_field_names[0]); i++) {
+            if (strlen(state_field_names[i]) == len && strncmp(list, state_field_names[i], len) == 0) {
+                bit = 1u << i;
+                break;
+            }
+        }
+        if (bit == 0) {
+            return 0;
+        }
+        mask |= bit;
+        list += len;
+        if (*list == ',') {
+            list++;
+        }
+    }
+    return mask;
+}
+
+// /api/state relay and thresholds sections, with the version they belong to
+static void write_config_state(json_writer_t *w, uint32_t fields, const app_config_t *config, uint32_t version)
+{
+    if (fields & STATE_RELAY) {
+        json_obj_begin(w, "relay");
+        json_uint(w, "state", config->relay_state);
+        json_uint(w, "mode", config->auto_mode);
+        json_obj_end(w);
+    }
+    if (fields & STATE_THRESHOLDS) {
+        json_obj_begin(w, "thresholds");
+        json_number(w, "high", config->temp_high, JSON_NUM_AUTO);
+        json_number(w, "low", config->temp_low, JSON_NUM_AUTO);
+        json_obj_end(w);
+    }
+    if (fields & (STATE_RELAY | STATE_THRESHOLDS)) {
+        json_uint(w, "config_version", version);
+    }
+}
+
+// "relay" event: the same fields as /api/state?fields=relay,thresholds
+static void write_relay_event(json_writer_t *w)
+{
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
+    write_config_state(w, STATE_RELAY | STATE_THRESHOLDS, &config, version);
+}
+
+// HTTP GET handler for the combined dashboard state: /api/state?fields=
+// (sensors, relay, thresholds; all by default) in one response
+static esp_err_t api_state_get_handler(httpd_req_t *req)
+{
+    uint32_t fields = STATE_ALL;
+    char query[64];
+    char value[48];
+    if (httpd_req_get_url_query_len(req) < sizeof(query) &&
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "fields", value, sizeof(value)) == ESP_OK) {
+        fields = parse_state_fields(value);
+        if (fields == 0) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "fields: sensors, relay, thresholds");
+            return ESP_FAIL;
+        }
+    }
     
-    cJSON *json = cJSON_CreateObject();
-    if (json == NULL) {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
-        return ESP_FAIL;
+    // RAM copies only: snapshot and config store
+    sensor_snapshot_t snap;
+    sensor_snapshot_read(&snap);
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
+    
+    // Only the parts that were asked for go into the ETag
+    char etag[40];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu-%lu\"", (unsigned long)etag_boot_id,
+             (unsigned long)((fields & STATE_SENSORS) ? snap.seq : 0),
+             (unsigned long)((fields & (STATE_RELAY | STATE_THRESHOLDS)) ? version : 0));
+    if (send_if_not_modified(req, COND_STATE, etag)) {
+        return ESP_OK;
     }
     
-    cJSON_AddNumberToObject(json, "state", relay_state);
-    cJSON_AddNumberToObject(json, "mode", relay_mode);
-    cJSON_AddNumberToObject(json, "threshold_high", temp_high);
-    cJSON_AddNumberToObject(json, "threshold_low", temp_low);
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
     
-    char *json_string = cJSON_Print(json);
-    if (json_string == NULL) {
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
-        return ESP_FAIL;
+    json_obj_begin(w, NULL);
+    if (fields & STATE_SENSORS) {
+        json_obj_begin(w, "sensors");
+        write_sensors(w, &snap);
+        json_obj_end(w);
     }
+    write_config_state(w, fields, &config, version);
+    json_obj_end(w);
     
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, json_string, HTTPD_RESP_USE_STRLEN);
+    return http_stream_end(&stream);
+}
+
+// HTTP GET handler for relay status API.
+// Everything comes from one config copy (RAM, no flash access), so the
+// body always matches the version in the ETag.
+static esp_err_t api_relay_get_handler(httpd_req_t *req)
+{
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
     
-    free(json_string);
-    cJSON_Delete(json);
-    return ESP_OK;
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-c%lu\"", (unsigned long)etag_boot_id, (unsigned long)version);
+    if (send_if_not_modified(req, COND_RELAY, etag)) {
+        return ESP_OK;
+    }
+    
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    json_uint(w, "state", config.relay_state);
+    json_uint(w, "mode", config.auto_mode);
+    json_number(w, "threshold_high", config.temp_high, JSON_NUM_AUTO);
+    json_number(w, "threshold_low", config.temp_low, JSON_NUM_AUTO);
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
 }
 
 // HTTP POST handler for relay control API
@@ -173,6 +414,10 @@ static esp_err_t api_relay_post_handler(httpd_req_t *req)
     cJSON *state_json = cJSON_GetObjectItem(json, "state");
     cJSON *mode_json = cJSON_GetObjectItem(json, "mode");
     
+    // State and mode go in as one update
+    app_config_t update = {0};
+    uint32_t fields = 0;
+    
     // Handle state change
     if (cJSON_IsNumber(state_json)) {
         int new_state = (int)cJSON_GetNumberValue(state_json);
@@ -184,8 +429,8 @@ static esp_err_t api_relay_post_handler(httpd_req_t *req)
         
         // Only allow state change in manual mode
         if (get_relay_mode() == RELAY_MODE_MANUAL) {
-            set_relay_state((uint8_t)new_state);
-            storage_save_relay_state((uint8_t)new_state);
+            update.relay_state = (uint8_t)new_state;
+            fields |= APP_CONFIG_RELAY_STATE;
         }
     }
     
@@ -198,37 +443,25 @@ static esp_err_t api_relay_post_handler(httpd_req_t *req)
             return ESP_FAIL;
         }
         
-        set_relay_mode((relay_mode_t)new_mode);
-        storage_save_auto_mode((uint8_t)new_mode);
+        update.auto_mode = (uint8_t)new_mode;
+        fields |= APP_CONFIG_AUTO_MODE;
     }
+    cJSON_Delete(json);
     
-    cJSON *response = cJSON_CreateObject();
-    if (response == NULL) {
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
-        return ESP_FAIL;
+    if (fields != 0) {
+        app_config_update(&update, fields, 0, NULL);
     }
     
-    cJSON_AddBoolToObject(response, "success", true);
-    cJSON_AddNumberToObject(response, "state", get_relay_state());
-    cJSON_AddNumberToObject(response, "mode", get_relay_mode());
-    
-    char *response_string = cJSON_Print(response);
-    if (response_string == NULL) {
-        cJSON_Delete(response);
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
-        return ESP_FAIL;
-    }
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
     
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, response_string, HTTPD_RESP_USE_STRLEN);
+    json_obj_begin(w, NULL);
+    json_bool(w, "success", true);
+    json_uint(w, "state", get_relay_state());
+    json_uint(w, "mode", get_relay_mode());
+    json_obj_end(w);
     
-    free(response_string);
-    cJSON_Delete(response);
-    cJSON_Delete(json);
-    return ESP_OK;
+    return http_stream_end(&stream);
 }
 
 // HTTP POST handler for temperature thresholds API
@@ -264,84 +497,1033 @@ static esp_err_t api_thresholds_post_handler(httpd_req_t *req)
     
     float temp_high = (float)cJSON_GetNumberValue(temp_high_json);
     float temp_low = (float)cJSON_GetNumberValue(temp_low_json);
+    cJSON_Delete(json);
     
     // Validate thresholds
     if (temp_high <= temp_low) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "High temperature must be greater than low temperature");
-        cJSON_Delete(json);
         return ESP_FAIL;
     }
     
     if (temp_high < 0 || temp_high > 100 || temp_low < 0 || temp_low > 100) {
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Temperature must be between 0-100°C");
-        cJSON_Delete(json);
         return ESP_FAIL;
     }
     
-    esp_err_t err = storage_save_temp_thresholds(temp_high, temp_low);
+    esp_err_t err = app_config_set_thresholds(temp_high, temp_low);
     
-    cJSON *response = cJSON_CreateObject();
-    if (response == NULL) {
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Memory allocation failed");
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    json_bool(w, "success", err == ESP_OK);
+    json_number(w, "temp_high", temp_high, JSON_NUM_AUTO);
+    json_number(w, "temp_low", temp_low, JSON_NUM_AUTO);
+    
+    if (err == ESP_OK) {
+        json_string(w, "message", "Temperature thresholds saved successfully");
+    }
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
+}
+
+// HTTP GET handler for sensor configuration API
+static void write_sensor_config(json_writer_t *w)
+{
+    uint16_t every_n;
+    uint32_t max_age_ms;
+    sensor_acq_get_temp_refresh(&every_n, &max_age_ms);
+
+    json_uint(w, "bmp180_oss", bmp180_get_oss());
+    json_uint(w, "bmp180_temp_every_n", every_n);
+    json_uint(w, "bmp180_temp_max_age_ms", max_age_ms);
+}
+
+static esp_err_t api_sensor_config_get_handler(httpd_req_t *req)
+{
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    write_sensor_config(w);
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
+}
+
+// HTTP POST handler for sensor configuration API
+static esp_err_t api_sensor_config_post_handler(httpd_req_t *req)
+{
+    char content[200];
+    size_t recv_size = MIN(req->content_len, sizeof(content) - 1);
+    
+    int ret = httpd_req_recv(req, content, recv_size);
+    if (ret <= 0) {
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            httpd_resp_send_408(req);
+        }
         return ESP_FAIL;
     }
     
-    cJSON_AddBoolToObject(response, "success", err == ESP_OK);
-    cJSON_AddNumberToObject(response, "temp_high", temp_high);
-    cJSON_AddNumberToObject(response, "temp_low", temp_low);
+    content[ret] = '\0';
     
-    if (err == ESP_OK) {
-        cJSON_AddStringToObject(response, "message", "Temperature thresholds saved successfully");
+    cJSON *json = cJSON_Parse(content);
+    if (json == NULL) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
     }
     
-    char *response_string = cJSON_Print(response);
-    if (response_string == NULL) {
-        cJSON_Delete(response);
-        cJSON_Delete(json);
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "JSON creation failed");
+    cJSON *oss_json = cJSON_GetObjectItem(json, "bmp180_oss");
+    app_config_t update = {0};
+    uint32_t fields = 0;
+    
+    // Handle BMP180 oversampling change
+    if (cJSON_IsNumber(oss_json)) {
+        int new_oss = (int)cJSON_GetNumberValue(oss_json);
+        if (new_oss < 0 || new_oss > BMP180_OSS_MAX) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "bmp180_oss must be between 0-3");
+            cJSON_Delete(json);
+            return ESP_FAIL;
+        }
+        
+        update.bmp180_oss = (uint8_t)new_oss;
+        fields |= APP_CONFIG_BMP180_OSS;
+    }
+    
+    // Handle BMP180 temperature decimation change (either field may be omitted)
+    cJSON *every_json = cJSON_GetObjectItem(json, "bmp180_temp_every_n");
+    cJSON *age_json = cJSON_GetObjectItem(json, "bmp180_temp_max_age_ms");
+    if (cJSON_IsNumber(every_json) || cJSON_IsNumber(age_json)) {
+        uint16_t every_n;
+        uint32_t max_age_ms;
+        sensor_acq_get_temp_refresh(&every_n, &max_age_ms);
+        
+        double new_every = cJSON_IsNumber(every_json) ? cJSON_GetNumberValue(every_json) : every_n;
+        double new_age = cJSON_IsNumber(age_json) ? cJSON_GetNumberValue(age_json) : max_age_ms;
+        if (new_every < 1 || new_every > SENSOR_ACQ_TEMP_EVERY_N_MAX ||
+            new_age < SENSOR_ACQ_TEMP_MAX_AGE_MIN_MS || new_age > SENSOR_ACQ_TEMP_MAX_AGE_MAX_MS) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST,
+                                "bmp180_temp_every_n must be 1-100, bmp180_temp_max_age_ms 1000-3600000");
+            cJSON_Delete(json);
+            return ESP_FAIL;
+        }
+        
+        update.bmp180_temp_every_n = (uint16_t)new_every;
+        update.bmp180_temp_max_age_ms = (uint32_t)new_age;
+        fields |= APP_CONFIG_BMP180_TEMP_REFRESH;
+    }
+    cJSON_Delete(json);
+    
+    if (fields != 0) {
+        app_config_update(&update, fields, 0, NULL);
+    }
+    
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    json_bool(w, "success", true);
+    write_sensor_config(w);
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
+}
+
+// Full configuration API: GET returns every setting plus its version, PATCH
+// changes any subset of them as one transaction
+#define CONFIG_BODY_MAX     512
+#define CONFIG_PATCH_RETRIES 3
+
+static const char *const config_keys[] = {
+    "state", "mode", "temp_high", "temp_low",
+    "bmp180_oss", "bmp180_temp_every_n", "bmp180_temp_max_age_ms",
+};
+
+static esp_err_t send_config(httpd_req_t *req, const app_config_t *config, uint32_t version)
+{
+    // The version restarts at every boot, so the tag carries the boot id
+    // too; an If-Match from before a reboot can never match the new count
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)etag_boot_id, (unsigned long)version);
+    
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    
+    json_obj_begin(w, NULL);
+    json_uint(w, "version", version);
+    json_string(w, "etag", etag);
+    json_uint(w, "state", config->relay_state);
+    json_uint(w, "mode", config->auto_mode);
+    json_number(w, "temp_high", config->temp_high, JSON_NUM_AUTO);
+    json_number(w, "temp_low", config->temp_low, JSON_NUM_AUTO);
+    json_uint(w, "bmp180_oss", config->bmp180_oss);
+    json_uint(w, "bmp180_temp_every_n", config->bmp180_temp_every_n);
+    json_uint(w, "bmp180_temp_max_age_ms", config->bmp180_temp_max_age_ms);
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
+}
+
+static esp_err_t api_config_get_handler(httpd_req_t *req)
+{
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
+    return send_config(req, &config, version);
+}
+
+// Parses an If-Match header holding a /api/config ETag ("<boot>-<version>",
+// optionally weak) or "*". *version is 0 when the header is absent or "*";
+// *stale is set when the tag was issued before the last reboot. Returns
+// false if it cannot be parsed, including a bare version without boot id.
+static bool parse_if_match(httpd_req_t *req, uint32_t *version, bool *stale)
+{
+    char value[32];
+    *version = 0;
+    *stale = false;
+    if (httpd_req_get_hdr_value_str(req, "If-Match", value, sizeof(value)) != ESP_OK) {
+        return httpd_req_get_hdr_value_len(req, "If-Match") == 0;
+    }
+
+    const char *p = value;
+    if (strcmp(p, "*") == 0) {
+        return true;
+    }
+    if (strncmp(p, "W/", 2) == 0) {
+        p += 2;
+    }
+    if (*p == '"') {
+        p++;
+    }
+    char *end;
+    unsigned long boot = strtoul(p, &end, 16);
+    if (end - p != 8 || *end != '-') {
+        return false;
+    }
+    p = end + 1;
+    unsigned long v = strtoul(p, &end, 10);
+    if (end == p || (*end != '\0' && *end != '"') || v == 0) {
+        return false;
+    }
+    *version = (uint32_t)v;
+    *stale = (uint32_t)boot != etag_boot_id;
+    return true;
+}
+
+// Overlays the PATCH body on config and returns the touched fields in
+// *fields, or an error message
+static const char *parse_config_patch(const cJSON *json, app_config_t *config, uint32_t *fields)
+{
+    *fields = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, json) {
+        size_t k;
+        for (k = 0; k < sizeof(config_keys) / sizeof(config_keys[0]); k++) {
+            if (item->string != NULL && strcmp(item->string, config_keys[k]) == 0) {
+                break;
+            }
+        }
+        if (k == sizeof(config_keys) / sizeof(config_keys[0])) {
+            return "Unknown configuration field";
+        }
+        if (!cJSON_IsNumber(item)) {
+            return "Configuration values must be numbers";
+        }
+    }
+
+    const cJSON *state_json = cJSON_GetObjectItem(json, "state");
+    const cJSON *mode_json = cJSON_GetObjectItem(json, "mode");
+    const cJSON *high_json = cJSON_GetObjectItem(json, "temp_high");
+    const cJSON *low_json = cJSON_GetObjectItem(json, "temp_low");
+    const cJSON *oss_json = cJSON_GetObjectItem(json, "bmp180_oss");
+    const cJSON *every_json = cJSON_GetObjectItem(json, "bmp180_temp_every_n");
+    const cJSON *age_json = cJSON_GetObjectItem(json, "bmp180_temp_max_age_ms");
+
+    if (mode_json != NULL) {
+        double mode = cJSON_GetNumberValue(mode_json);
+        if (mode != 0 && mode != 1) {
+            return "Mode must be 0 (manual) or 1 (auto)";
+        }
+        config->auto_mode = (uint8_t)mode;
+        *fields |= APP_CONFIG_AUTO_MODE;
+    }
+
+    if (state_json != NULL) {
+        double state = cJSON_GetNumberValue(state_json);
+        if (state != 0 && state != 1) {
+            return "State must be 0 or 1";
+        }
+        // Auto mode owns the relay; checked against the resulting mode
+        if (config->auto_mode && (uint8_t)state != config->relay_state) {
+            return "State can only be changed in manual mode";
+        }
+        config->relay_state = (uint8_t)state;
+        *fields |= APP_CONFIG_RELAY_STATE;
+    }
+
+    if (high_json != NULL || low_json != NULL) {
+        double high = high_json != NULL ? cJSON_GetNumberValue(high_json) : config->temp_high;
+        double low = low_json != NULL ? cJSON_GetNumberValue(low_json) : config->temp_low;
+        if (high < 0 || high > 100 || low < 0 || low > 100) {
+            return "Temperature must be between 0-100°C";
+        }
+        if (high <= low) {
+            return "High temperature must be greater than low temperature";
+        }
+        config->temp_high = (float)high;
+        config->temp_low = (float)low;
+        *fields |= APP_CONFIG_THRESHOLDS;
+    }
+
+    if (oss_json != NULL) {
+        double oss = cJSON_GetNumberValue(oss_json);
+        if (oss < 0 || oss > BMP180_OSS_MAX || oss != (int)oss) {
+            return "bmp180_oss must be between 0-3";
+        }
+        config->bmp180_oss = (uint8_t)oss;
+        *fields |= APP_CONFIG_BMP180_OSS;
+    }
+
+    if (every_json != NULL || age_json != NULL) {
+        double every = every_json != NULL ? cJSON_GetNumberValue(every_json) : config->bmp180_temp_every_n;
+        double age = age_json != NULL ? cJSON_GetNumberValue(age_json) : config->bmp180_temp_max_age_ms;
+        if (every < 1 || every > SENSOR_ACQ_TEMP_EVERY_N_MAX ||
+            age < SENSOR_ACQ_TEMP_MAX_AGE_MIN_MS || age > SENSOR_ACQ_TEMP_MAX_AGE_MAX_MS) {
+            return "bmp180_temp_every_n must be 1-100, bmp180_temp_max_age_ms 1000-3600000";
+        }
+        config->bmp180_temp_every_n = (uint16_t)every;
+        config->bmp180_temp_max_age_ms = (uint32_t)age;
+        *fields |= APP_CONFIG_BMP180_TEMP_REFRESH;
+    }
+
+    return NULL;
+}
+
+static esp_err_t api_config_patch_handler(httpd_req_t *req)
+{
+    uint32_t if_match;
+    bool if_match_stale;
+    if (!parse_if_match(req, &if_match, &if_match_stale)) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "If-Match must be an ETag from GET /api/config");
         return ESP_FAIL;
     }
+    if (if_match_stale) {
+        app_config_t config;
+        uint32_t version = app_config_get_versioned(&config);
+        httpd_resp_set_status(req, "412 Precondition Failed");
+        return send_config(req, &config, version);
+    }
     
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-    httpd_resp_send(req, response_string, HTTPD_RESP_USE_STRLEN);
+    if (req->content_len == 0 || req->content_len >= CONFIG_BODY_MAX) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid request body size");
+        return ESP_FAIL;
+    }
+    
+    char content[CONFIG_BODY_MAX];
+    size_t received = 0;
+    while (received < req->content_len) {
+        int ret = httpd_req_recv(req, content + received, req->content_len - received);
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                httpd_resp_send_408(req);
+            }
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    content[received] = '\0';
+    
+    cJSON *json = cJSON_Parse(content);
+    if (!cJSON_IsObject(json)) {
+        cJSON_Delete(json);
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        return ESP_FAIL;
+    }
     
-    free(response_string);
-    cJSON_Delete(response);
+    // Validate against a snapshot and apply only if nothing changed in
+    // between; without If-Match a concurrent writer just means another try
+    app_config_t config;
+    uint32_t version = 0;
+    esp_err_t err = ESP_ERR_INVALID_VERSION;
+    for (int attempt = 0; attempt < CONFIG_PATCH_RETRIES && err == ESP_ERR_INVALID_VERSION; attempt++) {
+        uint32_t read_version = app_config_get_versioned(&config);
+        if (if_match != 0 && if_match != read_version) {
+            break;
+        }
+        
+        uint32_t fields;
+        const char *msg = parse_config_patch(json, &config, &fields);
+        if (msg != NULL) {
+            cJSON_Delete(json);
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, msg);
+            return ESP_FAIL;
+        }
+        
+        err = app_config_update(&config, fields, read_version, &version);
+        if (err == ESP_ERR_INVALID_VERSION && if_match != 0) {
+            break;
+        }
+    }
     cJSON_Delete(json);
-    return ESP_OK;
+    
+    if (err == ESP_ERR_INVALID_VERSION) {
+        // Send the current state so the client can rebase
+        version = app_config_get_versioned(&config);
+        httpd_resp_set_status(req, "412 Precondition Failed");
+        return send_config(req, &config, version);
+    }
+    if (err != ESP_OK) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Configuration update failed");
+        return ESP_FAIL;
+    }
+    
+    return send_config(req, &config, version);
+}
+
+static void write_i2c_bus_metrics(json_writer_t *w)
+{
+    static const char *prio_names[I2C_BUS_PRIO_COUNT] = { "control", "normal", "diag" };
+    i2c_bus_stats_t stats;
+    i2c_bus_get_stats(&stats);
+
+    json_obj_begin(w, "i2c_bus");
+    json_uint(w, "busy_us", stats.busy_us);
+    for (int prio = 0; prio < I2C_BUS_PRIO_COUNT; prio++) {
+        const i2c_bus_prio_stats_t *ps = &stats.prio[prio];
+        json_obj_begin(w, prio_names[prio]);
+        json_uint(w, "transactions", ps->transactions);
+        json_uint(w, "errors", ps->errors);
+        json_uint(w, "timeouts", ps->timeouts);
+        json_uint(w, "queue_depth", ps->queue_depth);
+        json_uint(w, "max_queue_depth", ps->max_queue_depth);
+        json_uint(w, "avg_wait_us", ps->transactions ? ps->total_wait_us / ps->transactions : 0);
+        json_uint(w, "max_wait_us", ps->max_wait_us);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+}
+
+// Summary plus non-empty buckets as [floor_us, count] pairs, written into
+// the current object so callers can add their own fields next to them
+static void write_latency_hist(json_writer_t *w, const latency_hist_t *hist)
+{
+    json_uint(w, "count", hist->count);
+    if (hist->count == 0) {
+        return;
+    }
+    json_uint(w, "min_us", hist->min_us);
+    json_uint(w, "mean_us", hist->sum_us / hist->count);
+    json_uint(w, "p50_us", latency_hist_percentile(hist, 50));
+    json_uint(w, "p90_us", latency_hist_percentile(hist, 90));
+    json_uint(w, "p99_us", latency_hist_percentile(hist, 99));
+    json_uint(w, "max_us", hist->max_us);
+
+    json_arr_begin(w, "buckets");
+    for (int i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        if (hist->buckets[i] == 0) {
+            continue;
+        }
+        json_arr_begin(w, NULL);
+        json_uint(w, NULL, latency_hist_bucket_floor(i));
+        json_uint(w, NULL, hist->buckets[i]);
+        json_arr_end(w);
+    }
+    json_arr_end(w);
+}
+
+static void write_sensor_acq_metrics(json_writer_t *w)
+{
+    static const char *conv_names[SENSOR_CONV_COUNT] = { "aht20", "bmp180_temp", "bmp180_pressure" };
+    sensor_acq_stats_t stats;
+    sensor_acq_get_stats(&stats);
+
+    json_obj_begin(w, "sensor_acq");
+    json_uint(w, "cycles", stats.cycles);
+    json_uint(w, "overruns", stats.overruns);
+    json_uint(w, "cycle_timeouts", stats.cycle_timeouts);
+    json_uint(w, "last_cycle_us", stats.last_cycle_us);
+    json_uint(w, "max_cycle_us", stats.max_cycle_us);
+    
+    // Heap allocations per sample, only counted with CONFIG_HEAP_USE_HOOKS
+    json_obj_begin(w, "allocs");
+    json_bool(w, "counting", alloc_counter_enabled());
+    json_uint(w, "last_cycle", stats.last_cycle_allocs);
+    json_uint(w, "cycles_with_allocs", stats.cycles_with_allocs);
+    json_obj_end(w);
+
+    // BMP180 temperature conversions vs pressure samples reusing the cached B5
+    json_obj_begin(w, "bmp180_b5");
+    json_uint(w, "temp_reads", stats.bmp180_temp_reads);
+    json_uint(w, "reused", stats.bmp180_b5_reused);
+    json_obj_end(w);
+
+    // On-demand reads (/api/sensors?fresh=1): coalesced = answered without
+    // starting an acquisition of their own
+    latency_hist_t hist;
+    sensor_acq_get_fresh_wait_hist(&hist);
+    uint32_t coalesced = stats.fresh_cached + stats.fresh_joined;
+    json_obj_begin(w, "fresh");
+    json_uint(w, "requests", stats.fresh_requests);
+    json_uint(w, "cached", stats.fresh_cached);
+    json_uint(w, "started", stats.fresh_started);
+    json_uint(w, "joined", stats.fresh_joined);
+    json_uint(w, "timeouts", stats.fresh_timeouts);
+    json_uint(w, "rejected", stats.fresh_rejected);
+    json_number(w, "coalesced_pct",
+                stats.fresh_requests ? 100.0 * coalesced / stats.fresh_requests : 0, 1);
+    json_obj_begin(w, "wait");
+    write_latency_hist(w, &hist);
+    json_obj_end(w);
+    json_obj_end(w);
+
+    // Trigger-to-ready latency per conversion, timeouts = read at the datasheet maximum
+    json_obj_begin(w, "conversions");
+    for (int i = 0; i < SENSOR_CONV_COUNT; i++) {
+        sensor_acq_get_conv_hist((sensor_conv_t)i, &hist);
+        json_obj_begin(w, conv_names[i]);
+        write_latency_hist(w, &hist);
+        json_uint(w, "timeouts", stats.conv_timeouts[i]);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+    json_obj_end(w);
+}
+
+static const char *history_tier_names[SENSOR_HISTORY_TIER_COUNT] = { "raw", "minute", "hour" };
+
+static void write_history_metrics(json_writer_t *w)
+{
+    sensor_history_info_t info;
+    sensor_history_get_info(&info);
+
+    json_obj_begin(w, "history");
+    json_bool(w, "psram", info.psram);
+    for (int i = 0; i < SENSOR_HISTORY_TIER_COUNT; i++) {
+        json_obj_begin(w, history_tier_names[i]);
+        json_uint(w, "count", info.count[i]);
+        json_uint(w, "capacity", info.capacity[i]);
+        json_uint(w, "oldest_ms", info.oldest_ms[i]);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+}
+
+static void write_config_metrics(json_writer_t *w)
+{
+    app_config_commit_stats_t stats;
+    app_config_get_commit_stats(&stats);
+
+    // Deferred NVS commits: changes merged or reverted within the window are avoided
+    json_obj_begin(w, "config");
+    json_uint(w, "version", app_config_version());
+    json_uint(w, "load_us", app_config_load_us());
+    json_string(w, "load_source", app_config_load_source());
+    json_uint(w, "commit_window_ms", app_config_get_commit_window());
+    json_uint(w, "changes", stats.changes);
+    json_uint(w, "commits", stats.commits);
+    json_uint(w, "commits_avoided", stats.commits_avoided);
+    json_uint(w, "commit_errors", stats.commit_errors);
+    json_uint(w, "pending", stats.pending);
+    json_obj_end(w);
+}
+
+static void write_events_metrics(json_writer_t *w)
+{
+    web_events_stats_t stats;
+    web_events_get_stats(&stats);
+
+    // One formatted payload per event, written to every client
+    json_obj_begin(w, "events");
+    json_uint(w, "clients", stats.clients);
+    json_uint(w, "connects", stats.connects);
+    json_uint(w, "rejected", stats.rejected);
+    json_uint(w, "events", stats.events);
+    json_uint(w, "deliveries", stats.deliveries);
+    json_uint(w, "send_errors", stats.send_errors);
+    json_uint(w, "bytes_sent", stats.bytes_sent);
+    json_obj_end(w);
+}
+
+static void write_longpoll_metrics(json_writer_t *w)
+{
+    web_longpoll_stats_t stats;
+    web_longpoll_get_stats(&stats);
+    latency_hist_t hist;
+    web_longpoll_get_wait_hist(&hist);
+
+    // Parked requests are async: they hold a socket, not the server task
+    json_obj_begin(w, "longpoll");
+    json_uint(w, "parked", stats.parked);
+    json_uint(w, "max_parked", stats.max_parked);
+    json_uint(w, "requests", stats.requests);
+    json_uint(w, "immediate", stats.immediate);
+    json_uint(w, "changed", stats.changed);
+    json_uint(w, "timeouts", stats.timeouts);
+    json_uint(w, "rejected", stats.rejected);
+    json_uint(w, "send_errors", stats.send_errors);
+    json_obj_begin(w, "wait");
+    write_latency_hist(w, &hist);
+    json_obj_end(w);
+    json_obj_end(w);
+}
+
+static void write_socket_metrics(json_writer_t *w)
+{
+    static const char *kind_names[WEB_SOCKET_KIND_COUNT] = { "events", "longpoll", "ws" };
+    web_sockets_stats_t stats;
+    web_sockets_get_stats(&stats);
+
+    json_obj_begin(w, "sockets");
+    json_uint(w, "max_open", WEB_SOCKETS_MAX_OPEN);
+    json_uint(w, "long_lived_max", WEB_SOCKETS_LONG_LIVED_MAX);
+    json_uint(w, "long_lived", stats.long_lived);
+    json_uint(w, "max_long_lived", stats.max_long_lived);
+    json_uint(w, "refused", stats.refused);
+    for (int kind = 0; kind < WEB_SOCKET_KIND_COUNT; kind++) {
+        json_uint(w, kind_names[kind], stats.in_use[kind]);
+    }
+    json_obj_end(w);
+}
+
+static void write_ws_metrics(json_writer_t *w)
+{
+    web_ws_stats_t stats;
+    web_ws_get_stats(&stats);
+
+    json_obj_begin(w, "ws");
+    json_uint(w, "clients", stats.clients);
+    json_uint(w, "connects", stats.connects);
+    json_uint(w, "rejected", stats.rejected);
+    json_uint(w, "frames_sent", stats.frames_sent);
+    json_uint(w, "send_errors", stats.send_errors);
+    json_uint(w, "bytes_sent", stats.bytes_sent);
+    json_uint(w, "commands", stats.commands);
+    json_uint(w, "bad_commands", stats.bad_commands);
+    json_uint(w, "acks_dropped", stats.acks_dropped);
+    json_obj_end(w);
+}
+
+// Bytes and encode time of one sample in each representation
+static void write_encoding_metrics(json_writer_t *w)
+{
+    latency_hist_t hist;
+    json_obj_begin(w, "encoding");
+
+    web_ws_get_encode_hist(&hist);
+    json_obj_begin(w, "ws_sample");
+    write_latency_hist(w, &hist);
+    json_uint(w, "bytes", sizeof(web_ws_sample_msg_t));
+    json_obj_end(w);
+
+    web_events_stats_t events;
+    web_events_get_stats(&events);
+    web_events_get_encode_hist(&hist);
+    json_obj_begin(w, "sse_sensors");
+    write_latency_hist(w, &hist);
+    json_uint(w, "bytes", events.sensors_bytes);
+    json_obj_end(w);
+
+    latency_hist_copy(&sensors_json_hist, &hist);
+    json_obj_begin(w, "api_sensors");
+    write_latency_hist(w, &hist);
+    json_uint(w, "bytes", sensors_json_bytes);
+    json_obj_end(w);
+
+    json_obj_end(w);
+}
+
+static void write_nvs_metrics(json_writer_t *w)
+{
+    storage_stats_t stats;
+    storage_get_stats(&stats);
+    latency_hist_t hist;
+    storage_get_commit_hist(&hist);
+
+    // Write volume since boot (entries_written / 126 ~ pages consumed) and usage
+    json_obj_begin(w, "nvs");
+    json_uint(w, "uptime_s", esp_timer_get_time() / 1000000);
+    json_uint(w, "writes", stats.writes);
+    json_uint(w, "bytes_written", stats.bytes_written);
+    json_uint(w, "entries_written", stats.entries_written);
+    json_uint(w, "commits", stats.commits);
+    json_uint(w, "commit_errors", stats.commit_errors);
+    json_obj_begin(w, "commit");
+    write_latency_hist(w, &hist);
+    json_obj_end(w);
+
+    json_obj_begin(w, "keys");
+    for (uint32_t i = 0; i < stats.key_count; i++) {
+        const storage_key_stats_t *ks = &stats.keys[i];
+        json_obj_begin(w, ks->key);
+        json_uint(w, "writes", ks->writes);
+        json_uint(w, "erases", ks->erases);
+        json_uint(w, "errors", ks->errors);
+        json_uint(w, "bytes", ks->bytes);
+        json_uint(w, "entries", ks->entries);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+
+    json_obj_begin(w, "usage");
+    json_uint(w, "used_entries", stats.used_entries);
+    json_uint(w, "free_entries", stats.free_entries);
+    json_uint(w, "available_entries", stats.available_entries);
+    json_uint(w, "total_entries", stats.total_entries);
+    json_uint(w, "namespace_count", stats.namespace_count);
+    json_uint(w, "namespace_entries", stats.namespace_entries);
+    json_uint(w, "samples", stats.samples);
+    json_uint(w, "age_ms", (esp_timer_get_time() - stats.sampled_us) / 1000);
+    json_obj_end(w);
+    json_obj_end(w);
+}
+
+static void write_ts_log_metrics(json_writer_t *w)
+{
+    ts_log_stats_t stats;
+    ts_log_get_stats(&stats);
+
+    json_obj_begin(w, "ts_log");
+    json_uint(w, "segments", stats.segments);
+    json_uint(w, "segments_used", stats.segments_used);
+    json_uint(w, "records", stats.records);
+    json_uint(w, "capacity", (uint64_t)stats.segments * stats.records_per_segment);
+    json_uint(w, "oldest_ms", stats.oldest_ms);
+    json_uint(w, "newest_ms", stats.newest_ms);
+    json_uint(w, "appends", stats.appends);
+    json_uint(w, "append_errors", stats.append_errors);
+    json_uint(w, "segments_erased", stats.segments_erased);
+    json_uint(w, "crc_errors", stats.crc_errors);
+    json_uint(w, "bytes_written", stats.bytes_written);
+    json_uint(w, "mount_us", stats.mount_us);
+    json_obj_end(w);
+}
+
+// JSON bodies sent through http_stream; memory per response is the window
+// regardless of max_bytes
+static void write_stream_metrics(json_writer_t *w)
+{
+    http_stream_stats_t stats;
+    http_stream_get_stats(&stats);
+
+    json_obj_begin(w, "responses");
+    json_uint(w, "window", HTTP_STREAM_WINDOW);
+    json_uint(w, "count", stats.responses);
+    json_uint(w, "chunked", stats.chunked);
+    json_uint(w, "chunks", stats.chunks);
+    json_uint(w, "errors", stats.errors);
+    json_uint(w, "bytes", stats.bytes);
+    json_uint(w, "max_bytes", stats.max_bytes);
+    json_obj_end(w);
+}
+
+// Slow routes run on the worker pool; queue_wait is time between the
+// server task detaching a request and a worker picking it up
+static void write_workers_metrics(json_writer_t *w)
+{
+    web_workers_stats_t stats;
+    web_workers_get_stats(&stats);
+    latency_hist_t hist;
+
+    json_obj_begin(w, "workers");
+    json_uint(w, "count", WEB_WORKERS_COUNT);
+    json_uint(w, "busy", stats.busy);
+    json_uint(w, "offloaded", stats.offloaded);
+    json_uint(w, "rejected", stats.rejected);
+    json_uint(w, "errors", stats.errors);
+    json_uint(w, "queue_len", WEB_WORKERS_QUEUE_LEN);
+    json_uint(w, "queue_depth", stats.queue_depth);
+    json_uint(w, "max_queue_depth", stats.max_queue_depth);
+    web_workers_get_queue_hist(&hist);
+    json_obj_begin(w, "queue_wait");
+    write_latency_hist(w, &hist);
+    json_obj_end(w);
+    web_workers_get_run_hist(&hist);
+    json_obj_begin(w, "run");
+    write_latency_hist(w, &hist);
+    json_obj_end(w);
+    json_obj_end(w);
+}
+
+// Full responses vs 304s per conditional endpoint
+static void write_conditional_metrics(json_writer_t *w)
+{
+    uint32_t full[COND_COUNT];
+    uint32_t not_modified[COND_COUNT];
+    portENTER_CRITICAL(&cond_lock);
+    memcpy(full, cond_full, sizeof(full));
+    memcpy(not_modified, cond_not_modified, sizeof(not_modified));
+    portEXIT_CRITICAL(&cond_lock);
+
+    json_obj_begin(w, "conditional");
+    for (int i = 0; i < COND_COUNT; i++) {
+        uint32_t total = full[i] + not_modified[i];
+        json_obj_begin(w, cond_route_names[i]);
+        json_uint(w, "full", full[i]);
+        json_uint(w, "not_modified", not_modified[i]);
+        json_number(w, "not_modified_pct", total ? 100.0 * not_modified[i] / total : 0, 1);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+}
+
+// HTTP GET handler for diagnostics/metrics API.
+// Several KB of output; streamed a window at a time as it is written.
+static esp_err_t api_metrics_get_handler(httpd_req_t *req)
+{
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+    
+    json_obj_begin(w, NULL);
+    write_i2c_bus_metrics(w);
+    write_sensor_acq_metrics(w);
+    write_history_metrics(w);
+    write_ts_log_metrics(w);
+    write_config_metrics(w);
+    write_nvs_metrics(w);
+    write_events_metrics(w);
+    write_longpoll_metrics(w);
+    write_ws_metrics(w);
+    write_socket_metrics(w);
+    write_encoding_metrics(w);
+    write_stream_metrics(w);
+    write_conditional_metrics(w);
+    write_workers_metrics(w);
+    json_obj_end(w);
+    
+    return http_stream_end(&stream);
+}
+
+static const char *const export_channel_names[] = {
+    "aht22_temperature", "aht22_humidity", "bmp180_temperature", "bmp180_pressure",
+};
+
+static void write_channel_names(json_writer_t *w)
+{
+    json_arr_begin(w, "channels");
+    for (size_t i = 0; i < sizeof(export_channel_names) / sizeof(export_channel_names[0]); i++) {
+        json_string(w, NULL, export_channel_names[i]);
+    }
+    json_arr_end(w);
+}
+
+// One output point: [t, [min,avg,max] or null per channel]
+static void write_history_point(json_writer_t *w, const sensor_history_point_t *p)
+{
+    json_arr_begin(w, NULL);
+    json_uint(w, NULL, p->t_ms);
+    for (int i = 0; i < SENSOR_HISTORY_CH_COUNT; i++) {
+        const sensor_history_agg_t *a = &p->ch[i];
+        if (a->n == 0) {
+            json_null(w, NULL);
+            continue;
+        }
+        json_arr_begin(w, NULL);
+        json_number(w, NULL, a->min, 2);
+        json_number(w, NULL, a->sum / a->n, 2);
+        json_number(w, NULL, a->max, 2);
+        json_arr_end(w);
+    }
+    json_arr_end(w);
+}
+
+// Points a history response is sized for when step is omitted
+#define HISTORY_MAX_POINTS  500
+
+// HTTP GET handler for history API: /api/history?from=&to=&step= (uptime ms).
+// The tier is chosen from step and range, points are merged to step and
+// streamed in chunks.
+static esp_err_t api_history_get_handler(httpd_req_t *req)
+{
+    char query[96];
+    const char *q = NULL;
+    if (httpd_req_get_url_query_len(req) < sizeof(query) &&
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        q = query;
+    }
+
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t to_ms = (uint32_t)query_u64(q, "to", now_ms);
+    uint32_t from_ms = (uint32_t)query_u64(q, "from", to_ms > SENSOR_HISTORY_HOUR_MS ? to_ms - SENSOR_HISTORY_HOUR_MS : 0);
+    uint32_t step_ms = (uint32_t)query_u64(q, "step", 0);
+    if (from_ms > to_ms) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from must not be after to");
+        return ESP_FAIL;
+    }
+
+    // No step: spread the range over at most HISTORY_MAX_POINTS buckets
+    bool default_step = step_ms == 0;
+    if (default_step) {
+        step_ms = (to_ms - from_ms) / HISTORY_MAX_POINTS;
+    }
+
+    sensor_history_tier_t tier = sensor_history_pick_tier(from_ms, step_ms);
+    uint32_t resolution_ms = sensor_history_tier_resolution_ms(tier);
+    if (step_ms < resolution_ms) {
+        step_ms = resolution_ms;
+    } else if (default_step && resolution_ms > 0) {
+        // Whole rollup intervals per bucket
+        step_ms = (step_ms + resolution_ms - 1) / resolution_ms * resolution_ms;
+    }
+
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+
+    json_obj_begin(w, NULL);
+    json_string(w, "tier", history_tier_names[tier]);
+    json_uint(w, "step_ms", step_ms);
+    json_uint(w, "from", from_ms);
+    json_uint(w, "to", to_ms);
+    write_channel_names(w);
+    json_arr_begin(w, "points");
+
+    sensor_history_point_t batch[4];
+    sensor_history_point_t bucket;
+    bool have_bucket = false;
+    // Rollups are keyed by interval start: begin at the interval that
+    // contains from_ms, which may still be the open one
+    uint32_t cursor = resolution_ms > 0 ? from_ms - from_ms % resolution_ms : from_ms;
+    size_t n;
+
+    // Merge consecutive points into step-sized buckets; a bucket is written
+    // once a point past it arrives. Stops early if the client went away.
+    do {
+        n = sensor_history_read(tier, &cursor, to_ms, batch, sizeof(batch) / sizeof(batch[0]));
+        for (size_t i = 0; i < n; i++) {
+            uint32_t start = step_ms > 0 ? batch[i].t_ms - batch[i].t_ms % step_ms : batch[i].t_ms;
+            if (have_bucket && start != bucket.t_ms) {
+                write_history_point(w, &bucket);
+                have_bucket = false;
+            }
+            if (have_bucket) {
+                sensor_history_merge(&bucket, &batch[i]);
+            } else {
+                bucket = batch[i];
+                bucket.t_ms = start;
+                have_bucket = true;
+            }
+        }
+    } while (n > 0 && w->err == ESP_OK);
+
+    if (have_bucket) {
+        write_history_point(w, &bucket);
+    }
+
+    json_arr_end(w);
+    json_obj_end(w);
+    return http_stream_end(&stream);
+}
+
+// HTTP GET handler for the flash log: /api/log?from=&to=&limit= (log time ms).
+// Records are streamed oldest first as [t, value or null per channel].
+static esp_err_t api_log_get_handler(httpd_req_t *req)
+{
+    char query[96];
+    const char *q = NULL;
+    if (httpd_req_get_url_query_len(req) < sizeof(query) &&
+        httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK) {
+        q = query;
+    }
+
+    uint64_t now_ms = ts_log_now_ms();
+    uint64_t to_ms = query_u64(q, "to", now_ms);
+    uint64_t from_ms = query_u64(q, "from", to_ms > SENSOR_HISTORY_HOUR_MS ? to_ms - SENSOR_HISTORY_HOUR_MS : 0);
+    uint64_t limit = query_u64(q, "limit", 1000);
+    if (from_ms > to_ms) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "from must not be after to");
+        return ESP_FAIL;
+    }
+
+    http_stream_t stream;
+    json_writer_t *w = http_stream_begin(&stream, req);
+
+    json_obj_begin(w, NULL);
+    json_uint(w, "now", now_ms);
+    json_uint(w, "from", from_ms);
+    json_uint(w, "to", to_ms);
+    write_channel_names(w);
+    json_arr_begin(w, "records");
+
+    ts_log_record_t batch[8];
+    uint64_t cursor = from_ms;
+    uint64_t sent = 0;
+    size_t n;
+    while (sent < limit && w->err == ESP_OK &&
+           (n = ts_log_read(&cursor, to_ms, batch, MIN(sizeof(batch) / sizeof(batch[0]), limit - sent))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            json_arr_begin(w, NULL);
+            json_uint(w, NULL, batch[i].t_ms);
+            for (int c = 0; c < TS_LOG_CH_COUNT; c++) {
+                if (batch[i].valid & (1u << c)) {
+                    json_number(w, NULL, batch[i].value[c] / 100.0, 2);
+                } else {
+                    json_null(w, NULL);
+                }
+            }
+            json_arr_end(w);
+            sent++;
+        }
+    }
+
+    // Limit reached: truncated only if another record is left in range
+    bool truncated = false;
+    if (sent >= limit && w->err == ESP_OK) {
+        ts_log_record_t next;
+        truncated = ts_log_read(&cursor, to_ms, &next, 1) > 0;
+    }
+
+    json_arr_end(w);
+    json_bool(w, "truncated", truncated);
+    json_obj_end(w);
+    return http_stream_end(&stream);
+}
+
+// Session close hook: lets the modules holding long-lived sockets forget
+// the fd before it can be reused. A close_fn must close the socket itself.
+static void on_session_close(httpd_handle_t hd, int sockfd)
+{
+    web_ws_session_closed(sockfd);
+    close(sockfd);
 }
 
 static httpd_handle_t start_webserver(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    // Idle keep-alive sessions are reclaimed by LRU purging. Event streams,
+    // long polls and WebSockets refresh their place in the LRU order on
+    // every push, and the budget in web_sockets.h keeps enough sessions
+    // outside them for the purge to pick from.
+    config.max_open_sockets = WEB_SOCKETS_MAX_OPEN;
     config.lru_purge_enable = true;
+    config.max_uri_handlers = 20;
+    config.stack_size = 6144;   // Streaming handlers format on the stack
+    config.close_fn = on_session_close;
+
+    latency_hist_init(&sensors_json_hist);
+    etag_boot_id = esp_random();
+    if (web_events_init(write_sensors, write_relay_event) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start event stream");
+    }
+    if (web_longpoll_init(write_longpoll_body) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start long poll");
+    }
+    if (web_workers_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start HTTP workers, slow routes run inline");
+    }
 
     ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
     if (httpd_start(&server, &config) == ESP_OK) {
         ESP_LOGI(TAG, "Registering URI handlers");
         
-        httpd_uri_t root = {
-            .uri       = "/",
-            .method    = HTTP_GET,
-            .handler   = root_get_handler
-        };
-        httpd_register_uri_handler(server, &root);
-
-        httpd_uri_t style = {
-            .uri       = "/style.css",
-            .method    = HTTP_GET,
-            .handler   = style_get_handler
-        };
-        httpd_register_uri_handler(server, &style);
-
-        httpd_uri_t script = {
-            .uri       = "/script.js",
-            .method    = HTTP_GET,
-            .handler   = script_get_handler
-        };
-        httpd_register_uri_handler(server, &script);
+        for (size_t i = 0; i < web_assets_count; i++) {
+            httpd_uri_t asset = {
+                .uri       = web_assets[i].uri,
+                .method    = HTTP_GET,
+                .handler   = static_get_handler,
+                .user_ctx  = (void *)&web_assets[i]
+            };
+            httpd_register_uri_handler(server, &asset);
+        }
 
         httpd_uri_t api_sensors = {
             .uri       = "/api/sensors",
@@ -350,6 +1532,13 @@ static httpd_handle_t start_webserver(void)
         };
         httpd_register_uri_handler(server, &api_sensors);
 
+        httpd_uri_t api_state = {
+            .uri       = "/api/state",
+            .method    = HTTP_GET,
+            .handler   = api_state_get_handler
+        };
+        httpd_register_uri_handler(server, &api_state);
+
         httpd_uri_t api_relay_get = {
             .uri       = "/api/relay",
             .method    = HTTP_GET,
@@ -371,6 +1560,69 @@ static httpd_handle_t start_webserver(void)
         };
         httpd_register_uri_handler(server, &api_thresholds);
 
+        httpd_uri_t api_sensor_config_get = {
+            .uri       = "/api/sensor_config",
+            .method    = HTTP_GET,
+            .handler   = api_sensor_config_get_handler
+        };
+        httpd_register_uri_handler(server, &api_sensor_config_get);
+
+        httpd_uri_t api_sensor_config_post = {
+            .uri       = "/api/sensor_config",
+            .method    = HTTP_POST,
+            .handler   = api_sensor_config_post_handler
+        };
+        httpd_register_uri_handler(server, &api_sensor_config_post);
+
+        httpd_uri_t api_config_get = {
+            .uri       = "/api/config",
+            .method    = HTTP_GET,
+            .handler   = api_config_get_handler
+        };
+        httpd_register_uri_handler(server, &api_config_get);
+
+        httpd_uri_t api_config_patch = {
+            .uri       = "/api/config",
+            .method    = HTTP_PATCH,
+            .handler   = api_config_patch_handler
+        };
+        httpd_register_uri_handler(server, &api_config_patch);
+
+        // Exports and metrics are streamed to the client and may take a
+        // while: run them on the worker pool (user_ctx = real handler)
+        httpd_uri_t api_history = {
+            .uri       = "/api/history",
+            .method    = HTTP_GET,
+            .handler   = web_workers_handler,
+            .user_ctx  = api_history_get_handler
+        };
+        httpd_register_uri_handler(server, &api_history);
+
+        httpd_uri_t api_log = {
+            .uri       = "/api/log",
+            .method    = HTTP_GET,
+            .handler   = web_workers_handler,
+            .user_ctx  = api_log_get_handler
+        };
+        httpd_register_uri_handler(server, &api_log);
+
+        httpd_uri_t api_events = {
+            .uri       = "/api/events",
+            .method    = HTTP_GET,
+            .handler   = web_events_handler
+        };
+        httpd_register_uri_handler(server, &api_events);
+
+        web_ws_init(server);
+
+        httpd_uri_t api_metrics = {
+            .uri       = "/api/metrics",
+            .method    = HTTP_GET,
+            .handler   = web_workers_handler,
+            .user_ctx  = api_metrics_get_handler
+        };
+        httpd_register_uri_handler(server, &api_metrics);
+
         return server;
     }
 
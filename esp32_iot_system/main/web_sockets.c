@@ -0,0 +1,52 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "web_sockets.h"
+
+static const char *TAG = "WEB_SOCKETS";
+
+static portMUX_TYPE budget_lock = portMUX_INITIALIZER_UNLOCKED;
+static web_sockets_stats_t stats;
+
+bool web_sockets_acquire(web_socket_kind_t kind)
+{
+    bool ok;
+    portENTER_CRITICAL(&budget_lock);
+    ok = stats.long_lived < WEB_SOCKETS_LONG_LIVED_MAX;
+    if (ok) {
+        stats.in_use[kind]++;
+        stats.long_lived++;
+        if (stats.long_lived > stats.max_long_lived) {
+            stats.max_long_lived = stats.long_lived;
+        }
+    } else {
+        stats.refused++;
+    }
+    portEXIT_CRITICAL(&budget_lock);
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Long-lived socket budget (%d) exhausted", WEB_SOCKETS_LONG_LIVED_MAX);
+    }
+    return ok;
+}
+
+void web_sockets_release(web_socket_kind_t kind)
+{
+    portENTER_CRITICAL(&budget_lock);
+    if (stats.in_use[kind] > 0) {
+        stats.in_use[kind]--;
+        stats.long_lived--;
+    }
+    portEXIT_CRITICAL(&budget_lock);
+}
+
+void web_sockets_touch(httpd_handle_t server, int fd)
+{
+    httpd_sess_update_lru_counter(server, fd);
+}
+
+void web_sockets_get_stats(web_sockets_stats_t *out)
+{
+    portENTER_CRITICAL(&budget_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&budget_lock);
+}
@@ -0,0 +1,49 @@
+#ifndef WEB_SOCKETS_H
+#define WEB_SOCKETS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_http_server.h"
+
+// Socket budget for the HTTP server. Event streams, parked long polls and
+// WebSockets each keep a socket open for minutes; their pools share one
+// cap so that at least WEB_SOCKETS_SHORT_RESERVED sessions are never
+// long-lived. When the server is full, LRU purging closes the least
+// recently used session; long-lived sessions are marked used on every
+// push and keepalive (web_sockets_touch()), so the victim is an idle
+// keep-alive session among those others rather than a held stream.
+#define WEB_SOCKETS_MAX_OPEN        (CONFIG_LWIP_MAX_SOCKETS - 3)   // httpd keeps 3 for itself
+#define WEB_SOCKETS_SHORT_RESERVED  3
+#define WEB_SOCKETS_LONG_LIVED_MAX  (WEB_SOCKETS_MAX_OPEN - WEB_SOCKETS_SHORT_RESERVED)
+
+_Static_assert(WEB_SOCKETS_LONG_LIVED_MAX >= 1, "CONFIG_LWIP_MAX_SOCKETS too small for long-lived clients");
+
+typedef enum {
+    WEB_SOCKET_EVENTS = 0,      // /api/events
+    WEB_SOCKET_LONGPOLL,        // /api/sensors?since=
+    WEB_SOCKET_WS,              // /api/ws
+    WEB_SOCKET_KIND_COUNT
+} web_socket_kind_t;
+
+typedef struct {
+    uint32_t in_use[WEB_SOCKET_KIND_COUNT];
+    uint32_t long_lived;        // Sum of in_use
+    uint32_t max_long_lived;
+    uint32_t refused;           // Over WEB_SOCKETS_LONG_LIVED_MAX
+} web_sockets_stats_t;
+
+// Takes a long-lived socket from the budget; false once the shared cap is
+// reached (the caller then refuses the client as if its pool were full)
+bool web_sockets_acquire(web_socket_kind_t kind);
+
+// Returns a socket taken with web_sockets_acquire()
+void web_sockets_release(web_socket_kind_t kind);
+
+// Moves a long-lived session to the most recently used end of the
+// server's LRU order
+void web_sockets_touch(httpd_handle_t server, int fd);
+
+void web_sockets_get_stats(web_sockets_stats_t *stats);
+
+#endif
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "web_workers.h"
+
+static const char *TAG = "WEB_WORKERS";
+
+typedef struct {
+    httpd_req_t *req;           // Async copy, completed by the worker
+    web_workers_fn_t fn;
+    int64_t queued_us;
+} work_item_t;
+
+static QueueHandle_t work_queue;
+static TaskHandle_t workers[WEB_WORKERS_COUNT];
+
+static web_workers_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_hist_t queue_hist;
+static latency_hist_t run_hist;
+
+static void web_worker_task(void *pvParameters)
+{
+    work_item_t item;
+
+    while (1) {
+        if (xQueueReceive(work_queue, &item, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        latency_hist_record(&queue_hist, (uint32_t)(start_us - item.queued_us));
+        portENTER_CRITICAL(&stats_lock);
+        stats.busy++;
+        portEXIT_CRITICAL(&stats_lock);
+
+        esp_err_t err = item.fn(item.req);
+        httpd_req_async_handler_complete(item.req);
+
+        latency_hist_record(&run_hist, (uint32_t)(esp_timer_get_time() - start_us));
+        portENTER_CRITICAL(&stats_lock);
+        stats.busy--;
+        if (err != ESP_OK) {
+            stats.errors++;
+        }
+        portEXIT_CRITICAL(&stats_lock);
+    }
+}
+
+esp_err_t web_workers_init(void)
+{
+    if (work_queue != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    work_queue = xQueueCreate(WEB_WORKERS_QUEUE_LEN, sizeof(work_item_t));
+    if (work_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    latency_hist_init(&queue_hist);
+    latency_hist_init(&run_hist);
+
+    for (int i = 0; i < WEB_WORKERS_COUNT; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "web_worker%d", i);
+        if (xTaskCreate(web_worker_task, name, WEB_WORKERS_STACK, NULL,
+                        WEB_WORKERS_PRIO, &workers[i]) != pdPASS) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    ESP_LOGI(TAG, "%d workers, queue of %d", WEB_WORKERS_COUNT, WEB_WORKERS_QUEUE_LEN);
+    return ESP_OK;
+}
+
+bool web_workers_in_worker(void)
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (int i = 0; i < WEB_WORKERS_COUNT; i++) {
+        if (workers[i] == self) {
+            return true;
+        }
+    }
+    return false;
+}
+
+esp_err_t web_workers_offload(httpd_req_t *req, web_workers_fn_t fn)
+{
+    if (web_workers_in_worker()) {
+        return fn(req);
+    }
+    if (work_queue == NULL) {
+        // No pool: run inline rather than fail the request
+        return fn(req);
+    }
+
+    // Only the server task queues work, so a free slot stays free
+    if (uxQueueSpacesAvailable(work_queue) == 0) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.rejected++;
+        portEXIT_CRITICAL(&stats_lock);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+        httpd_resp_set_hdr(req, "Retry-After", "1");
+        httpd_resp_send(req, "Server busy", HTTPD_RESP_USE_STRLEN);
+        return ESP_OK;
+    }
+
+    work_item_t item = { .fn = fn, .queued_us = esp_timer_get_time() };
+    esp_err_t err = httpd_req_async_handler_begin(req, &item.req);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach request: %s", esp_err_to_name(err));
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to queue request");
+        return ESP_FAIL;
+    }
+    if (xQueueSend(work_queue, &item, 0) != pdTRUE) {
+        httpd_resp_send_err(item.req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to queue request");
+        httpd_req_async_handler_complete(item.req);
+        return ESP_FAIL;
+    }
+
+    uint32_t depth = uxQueueMessagesWaiting(work_queue);
+    portENTER_CRITICAL(&stats_lock);
+    stats.offloaded++;
+    if (depth > stats.max_queue_depth) {
+        stats.max_queue_depth = depth;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+    return ESP_OK;
+}
+
+esp_err_t web_workers_handler(httpd_req_t *req)
+{
+    return web_workers_offload(req, (web_workers_fn_t)req->user_ctx);
+}
+
+void web_workers_get_stats(web_workers_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+    out->queue_depth = work_queue != NULL ? uxQueueMessagesWaiting(work_queue) : 0;
+}
+
+void web_workers_get_queue_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&queue_hist, out);
+}
+
+void web_workers_get_run_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&run_hist, out);
+}
@@ -0,0 +1,56 @@
+#ifndef WEB_WORKERS_H
+#define WEB_WORKERS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "latency_hist.h"
+
+// Worker pool for slow HTTP handlers. esp_http_server runs every handler
+// on its one task; a handler that blocks (a fresh sensor read, a large
+// export to a slow client) would stall every other client. Routes marked
+// as slow are detached with httpd_req_async_handler_begin() and queued
+// to a small pool of worker tasks; fast routes keep running inline.
+//
+//   httpd_uri_t uri = {
+//       .uri = "/api/history", .method = HTTP_GET,
+//       .handler = web_workers_handler, .user_ctx = api_history_get_handler,
+//   };
+
+#define WEB_WORKERS_COUNT       2
+#define WEB_WORKERS_QUEUE_LEN   8       // Waiting requests; more get 503
+#define WEB_WORKERS_STACK       6144    // Same as the server task: handlers format on the stack
+#define WEB_WORKERS_PRIO        5       // Same as the server task
+
+typedef esp_err_t (*web_workers_fn_t)(httpd_req_t *req);
+
+typedef struct {
+    uint32_t offloaded;
+    uint32_t rejected;          // Queue full
+    uint32_t errors;            // Handler returned an error
+    uint32_t queue_depth;
+    uint32_t max_queue_depth;
+    uint32_t busy;              // Workers running a handler
+} web_workers_stats_t;
+
+esp_err_t web_workers_init(void);
+
+// Runs fn for req on a worker. On the server task: detaches req and
+// queues it (503 if the queue is full). Already on a worker: calls fn.
+esp_err_t web_workers_offload(httpd_req_t *req, web_workers_fn_t fn);
+
+// URI handler for routes that always go to a worker; user_ctx is the
+// web_workers_fn_t that handles the request
+esp_err_t web_workers_handler(httpd_req_t *req);
+
+// True when called from a worker task
+bool web_workers_in_worker(void);
+
+void web_workers_get_stats(web_workers_stats_t *stats);
+
+// Time requests spent queued, and running on a worker
+void web_workers_get_queue_hist(latency_hist_t *out);
+void web_workers_get_run_hist(latency_hist_t *out);
+
+#endif
@@ -0,0 +1,546 @@
+#include <string.h>
+#include <math.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+#include "web_ws.h"
+#include "web_sockets.h"
+#include "sensor_snapshot.h"
+#include "app_config.h"
+
+static const char *TAG = "WEB_WS";
+
+#if CONFIG_HTTPD_WS_SUPPORT
+
+#define WS_CMD_MAX_LEN  8
+#define WS_TASK_STACK   3072
+#define WS_TASK_PRIO    3
+
+// Notification bits for the WebSocket task
+#define EVT_SAMPLE  (1u << 0)
+#define EVT_RELAY   (1u << 1)
+#define EVT_CLIENT  (1u << 2)   // Queued ACKs or a state resend
+
+// Wire format, must not change size
+_Static_assert(sizeof(web_ws_sample_msg_t) == 24, "web_ws_sample_msg_t must stay 24 bytes");
+_Static_assert(sizeof(web_ws_relay_msg_t) == 12, "web_ws_relay_msg_t must stay 12 bytes");
+
+typedef struct {
+    int fd;                 // -1 = free
+    uint8_t mask;           // WEB_WS_SUB_*
+    bool send_state;        // Current sample and relay frames requested
+    uint8_t ack_count;
+    web_ws_ack_msg_t acks[WEB_WS_ACK_QUEUE];
+} ws_client_t;
+
+static httpd_handle_t ws_server;
+static TaskHandle_t ws_task;
+
+// Slots are claimed and freed by the HTTP task (handshake, session close)
+// and freed by the WebSocket task when a send fails
+static ws_client_t ws_clients[WEB_WS_MAX_CLIENTS];
+static SemaphoreHandle_t clients_mutex;
+
+static web_ws_stats_t stats;
+static portMUX_TYPE stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static latency_hist_t encode_hist;
+
+static int16_t to_centi_i16(float value)
+{
+    float v = roundf(value * 100.0f);
+    if (v > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (v < INT16_MIN) {
+        return INT16_MIN;
+    }
+    return (int16_t)v;
+}
+
+// Returns false if no sample has been published yet
+static bool encode_sample(web_ws_sample_msg_t *msg)
+{
+    sensor_snapshot_t snap;
+    if (!sensor_snapshot_read(&snap)) {
+        return false;
+    }
+    const sensor_data_t *d = &snap.data;
+    memset(msg, 0, sizeof(*msg));
+    msg->type = WEB_WS_MSG_SAMPLE;
+    msg->flags = (d->aht22_available ? 0x01 : 0) | (d->bmp180_available ? 0x02 : 0);
+    msg->bmp180_oss = d->bmp180_oss;
+    msg->seq = snap.seq;
+    msg->timestamp_ms = d->timestamp;
+    msg->aht22_temperature = to_centi_i16(d->aht22_temperature);
+    msg->aht22_humidity = (uint16_t)lroundf(fminf(fmaxf(d->aht22_humidity, 0.0f), 100.0f) * 100.0f);
+    msg->bmp180_temperature = to_centi_i16(d->bmp180_temperature);
+    msg->bmp180_pressure = (uint32_t)lroundf(fmaxf(d->bmp180_pressure, 0.0f) * 100.0f);
+    return true;
+}
+
+static void encode_relay(web_ws_relay_msg_t *msg)
+{
+    app_config_t config;
+    uint32_t version = app_config_get_versioned(&config);
+    memset(msg, 0, sizeof(*msg));
+    msg->type = WEB_WS_MSG_RELAY;
+    msg->state = config.relay_state;
+    msg->mode = config.auto_mode;
+    msg->version = version;
+    msg->temp_high = to_centi_i16(config.temp_high);
+    msg->temp_low = to_centi_i16(config.temp_low);
+}
+
+static int find_client(int fd)
+{
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        if (ws_clients[i].fd == fd) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Frees a slot; clients_mutex must be held
+static void free_slot(int slot)
+{
+    ESP_LOGI(TAG, "WebSocket client %d disconnected", ws_clients[slot].fd);
+    ws_clients[slot].fd = -1;
+    web_sockets_release(WEB_SOCKET_WS);
+    portENTER_CRITICAL(&stats_lock);
+    stats.clients--;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+// Frees the slot of fd unless it has been freed (or reused) meanwhile
+static void drop_fd(int fd)
+{
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    int slot = find_client(fd);
+    if (slot >= 0) {
+        free_slot(slot);
+    }
+    xSemaphoreGive(clients_mutex);
+}
+
+// Runs on the WebSocket task. Returns false (and drops the client) if the
+// frame could not be sent.
+static bool send_to(int fd, const void *buf, size_t len)
+{
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_BINARY,
+        .payload = (uint8_t *)buf,
+        .len = len,
+    };
+
+    // A closed socket's fd may already belong to a plain HTTP session
+    if (httpd_ws_get_fd_info(ws_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+        httpd_ws_send_frame_async(ws_server, fd, &frame) != ESP_OK) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.send_errors++;
+        portEXIT_CRITICAL(&stats_lock);
+        drop_fd(fd);
+        return false;
+    }
+    web_sockets_touch(ws_server, fd);
+    portENTER_CRITICAL(&stats_lock);
+    stats.frames_sent++;
+    stats.bytes_sent += len;
+    portEXIT_CRITICAL(&stats_lock);
+    return true;
+}
+
+static void broadcast(uint8_t sub, const void *buf, size_t len)
+{
+    int fds[WEB_WS_MAX_CLIENTS];
+    int n = 0;
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        if (ws_clients[i].fd >= 0 && (ws_clients[i].mask & sub)) {
+            fds[n++] = ws_clients[i].fd;
+        }
+    }
+    xSemaphoreGive(clients_mutex);
+
+    // Sends happen outside the lock so a slow client cannot stall the handshake
+    for (int i = 0; i < n; i++) {
+        send_to(fds[i], buf, len);
+    }
+}
+
+static bool send_state(int fd)
+{
+    web_ws_sample_msg_t sample;
+    if (encode_sample(&sample) && !send_to(fd, &sample, sizeof(sample))) {
+        return false;
+    }
+    web_ws_relay_msg_t relay;
+    encode_relay(&relay);
+    return send_to(fd, &relay, sizeof(relay));
+}
+
+// Sends queued ACKs, then requested state frames, one client at a time
+static void serve_clients(void)
+{
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        web_ws_ack_msg_t acks[WEB_WS_ACK_QUEUE];
+        xSemaphoreTake(clients_mutex, portMAX_DELAY);
+        int fd = ws_clients[i].fd;
+        uint8_t ack_count = ws_clients[i].ack_count;
+        bool state = ws_clients[i].send_state;
+        memcpy(acks, ws_clients[i].acks, ack_count * sizeof(acks[0]));
+        ws_clients[i].ack_count = 0;
+        ws_clients[i].send_state = false;
+        xSemaphoreGive(clients_mutex);
+
+        if (fd < 0) {
+            continue;
+        }
+        bool ok = true;
+        for (int a = 0; a < ack_count && ok; a++) {
+            ok = send_to(fd, &acks[a], sizeof(acks[a]));
+        }
+        if (ok && state) {
+            send_state(fd);
+        }
+    }
+}
+
+// Keeps clients that are not sent anything (mask 0, no samples yet) out
+// of reach of LRU purging
+static void touch_clients(void)
+{
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        if (ws_clients[i].fd >= 0) {
+            web_sockets_touch(ws_server, ws_clients[i].fd);
+        }
+    }
+    xSemaphoreGive(clients_mutex);
+}
+
+static void web_ws_task(void *pvParameters)
+{
+    while (1) {
+        uint32_t bits = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &bits, pdMS_TO_TICKS(WEB_WS_KEEPALIVE_MS));
+
+        // Requests queued while no client was connected need no work
+        uint32_t clients_now;
+        portENTER_CRITICAL(&stats_lock);
+        clients_now = stats.clients;
+        portEXIT_CRITICAL(&stats_lock);
+        if (clients_now == 0) {
+            continue;
+        }
+
+        if (bits == 0) {
+            touch_clients();
+            continue;
+        }
+        if (bits & EVT_CLIENT) {
+            serve_clients();
+        }
+        // Changes that arrive while sending are merged into the next
+        // notification, so a slow client only ever misses stale frames
+        if (bits & EVT_SAMPLE) {
+            web_ws_sample_msg_t msg;
+            int64_t start_us = esp_timer_get_time();
+            bool ok = encode_sample(&msg);
+            latency_hist_record(&encode_hist, (uint32_t)(esp_timer_get_time() - start_us));
+            if (ok) {
+                broadcast(WEB_WS_SUB_SAMPLES, &msg, sizeof(msg));
+            }
+        }
+        if (bits & EVT_RELAY) {
+            web_ws_relay_msg_t msg;
+            encode_relay(&msg);
+            broadcast(WEB_WS_SUB_RELAY, &msg, sizeof(msg));
+        }
+    }
+}
+
+static void notify(uint32_t evt)
+{
+    if (ws_task != NULL) {
+        xTaskNotify(ws_task, evt, eSetBits);
+    }
+}
+
+// Runs with the config write lock held: only wake the WebSocket task
+static void on_config_changed(const app_config_t *config, uint32_t changed, void *arg)
+{
+    if (changed & (APP_CONFIG_RELAY_STATE | APP_CONFIG_AUTO_MODE | APP_CONFIG_THRESHOLDS)) {
+        notify(EVT_RELAY);
+    }
+}
+
+// Queues an ACK for the WebSocket task; the oldest stay if the client
+// sends commands faster than it reads
+static void queue_ack(int fd, const web_ws_ack_msg_t *ack, bool send_state)
+{
+    bool dropped = false;
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    int slot = find_client(fd);
+    if (slot >= 0) {
+        ws_client_t *c = &ws_clients[slot];
+        if (c->ack_count < WEB_WS_ACK_QUEUE) {
+            c->acks[c->ack_count++] = *ack;
+            c->send_state |= send_state;
+        } else {
+            dropped = true;
+        }
+    }
+    xSemaphoreGive(clients_mutex);
+
+    if (dropped) {
+        portENTER_CRITICAL(&stats_lock);
+        stats.acks_dropped++;
+        portEXIT_CRITICAL(&stats_lock);
+    }
+    notify(EVT_CLIENT);
+}
+
+static void handle_command(int fd, const uint8_t *cmd, size_t len)
+{
+    web_ws_ack_msg_t ack = {
+        .type = WEB_WS_MSG_ACK,
+        .cmd = len > 0 ? cmd[0] : 0,
+        .status = WEB_WS_ACK_INVALID,
+    };
+    uint8_t arg = len > 1 ? cmd[1] : 0;
+
+    if (len == 2) {
+        app_config_t config;
+        app_config_get(&config);
+
+        switch (cmd[0]) {
+        case WEB_WS_CMD_SUBSCRIBE: {
+            xSemaphoreTake(clients_mutex, portMAX_DELAY);
+            int slot = find_client(fd);
+            if (slot >= 0) {
+                if ((arg & ~WEB_WS_SUB_ALL) == 0) {
+                    ws_clients[slot].mask = arg;
+                    ack.status = WEB_WS_ACK_OK;
+                }
+                ack.arg = ws_clients[slot].mask;
+            }
+            xSemaphoreGive(clients_mutex);
+            break;
+        }
+        case WEB_WS_CMD_SET_RELAY:
+            if (arg <= 1) {
+                // Same rule as POST /api/relay: auto mode owns the relay
+                if (config.auto_mode) {
+                    ack.status = WEB_WS_ACK_REFUSED;
+                } else {
+                    app_config_set_relay_state(arg);
+                    ack.status = WEB_WS_ACK_OK;
+                }
+            }
+            app_config_get(&config);
+            ack.arg = config.relay_state;
+            break;
+        case WEB_WS_CMD_SET_MODE:
+            if (arg <= 1) {
+                app_config_set_auto_mode(arg);
+                ack.status = WEB_WS_ACK_OK;
+            }
+            app_config_get(&config);
+            ack.arg = config.auto_mode;
+            break;
+        case WEB_WS_CMD_GET_STATE:
+            ack.status = WEB_WS_ACK_OK;
+            break;
+        default:
+            break;
+        }
+    }
+
+    portENTER_CRITICAL(&stats_lock);
+    stats.commands++;
+    if (ack.status == WEB_WS_ACK_INVALID) {
+        stats.bad_commands++;
+    }
+    portEXIT_CRITICAL(&stats_lock);
+
+    queue_ack(fd, &ack, ack.cmd == WEB_WS_CMD_GET_STATE && ack.status == WEB_WS_ACK_OK);
+}
+
+// Takes the slot for a new connection. Entries whose socket is no longer a
+// WebSocket are freed first; a client that unsubscribed from everything
+// is never sent to, so a failed send would not have noticed it leaving.
+// Returns false if every slot is in use or the socket budget is spent.
+static bool claim_slot(int fd)
+{
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        if (ws_clients[i].fd >= 0 && ws_clients[i].fd != fd &&
+            httpd_ws_get_fd_info(ws_server, ws_clients[i].fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+            free_slot(i);
+        }
+    }
+
+    // A stale entry for a reused fd is taken over, along with its socket
+    // from the budget
+    int slot = find_client(fd);
+    if (slot < 0 && (slot = find_client(-1)) >= 0) {
+        if (web_sockets_acquire(WEB_SOCKET_WS)) {
+            portENTER_CRITICAL(&stats_lock);
+            stats.clients++;
+            portEXIT_CRITICAL(&stats_lock);
+        } else {
+            slot = -1;
+        }
+    }
+    if (slot >= 0) {
+        ws_clients[slot] = (ws_client_t){
+            .fd = fd,
+            .mask = WEB_WS_SUB_ALL,
+            .send_state = true,     // Current state once the handshake response is out
+        };
+    }
+    xSemaphoreGive(clients_mutex);
+    return slot >= 0;
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+
+    if (req->method == HTTP_GET) {
+        if (!claim_slot(fd)) {
+            portENTER_CRITICAL(&stats_lock);
+            stats.rejected++;
+            portEXIT_CRITICAL(&stats_lock);
+            ESP_LOGW(TAG, "Too many WebSocket clients, closing %d", fd);
+            httpd_sess_trigger_close(req->handle, fd);
+            return ESP_OK;
+        }
+        portENTER_CRITICAL(&stats_lock);
+        stats.connects++;
+        portEXIT_CRITICAL(&stats_lock);
+        ESP_LOGI(TAG, "WebSocket client %d connected", fd);
+        notify(EVT_CLIENT);
+        return ESP_OK;
+    }
+
+    xSemaphoreTake(clients_mutex, portMAX_DELAY);
+    int slot = find_client(fd);
+    xSemaphoreGive(clients_mutex);
+    if (slot < 0) {
+        return ESP_FAIL;
+    }
+
+    uint8_t buf[WS_CMD_MAX_LEN];
+    httpd_ws_frame_t frame = { .payload = buf };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (frame.len > sizeof(buf)) {
+        // Cannot skip the rest of the frame; end the session
+        portENTER_CRITICAL(&stats_lock);
+        stats.bad_commands++;
+        portEXIT_CRITICAL(&stats_lock);
+        return ESP_FAIL;
+    }
+    if (frame.len > 0) {
+        ret = httpd_ws_recv_frame(req, &frame, frame.len);
+        if (ret != ESP_OK) {
+            return ret;
+        }
+    }
+
+    if (frame.type == HTTPD_WS_TYPE_BINARY) {
+        handle_command(fd, buf, frame.len);
+    }
+    return ESP_OK;
+}
+
+esp_err_t web_ws_init(httpd_handle_t server)
+{
+    if (ws_server != NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    clients_mutex = xSemaphoreCreateMutex();
+    if (clients_mutex == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < WEB_WS_MAX_CLIENTS; i++) {
+        ws_clients[i].fd = -1;
+    }
+    latency_hist_init(&encode_hist);
+    ws_server = server;
+    if (xTaskCreate(web_ws_task, "web_ws", WS_TASK_STACK, NULL, WS_TASK_PRIO, &ws_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    httpd_uri_t ws = {
+        .uri          = "/api/ws",
+        .method       = HTTP_GET,
+        .handler      = ws_handler,
+        .is_websocket = true,
+    };
+    esp_err_t err = httpd_register_uri_handler(server, &ws);
+    if (err != ESP_OK) {
+        return err;
+    }
+    return app_config_subscribe(on_config_changed, NULL);
+}
+
+void web_ws_session_closed(int fd)
+{
+    if (clients_mutex != NULL) {
+        drop_fd(fd);
+    }
+}
+
+void web_ws_notify_sample(void)
+{
+    notify(EVT_SAMPLE);
+}
+
+void web_ws_get_stats(web_ws_stats_t *out)
+{
+    portENTER_CRITICAL(&stats_lock);
+    *out = stats;
+    portEXIT_CRITICAL(&stats_lock);
+}
+
+void web_ws_get_encode_hist(latency_hist_t *out)
+{
+    latency_hist_copy(&encode_hist, out);
+}
+
+#else
+
+esp_err_t web_ws_init(httpd_handle_t server)
+{
+    ESP_LOGW(TAG, "WebSocket support disabled (CONFIG_HTTPD_WS_SUPPORT)");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void web_ws_session_closed(int fd)
+{
+}
+
+void web_ws_notify_sample(void)
+{
+}
+
+void web_ws_get_stats(web_ws_stats_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+void web_ws_get_encode_hist(latency_hist_t *out)
+{
+    memset(out, 0, sizeof(*out));
+}
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef WEB_WS_H
+#define WEB_WS_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "latency_hist.h"
+
+// WebSocket endpoint (/api/ws, needs CONFIG_HTTPD_WS_SUPPORT) for SCADA
+// style clients. The server pushes fixed-layout little-endian binary
+// frames; clients send small binary commands on the same socket. Every
+// frame, ACKs included, is sent by one WebSocket task, so the HTTP server
+// task never waits on a slow client. Pending sample and relay pushes are
+// coalesced into the latest state while the task is busy.
+
+#define WEB_WS_MAX_CLIENTS      4   // Also bounded by the web_sockets.h budget
+#define WEB_WS_ACK_QUEUE        4   // Unsent ACKs per client; more are dropped
+#define WEB_WS_KEEPALIVE_MS     5000    // Idle clients marked used this often (LRU purging)
+
+// Server -> client message types
+#define WEB_WS_MSG_SAMPLE       0x01
+#define WEB_WS_MSG_RELAY        0x02
+#define WEB_WS_MSG_ACK          0x03
+
+// Client -> server commands, each 2 bytes: {cmd, arg}
+#define WEB_WS_CMD_SUBSCRIBE    0x80    // arg = WEB_WS_SUB_* mask
+#define WEB_WS_CMD_SET_RELAY    0x81    // arg = 0/1, manual mode only
+#define WEB_WS_CMD_SET_MODE     0x82    // arg = 0 manual, 1 auto
+#define WEB_WS_CMD_GET_STATE    0x83    // Resend the current sample and relay frames
+
+// Subscription mask bits (default: all)
+#define WEB_WS_SUB_SAMPLES      (1u << 0)
+#define WEB_WS_SUB_RELAY        (1u << 1)
+#define WEB_WS_SUB_ALL          0x03u
+
+// ACK status
+#define WEB_WS_ACK_OK           0
+#define WEB_WS_ACK_INVALID      1   // Unknown command or bad argument
+#define WEB_WS_ACK_REFUSED      2   // Not allowed now (e.g. relay in auto mode)
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                   // WEB_WS_MSG_SAMPLE
+    uint8_t flags;                  // Bit 0: AHT22 valid, bit 1: BMP180 valid
+    uint8_t bmp180_oss;
+    uint8_t reserved;
+    uint32_t seq;
+    uint32_t timestamp_ms;
+    int16_t aht22_temperature;      // 0.01 °C
+    uint16_t aht22_humidity;        // 0.01 %RH
+    int16_t bmp180_temperature;     // 0.01 °C
+    uint16_t reserved2;
+    uint32_t bmp180_pressure;       // Pa
+} web_ws_sample_msg_t;              // 24 bytes
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                   // WEB_WS_MSG_RELAY
+    uint8_t state;
+    uint8_t mode;
+    uint8_t reserved;
+    uint32_t version;               // Config version, as in /api/config
+    int16_t temp_high;              // 0.01 °C
+    int16_t temp_low;
+} web_ws_relay_msg_t;               // 12 bytes
+
+typedef struct __attribute__((packed)) {
+    uint8_t type;                   // WEB_WS_MSG_ACK
+    uint8_t cmd;
+    uint8_t status;
+    uint8_t arg;                    // Resulting value (mask, state or mode)
+} web_ws_ack_msg_t;
+
+typedef struct {
+    uint32_t clients;
+    uint32_t connects;
+    uint32_t rejected;          // Over WEB_WS_MAX_CLIENTS or the socket budget
+    uint32_t frames_sent;
+    uint32_t send_errors;
+    uint64_t bytes_sent;
+    uint32_t commands;
+    uint32_t bad_commands;
+    uint32_t acks_dropped;      // Over WEB_WS_ACK_QUEUE
+} web_ws_stats_t;
+
+// Starts the WebSocket task, registers /api/ws on the running server and
+// subscribes to config changes
+esp_err_t web_ws_init(httpd_handle_t server);
+
+// Call from the server's close_fn so the client's slot is freed even if
+// nothing is ever sent to it again
+void web_ws_session_closed(int fd);
+
+// Call after a new sample has been published to sensor_snapshot
+void web_ws_notify_sample(void);
+
+void web_ws_get_stats(web_ws_stats_t *stats);
+
+// Time to build one sample frame
+void web_ws_get_encode_hist(latency_hist_t *out);
+
+#endif